@@ -0,0 +1,51 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * CLOCK_MONOTONIC in nanoseconds and absolute deadlines for paced loops.
+ * A paced loop keeps one timespec, advances it by its period with
+ * timespec_add_ns() and sleeps until it with clock_nanosleep(TIMER_ABSTIME),
+ * so a late iteration does not shift the ones after it.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <time.h>
+
+#define NSEC_PER_SEC	1000000000UL
+
+static inline unsigned long int timespec_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static inline unsigned long int now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return timespec_ns(&ts);
+}
+
+static inline void timespec_add_ns(struct timespec *ts, unsigned long int ns)
+{
+	ts->tv_sec += ns / NSEC_PER_SEC;
+	ts->tv_nsec += ns % NSEC_PER_SEC;
+	if (ts->tv_nsec >= (long)NSEC_PER_SEC) {
+		ts->tv_nsec -= NSEC_PER_SEC;
+		ts->tv_sec++;
+	}
+}
+
+/* Sleep until the given now_ns() time */
+static inline void sleep_until_ns(unsigned long int ns)
+{
+	struct timespec ts = { .tv_sec = ns / NSEC_PER_SEC, .tv_nsec = ns % NSEC_PER_SEC };
+
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
+
+#endif /* CLOCK_H */
@@ -0,0 +1,16 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include "hist_json.h"
+
+void json_latency(json_record *r, const char *key, const histogram *h)
+{
+	json_object_begin(r, key);
+	json_uint(r, "p50", hist_percentile(h, 0.50));
+	json_uint(r, "p99", hist_percentile(h, 0.99));
+	json_uint(r, "p999", hist_percentile(h, 0.999));
+	json_uint(r, "max", h->max);
+	json_object_end(r);
+}
@@ -0,0 +1,20 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Histograms in JSON records. Kept apart from histogram.c so tools that
+ * only record latencies do not have to link json_report.c.
+ */
+
+#ifndef HIST_JSON_H
+#define HIST_JSON_H
+
+#include "histogram.h"
+#include "json_report.h"
+
+/* Object under key with the p50, p99, p999 and max of h */
+void json_latency(json_record *r, const char *key, const histogram *h);
+
+#endif /* HIST_JSON_H */
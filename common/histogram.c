@@ -0,0 +1,112 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+/* Highest value that falls into bucket i */
+static unsigned long int hist_bucket_value(unsigned int i)
+{
+	unsigned int shift;
+
+	if (i < HIST_SUB_COUNT)
+		return i;
+
+	shift = (i - HIST_SUB_COUNT) / HIST_HALF_COUNT + 1;
+	return ((((i - HIST_SUB_COUNT) % HIST_HALF_COUNT) + HIST_HALF_COUNT + 1UL) << shift) - 1;
+}
+
+void hist_init(histogram *h)
+{
+	memset(h, 0, sizeof(*h));
+	h->min = ~0UL;
+}
+
+void hist_snapshot(histogram *dst, const histogram *src)
+{
+	unsigned int i;
+
+	dst->total = __atomic_load_n(&src->total, __ATOMIC_ACQUIRE);
+	dst->min = __atomic_load_n(&src->min, __ATOMIC_RELAXED);
+	dst->max = __atomic_load_n(&src->max, __ATOMIC_RELAXED);
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] = __atomic_load_n(&src->counts[i], __ATOMIC_RELAXED);
+}
+
+void hist_merge(histogram *dst, const histogram *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] += src->counts[i];
+	dst->total += src->total;
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+void hist_delta(histogram *dst, const histogram *now, const histogram *before)
+{
+	unsigned int i;
+
+	hist_init(dst);
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		dst->counts[i] = now->counts[i] - before->counts[i];
+		dst->total += dst->counts[i];
+		if (dst->counts[i]) {
+			if (dst->min == ~0UL)
+				dst->min = hist_bucket_value(i);
+			dst->max = hist_bucket_value(i);
+		}
+	}
+}
+
+unsigned long int hist_percentile(const histogram *h, double fraction)
+{
+	unsigned long int seen = 0, rank, total = 0;
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		total += h->counts[i];
+	if (total == 0)
+		return 0;
+
+	rank = (unsigned long int)(fraction * total + 0.5);
+	if (rank == 0)
+		rank = 1;
+	if (rank > total)
+		rank = total;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->counts[i];
+		if (seen >= rank)
+			break;
+	}
+
+	/* Do not report more than the exact extremes when they are known */
+	if (h->max && hist_bucket_value(i) > h->max)
+		return h->max;
+	return hist_bucket_value(i);
+}
+
+double hist_mean(const histogram *h)
+{
+	double sum = 0;
+	unsigned long int total = 0;
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		if (h->counts[i] == 0)
+			continue;
+		/* Mid point of the bucket */
+		sum += h->counts[i] * (hist_bucket_value(i) / 2.0 +
+				       (i ? hist_bucket_value(i - 1) + 1 : 0) / 2.0);
+		total += h->counts[i];
+	}
+
+	return total ? sum / total : 0;
+}
@@ -0,0 +1,73 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Log-linear (HDR style) histogram of unsigned 64-bit values, typically
+ * latencies in nanoseconds. Every power of two is split into 16 linear
+ * sub-buckets, so any recorded value is reported with at most ~6% error
+ * over the full 64-bit range in under 8KiB.
+ *
+ * hist_record() is meant for a single writer thread and is lock-free. Any
+ * other thread may take a consistent-enough copy with hist_snapshot() while
+ * the writer keeps recording, e.g. for periodic reporting.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#define HIST_SUB_BITS	5
+#define HIST_SUB_COUNT	(1UL << HIST_SUB_BITS)
+#define HIST_HALF_COUNT	(HIST_SUB_COUNT / 2)
+#define HIST_BUCKETS	(HIST_SUB_COUNT + (64 - HIST_SUB_BITS) * HIST_HALF_COUNT)
+
+typedef struct {
+	unsigned long int counts[HIST_BUCKETS];
+	unsigned long int total;
+	unsigned long int min;
+	unsigned long int max;
+} histogram;
+
+static inline unsigned int hist_index(unsigned long int value)
+{
+	unsigned int shift;
+
+	if (value < HIST_SUB_COUNT)
+		return value;
+
+	shift = (63 - __builtin_clzl(value)) - (HIST_SUB_BITS - 1);
+	return HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT +
+		((value >> shift) - HIST_HALF_COUNT);
+}
+
+/* Single writer, readers use hist_snapshot() */
+static inline void hist_record(histogram *h, unsigned long int value)
+{
+	unsigned int i = hist_index(value);
+
+	__atomic_store_n(&h->counts[i], h->counts[i] + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&h->total, h->total + 1, __ATOMIC_RELEASE);
+	if (value < h->min)
+		__atomic_store_n(&h->min, value, __ATOMIC_RELAXED);
+	if (value > h->max)
+		__atomic_store_n(&h->max, value, __ATOMIC_RELAXED);
+}
+
+void hist_init(histogram *h);
+
+/* Copy src into dst while the writer may still be recording */
+void hist_snapshot(histogram *dst, const histogram *src);
+
+/* dst += src */
+void hist_merge(histogram *dst, const histogram *src);
+
+/* dst = now - before, for interval statistics between two snapshots */
+void hist_delta(histogram *dst, const histogram *now, const histogram *before);
+
+/* Value below which the given fraction (0.0 - 1.0) of the samples fall */
+unsigned long int hist_percentile(const histogram *h, double fraction);
+
+double hist_mean(const histogram *h);
+
+#endif /* HISTOGRAM_H */
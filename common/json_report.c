@@ -0,0 +1,126 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <math.h>
+
+#include "json_report.h"
+
+static void put_string(FILE *out, const char *s)
+{
+	fputc('"', out);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(out, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(out, "\\u%04x", (unsigned char)*s);
+		else
+			fputc(*s, out);
+	}
+	fputc('"', out);
+}
+
+/* Separator and key of the next member */
+static void member(json_record *r, const char *key)
+{
+	if (r->used & (1U << r->depth))
+		fputs(", ", r->out);
+	r->used |= 1U << r->depth;
+	if (key) {
+		put_string(r->out, key);
+		fputs(": ", r->out);
+	}
+}
+
+static void open_level(json_record *r, const char *key, int array)
+{
+	member(r, key);
+	fputc(array ? '[' : '{', r->out);
+	if (r->depth < JSON_MAX_DEPTH - 1)
+		r->depth++;
+	r->used &= ~(1U << r->depth);
+	if (array)
+		r->arrays |= 1U << r->depth;
+	else
+		r->arrays &= ~(1U << r->depth);
+}
+
+static void close_level(json_record *r)
+{
+	fputc((r->arrays & (1U << r->depth)) ? ']' : '}', r->out);
+	if (r->depth > 0)
+		r->depth--;
+}
+
+void json_begin(json_record *r, FILE *out, const char *tool, const char *test)
+{
+	r->out = out;
+	r->depth = 0;
+	r->used = 0;
+	r->arrays = 0;
+	fputc('{', out);
+	json_string(r, "tool", tool);
+	json_string(r, "test", test);
+}
+
+void json_end(json_record *r)
+{
+	while (r->depth > 0)
+		close_level(r);
+	fputs("}\n", r->out);
+	fflush(r->out);
+}
+
+void json_object_begin(json_record *r, const char *key)
+{
+	open_level(r, key, 0);
+}
+
+void json_object_end(json_record *r)
+{
+	close_level(r);
+}
+
+void json_array_begin(json_record *r, const char *key)
+{
+	open_level(r, key, 1);
+}
+
+void json_array_end(json_record *r)
+{
+	close_level(r);
+}
+
+void json_string(json_record *r, const char *key, const char *value)
+{
+	member(r, key);
+	put_string(r->out, value);
+}
+
+void json_int(json_record *r, const char *key, long int value)
+{
+	member(r, key);
+	fprintf(r->out, "%ld", value);
+}
+
+void json_uint(json_record *r, const char *key, unsigned long int value)
+{
+	member(r, key);
+	fprintf(r->out, "%lu", value);
+}
+
+void json_double(json_record *r, const char *key, double value)
+{
+	member(r, key);
+	if (isfinite(value))
+		fprintf(r->out, "%.9g", value);
+	else
+		fputs("null", r->out);
+}
+
+void json_bool(json_record *r, const char *key, int value)
+{
+	member(r, key);
+	fputs(value ? "true" : "false", r->out);
+}
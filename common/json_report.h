@@ -0,0 +1,60 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Machine-readable results of the platform test tools. Every test result is
+ * one JSON object on a line of its own (JSON Lines), so scripts can read the
+ * output line by line instead of scraping text. Records share a common set
+ * of top-level keys:
+ *
+ *	tool		Binary that produced the record
+ *	test		Test or mode within the tool
+ *	params		Object with the parameters of the run
+ *	duration_s	Wall time of the measurement
+ *	bytes		Bytes moved, bandwidth_gbps is bytes per second / 1e9
+ *	latency_ns	Object with p50, p99, p999 and max
+ *	mean_latency_ns	Mean latency, for tests that do not sample a distribution
+ *	errors		Mismatches or failures, status is "pass" or "fail"
+ *
+ * Keys that do not apply to a test are left out.
+ */
+
+#ifndef JSON_REPORT_H
+#define JSON_REPORT_H
+
+#include <stdio.h>
+
+#define JSON_MAX_DEPTH	8
+
+typedef struct {
+	FILE *out;
+	int depth;
+	unsigned int used;	/* Bit per depth, set once a member was written */
+	unsigned int arrays;	/* Bit per depth, set for arrays */
+} json_record;
+
+/* Open a record with its tool and test keys */
+void json_begin(json_record *r, FILE *out, const char *tool, const char *test);
+
+/* Close every open object and array and end the line */
+void json_end(json_record *r);
+
+/*
+ * Members of the current object take a key, elements of an array pass a
+ * NULL key.
+ */
+void json_object_begin(json_record *r, const char *key);
+void json_object_end(json_record *r);
+void json_array_begin(json_record *r, const char *key);
+void json_array_end(json_record *r);
+
+void json_string(json_record *r, const char *key, const char *value);
+void json_int(json_record *r, const char *key, long int value);
+void json_uint(json_record *r, const char *key, unsigned long int value);
+/* NaN and infinities are written as null */
+void json_double(json_record *r, const char *key, double value);
+void json_bool(json_record *r, const char *key, int value);
+
+#endif /* JSON_REPORT_H */
@@ -0,0 +1,67 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "reg_map.h"
+
+int reg_map_open(reg_map *m, const char *path, unsigned long int phys, size_t size)
+{
+	unsigned long int page = sysconf(_SC_PAGESIZE), start = 0, skip = 0;
+	struct stat st;
+	int fd;
+
+	memset(m, 0, sizeof(*m));
+	if (!path)
+		path = REG_MAP_DEVMEM;
+	//Only /dev/mem is addressed by physical address
+	if (!strcmp(path, REG_MAP_DEVMEM)) {
+		start = phys & ~(page - 1);
+		skip = phys - start;
+	}
+
+	fd = open(path, O_RDWR | O_SYNC | O_CLOEXEC);
+	if (fd == -1) {
+		fprintf(stderr, "ERROR : opening %s, errno:%d\n", path, errno);
+		return -1;
+	}
+
+	//Touching a page past the end of a short file raises SIGBUS, devices have no size
+	if (strcmp(path, REG_MAP_DEVMEM) && fstat(fd, &st) == 0 &&
+	    S_ISREG(st.st_mode) && (unsigned long int)st.st_size < size) {
+		fprintf(stderr, "ERROR : %s is %ld bytes, the registers need %zu\n", path,
+			(long int)st.st_size, size);
+		close(fd);
+		return -1;
+	}
+
+	m->map_size = (skip + size + page - 1) & ~(page - 1);
+	m->map = mmap(NULL, m->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, start);
+	close(fd);
+	if (m->map == MAP_FAILED) {
+		fprintf(stderr, "ERROR : mapping 0x%lx of %s failed errno:%d\n", phys, path, errno);
+		m->map = NULL;
+		return -1;
+	}
+
+	m->base = (volatile uint8_t *)m->map + skip;
+	m->phys = phys;
+	m->size = size;
+	return 0;
+}
+
+void reg_map_close(reg_map *m)
+{
+	if (m->map)
+		munmap(m->map, m->map_size);
+	m->map = NULL;
+	m->base = NULL;
+}
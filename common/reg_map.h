@@ -0,0 +1,53 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * 32-bit register access through one mapping of a register window, instead
+ * of a devmem2 process per access. The window is mapped from /dev/mem at its
+ * physical address. Any other path, a UIO device or a plain file standing
+ * in for the registers on a host, is mapped from offset 0.
+ */
+
+#ifndef REG_MAP_H
+#define REG_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define REG_MAP_DEVMEM	"/dev/mem"
+
+typedef struct {
+	volatile uint8_t *base;		/* First register of the window */
+	void *map;
+	size_t map_size;
+	unsigned long int phys;
+	size_t size;
+} reg_map;
+
+/* Map size bytes at phys, path NULL for /dev/mem. Returns 0 or -1. */
+int reg_map_open(reg_map *m, const char *path, unsigned long int phys, size_t size);
+void reg_map_close(reg_map *m);
+
+static inline uint32_t reg_read32(const reg_map *m, unsigned long int offset)
+{
+	return *(volatile uint32_t *)(m->base + offset);
+}
+
+static inline void reg_write32(const reg_map *m, unsigned long int offset, uint32_t value)
+{
+	*(volatile uint32_t *)(m->base + offset) = value;
+}
+
+/* Read-modify-write, clear then set bits. Returns the value written. */
+static inline uint32_t reg_update32(const reg_map *m, unsigned long int offset, uint32_t clear,
+				    uint32_t set)
+{
+	uint32_t value = (reg_read32(m, offset) & ~clear) | set;
+
+	reg_write32(m, offset, value);
+	return value;
+}
+
+#endif /* REG_MAP_H */
@@ -0,0 +1,103 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Cache maintenance by virtual address from user space.
+ *
+ * On AArch64 Linux enables DC CVAC/CIVAC at EL0. DC IVAC is EL1 only, so
+ * invalidation is done with clean+invalidate, which is what the kernel
+ * does for partial lines anyway. On x86 hosts CLFLUSH is used for all
+ * three operations, which keeps the cost model comparable.
+ */
+
+#ifndef CACHE_OPS_H
+#define CACHE_OPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+
+static inline size_t cache_line_size(void)
+{
+#if defined(__aarch64__)
+	uint64_t ctr;
+
+	asm volatile("mrs %0, ctr_el0" : "=r" (ctr));
+	return 4UL << ((ctr >> 16) & 0xf);
+#else
+	long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+
+	return line > 0 ? (size_t)line : 64;
+#endif
+}
+
+static inline void cache_clean_range(const void *addr, size_t size)
+{
+	size_t line = cache_line_size();
+	uintptr_t p = (uintptr_t)addr & ~(line - 1);
+	uintptr_t end = (uintptr_t)addr + size;
+
+	for (; p < end; p += line) {
+#if defined(__aarch64__)
+		asm volatile("dc cvac, %0" : : "r" (p) : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+		_mm_clflush((const void *)p);
+#endif
+	}
+#if defined(__aarch64__)
+	asm volatile("dsb sy" : : : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	_mm_mfence();
+#endif
+}
+
+static inline void cache_clean_inval_range(const void *addr, size_t size)
+{
+	size_t line = cache_line_size();
+	uintptr_t p = (uintptr_t)addr & ~(line - 1);
+	uintptr_t end = (uintptr_t)addr + size;
+
+	for (; p < end; p += line) {
+#if defined(__aarch64__)
+		asm volatile("dc civac, %0" : : "r" (p) : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+		_mm_clflush((const void *)p);
+#endif
+	}
+#if defined(__aarch64__)
+	asm volatile("dsb sy" : : : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	_mm_mfence();
+#endif
+}
+
+static inline void cache_inval_range(const void *addr, size_t size)
+{
+	cache_clean_inval_range(addr, size);
+}
+
+/* Clean and invalidate the line holding addr, order it with cache_barrier() */
+static inline void cache_evict_line(const void *addr)
+{
+#if defined(__aarch64__)
+	asm volatile("dc civac, %0" : : "r" (addr) : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	_mm_clflush(addr);
+#endif
+}
+
+static inline void cache_barrier(void)
+{
+#if defined(__aarch64__)
+	asm volatile("dsb sy" : : : "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	_mm_mfence();
+#endif
+}
+
+#endif /* CACHE_OPS_H */
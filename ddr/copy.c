@@ -0,0 +1,171 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <emmintrin.h>
+#endif
+
+#include "copy.h"
+
+#define STR(x)		#x
+#define XSTR(x)		STR(x)
+
+/* Lines zeroed ahead of the copy, small enough to stay in L1 */
+#define COPY_ZVA_CHUNK	4096UL
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+/* DC ZVA block size in bytes, 0 when DC ZVA is prohibited */
+static size_t zva_block_size(void)
+{
+	uint64_t dczid;
+
+	asm volatile("mrs %0, dczid_el0" : "=r" (dczid));
+	if (dczid & 0x10)
+		return 0;
+	return 4UL << (dczid & 0xf);
+}
+
+/* Plain NEON copy, size is a multiple of 64 */
+static inline void neon_copy64(unsigned char *d, const unsigned char *s, size_t size)
+{
+	uint8x16_t a, b, c, e;
+
+	for (; size; size -= 64, s += 64, d += 64) {
+		a = vld1q_u8(s);
+		b = vld1q_u8(s + 16);
+		c = vld1q_u8(s + 32);
+		e = vld1q_u8(s + 48);
+		vst1q_u8(d, a);
+		vst1q_u8(d + 16, b);
+		vst1q_u8(d + 32, c);
+		vst1q_u8(d + 48, e);
+	}
+}
+#endif
+
+void copy_nt(void *dest, const void *src, size_t size)
+{
+	size_t bulk = size & ~127UL;
+#if defined(__aarch64__)
+	unsigned char *d = dest;
+	const unsigned char *s = src;
+	size_t n = bulk;
+
+	if (n) {
+		asm volatile("1:	ldnp q0, q1, [%[s]]\n"
+			     "	ldnp q2, q3, [%[s], #32]\n"
+			     "	ldnp q4, q5, [%[s], #64]\n"
+			     "	ldnp q6, q7, [%[s], #96]\n"
+			     "	add %[s], %[s], #128\n"
+			     "	subs %[n], %[n], #128\n"
+			     "	stnp q0, q1, [%[d]]\n"
+			     "	stnp q2, q3, [%[d], #32]\n"
+			     "	stnp q4, q5, [%[d], #64]\n"
+			     "	stnp q6, q7, [%[d], #96]\n"
+			     "	add %[d], %[d], #128\n"
+			     "	b.gt 1b\n"
+			     "	dmb ishst\n"
+			     : [d] "+r" (d), [s] "+r" (s), [n] "+r" (n)
+			     :
+			     : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "cc", "memory");
+	}
+#elif defined(__x86_64__) || defined(__i386__)
+	/* Host builds use SSE2 streaming stores, they need an aligned destination */
+	unsigned char *d = dest;
+	const unsigned char *s = src;
+	size_t i;
+
+	if ((uintptr_t)d & 15) {
+		memcpy(dest, src, size);
+		return;
+	}
+	for (i = 0; i < bulk; i += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + i + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(s + i + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(s + i + 48));
+		_mm_stream_si128((__m128i *)(d + i), a);
+		_mm_stream_si128((__m128i *)(d + i + 16), b);
+		_mm_stream_si128((__m128i *)(d + i + 32), c);
+		_mm_stream_si128((__m128i *)(d + i + 48), e);
+	}
+	_mm_sfence();
+#else
+	bulk = 0;
+#endif
+	memcpy((char *)dest + bulk, (const char *)src + bulk, size - bulk);
+}
+
+void copy_zva(void *dest, const void *src, size_t size)
+{
+#if defined(__aarch64__) && defined(__ARM_NEON)
+	size_t block = zva_block_size();
+	unsigned char *d = dest;
+	const unsigned char *s = src;
+	size_t head, chunk, i;
+
+	if (block == 0 || block > COPY_ZVA_CHUNK) {
+		copy_neon_prefetch(dest, src, size);
+		return;
+	}
+
+	//Bring the destination up to a ZVA block boundary
+	head = (block - ((uintptr_t)d & (block - 1))) & (block - 1);
+	if (head > size)
+		head = size;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+
+	while (size >= block) {
+		chunk = size < COPY_ZVA_CHUNK ? (size & ~(block - 1)) : COPY_ZVA_CHUNK;
+		for (i = 0; i < chunk; i += block)
+			asm volatile("dc zva, %0" : : "r" (d + i) : "memory");
+		neon_copy64(d, s, chunk & ~63UL);
+		memcpy(d + (chunk & ~63UL), s + (chunk & ~63UL), chunk & 63UL);
+		d += chunk;
+		s += chunk;
+		size -= chunk;
+	}
+	memcpy(d, s, size);
+#else
+	/* No DC ZVA outside AArch64 */
+	memcpy(dest, src, size);
+#endif
+}
+
+void copy_neon_prefetch(void *dest, const void *src, size_t size)
+{
+	size_t bulk = size & ~127UL;
+#if defined(__aarch64__)
+	unsigned char *d = dest;
+	const unsigned char *s = src;
+	size_t n = bulk;
+
+	if (n) {
+		asm volatile("1:	prfm pldl1strm, [%[s], #" XSTR(COPY_PREFETCH_DISTANCE) "]\n"
+			     "	prfm pldl1strm, [%[s], #(" XSTR(COPY_PREFETCH_DISTANCE) " + 64)]\n"
+			     "	ld1 {v0.16b, v1.16b, v2.16b, v3.16b}, [%[s]], #64\n"
+			     "	ld1 {v4.16b, v5.16b, v6.16b, v7.16b}, [%[s]], #64\n"
+			     "	subs %[n], %[n], #128\n"
+			     "	st1 {v0.16b, v1.16b, v2.16b, v3.16b}, [%[d]], #64\n"
+			     "	st1 {v4.16b, v5.16b, v6.16b, v7.16b}, [%[d]], #64\n"
+			     "	b.gt 1b\n"
+			     : [d] "+r" (d), [s] "+r" (s), [n] "+r" (n)
+			     :
+			     : "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "cc", "memory");
+	}
+#else
+	/* Host builds fall back to libc */
+	bulk = 0;
+#endif
+	memcpy((char *)dest + bulk, (const char *)src + bulk, size - bulk);
+}
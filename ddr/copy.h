@@ -0,0 +1,31 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#ifndef COPY_H
+#define COPY_H
+
+#include <stddef.h>
+
+/* Bytes read ahead of the source by copy_neon_prefetch() */
+#define COPY_PREFETCH_DISTANCE	512
+
+/*
+ * Copy with LDNP/STNP non-temporal pairs. The destination is streamed
+ * around the caches where the core allows it, so a following flush has
+ * little or nothing to write back.
+ */
+void copy_nt(void *dest, const void *src, size_t size);
+
+/*
+ * Zero each destination cache line with DC ZVA before overwriting it. The
+ * line is allocated without being fetched from DRAM first, which saves the
+ * read half of a regular copy to a cached buffer.
+ */
+void copy_zva(void *dest, const void *src, size_t size);
+
+/* NEON LD1/ST1 with four registers per access and PRFM on the source */
+void copy_neon_prefetch(void *dest, const void *src, size_t size);
+
+#endif /* COPY_H */
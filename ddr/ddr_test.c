@@ -3,6 +3,7 @@
  * Copyright (c) 2022 Sima ai
  */
 
+#define _GNU_SOURCE
 #include <errno.h>
 #include <getopt.h>
 #include <stddef.h>
@@ -15,30 +16,43 @@
 #include <time.h>
 #include <pthread.h>
 #include <libgen.h>
+#include <sched.h>
 #include <simaai/simaai_memory.h>
 
-unsigned long int modify_byte(unsigned long int value, int index, unsigned char new_byte);
-bool check_adjacent_bytes(unsigned long int value, unsigned long int modified, int index);
+#include "hammer.h"
+#include "hist_json.h"
+#include "histogram.h"
+#include "json_report.h"
+#include "latency.h"
+#include "mem_pool.h"
+#include "pattern.h"
+
+#define DDRC_NUM	5
+#define MAX_CPUS	64
+#define PAGE_ALIGN	4096UL
+#define TRAFFIC_LIST	16
+
+/* Long options without a short form */
+enum {
+	OPT_HAMMER = 0x100,
+	OPT_AGGRESSORS,
+	OPT_ROW_SIZE,
+	OPT_BANKS,
+	OPT_HAMMER_FLUSH,
+};
 
 typedef enum {
-	PATTERN_55,
-	PATTERN_AA,
-	PATTERN_5A,
-	PATTERN_A5,
-	PATTERN_55AA,
-	PATTERN_AA55,
-	PATTERN_RANDOM,
-	PATTERN_ADDRESS,
-	PATTERN_USER,
-	PATTERN_WALKING_1,
-	PATTERN_WALKING_0,
-	PATTERN_CHECK_ADJACENT,
-	PATTERN_NUM,
-} pattern_type;
+	PLACEMENT_NONE,
+	PLACEMENT_ROUND_ROBIN,
+	PLACEMENT_COMPACT,
+	PLACEMENT_LIST,
+} placement_policy;
 
 typedef struct {
 	pattern_type type;
 	unsigned long int value;
+	unsigned long int seed;
+	unsigned long int max_errors;
 	unsigned long int size;
 	unsigned int sleep_time;
 	unsigned int ddrc_mask;
@@ -46,14 +60,60 @@ typedef struct {
 	int random;
 	int readback;
 	int performance;
+	int microbench;
+	int latency;
+	int matrix;
+	int traffic;
+	int uncached;
+	int json;
+	int orders;			/* Bit 0 sequential, bit 1 random */
+	unsigned long int reads[TRAFFIC_LIST];
+	unsigned long int strides[TRAFFIC_LIST];
+	unsigned long int bursts[TRAFFIC_LIST];
+	unsigned long int streams[TRAFFIC_LIST];
+	int nreads, nstrides, nbursts, nstreams;
+	hammer_config hammer;
+	unsigned int interval;
+	placement_policy placement;
+	int cpu_list[DDRC_NUM][MAX_CPUS];
+	int cpu_count[DDRC_NUM];
 } args;
 
+/* Failure localization of one worker, filled in by the verify callback */
+typedef struct {
+	unsigned long int phys;		/* Physical address of the buffer */
+	unsigned long int max_print;
+	unsigned long int errors;	/* Mismatched 8-byte words */
+	unsigned long int lanes[8];	/* Failing words per byte lane */
+	unsigned long int bits[64];	/* Flips per data bit */
+	int ddrc;
+} error_log;
+
+/* Written by the owning worker only, sampled by the reporter thread */
+typedef struct {
+	histogram latency;		/* Iteration latency in ns */
+	unsigned long int bytes;
+} __attribute__((aligned(64))) worker_stats;
+
 typedef struct {
 	pthread_t thread;
 	volatile int active;
-	simaai_memory_t * buffer;
+	worker_stats stats;
+	error_log log;
+	mem_pool *pool;			/* Controller pool the buffer comes from */
+	mem_block block;
+	mem_pool *input_pool;		/* Copy source pool in performance mode */
+	mem_block input;
+	const hammer_config *hammer;
+	hammer_stats hammer_stats;
+	int ddrc;
+	int cpu;
+	int failed;
+	unsigned long int iterations;
+	double elapsed;
 	pattern_type type;
 	unsigned long int value;
+	unsigned long int seed;
 	unsigned long int size;
 	int random;
 	int readback;
@@ -61,6 +121,14 @@ typedef struct {
 	unsigned int sleep_time;
 } load_task;
 
+typedef struct {
+	pthread_t thread;
+	volatile int active;
+	load_task *tasks;
+	int count;
+	unsigned int interval;		/* ms */
+} reporter;
+
 static int targets[] = {
 		SIMAAI_MEM_TARGET_DMS0,
 		SIMAAI_MEM_TARGET_DMS1,
@@ -69,6 +137,105 @@ static int targets[] = {
 		SIMAAI_MEM_TARGET_OCM,
 };
 
+static const char *target_names[] = {
+		"DMS0",
+		"DMS1",
+		"DMS2",
+		"DMS3",
+		"OCM",
+};
+
+/*
+ * Parse "DDRC=CPUS[;DDRC=CPUS...]" where CPUS is a comma separated list of
+ * cores or ranges, e.g. "0=0-1;1=2,3;4=7".
+ */
+static int parse_cpu_lists(const char *str, args *args)
+{
+	unsigned long int ddrc, first, last;
+	const char *p = str;
+	char *end;
+
+	memset(args->cpu_count, 0, sizeof(args->cpu_count));
+	while (*p) {
+		ddrc = strtoul(p, &end, 10);
+		if (end == p || *end != '=' || ddrc >= DDRC_NUM)
+			return -1;
+		p = end + 1;
+		do {
+			first = strtoul(p, &end, 10);
+			if (end == p)
+				return -1;
+			last = first;
+			if (*end == '-') {
+				p = end + 1;
+				last = strtoul(p, &end, 10);
+				if (end == p || last < first)
+					return -1;
+			}
+			for (; first <= last; first++) {
+				if (first >= MAX_CPUS || args->cpu_count[ddrc] >= MAX_CPUS)
+					return -1;
+				args->cpu_list[ddrc][args->cpu_count[ddrc]++] = first;
+			}
+			p = end;
+		} while (*p == ',' && *++p);
+		if (*p == ';')
+			p++;
+		else if (*p)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* Comma separated list of numbers, each with an optional K suffix */
+static int parse_list(const char *str, unsigned long int *values, int *count)
+{
+	const char *p = str;
+	char *end;
+
+	*count = 0;
+	do {
+		if (*count >= TRAFFIC_LIST)
+			return -1;
+		values[*count] = strtoul(p, &end, 0);
+		if (end == p)
+			return -1;
+		if (*end == 'K' || *end == 'k') {
+			values[*count] <<= 10;
+			end++;
+		}
+		(*count)++;
+		p = end;
+	} while (*p == ',' && *++p);
+
+	return *p ? -1 : 0;
+}
+
+/* Comma separated "OFFSET:OFFSET" aggressor pairs, offsets in the buffer */
+static int parse_pairs(const char *str, hammer_config *cfg)
+{
+	const char *p = str;
+	char *end;
+
+	cfg->npairs = 0;
+	do {
+		if (cfg->npairs >= HAMMER_MAX_PAIRS)
+			return -1;
+		cfg->pairs[cfg->npairs][0] = strtoul(p, &end, 0);
+		if (end == p || *end != ':')
+			return -1;
+		p = end + 1;
+		cfg->pairs[cfg->npairs][1] = strtoul(p, &end, 0);
+		if (end == p)
+			return -1;
+		cfg->npairs++;
+		p = end;
+	} while (*p == ',' && *++p);
+
+	return *p ? -1 : 0;
+}
+
 static int parse_args(const int argc, char *const argv[], args *args)
 {
 	char *filename = argv[0];
@@ -80,9 +247,30 @@ static int parse_args(const int argc, char *const argv[], args *args)
 		{ "value",    required_argument, NULL, 'v' },
 		{ "time",     required_argument, NULL, 't' },
 		{ "size",     required_argument, NULL, 's' },
-		{ "threads",  required_argument, NULL, 't' },
+		{ "workers",  required_argument, NULL, 'w' },
 		{ "random",   no_argument,       NULL, 'r' },
 		{ "performance", no_argument,    NULL, 'f' },
+		{ "microbench", no_argument,     NULL, 'm' },
+		{ "placement", required_argument, NULL, 'P' },
+		{ "cpus",     required_argument, NULL, 'c' },
+		{ "interval", required_argument, NULL, 'i' },
+		{ "latency",  no_argument,       NULL, 'l' },
+		{ "seed",     required_argument, NULL, 'S' },
+		{ "max-errors", required_argument, NULL, 'e' },
+		{ "matrix",   no_argument,       NULL, 'M' },
+		{ "traffic",  no_argument,       NULL, 'g' },
+		{ "json",     no_argument,       NULL, 'j' },
+		{ "reads",    required_argument, NULL, 'R' },
+		{ "stride",   required_argument, NULL, 'T' },
+		{ "burst",    required_argument, NULL, 'B' },
+		{ "streams",  required_argument, NULL, 'N' },
+		{ "order",    required_argument, NULL, 'O' },
+		{ "uncached", no_argument,       NULL, 'u' },
+		{ "hammer",   required_argument, NULL, OPT_HAMMER },
+		{ "aggressors", required_argument, NULL, OPT_AGGRESSORS },
+		{ "row-size", required_argument, NULL, OPT_ROW_SIZE },
+		{ "banks",    required_argument, NULL, OPT_BANKS },
+		{ "hammer-flush", no_argument,   NULL, OPT_HAMMER_FLUSH },
 		{ 0,        0,                 0,     0  }
 	};
 	const char usage[] =
@@ -91,8 +279,9 @@ static int parse_args(const int argc, char *const argv[], args *args)
 		"\n"
 		"  -h, --help            Display this help and exit\n"
 		"  -d, --ddrcmask=MASK   Hex mask of controllers to be tested, default: 0xf (all)\n"
-		"  -b, --readback        Read test after populating buffer, default: no\n"
-		"  -p, --pattern=[0..11]  Pattern to use for testing, default: random\n"
+		"  -b, --readback        Read the buffer back from memory after populating it and verify\n"
+		"                        every word, exit status is non-zero on mismatch, default: no\n"
+		"  -p, --pattern=[0..12]  Pattern to use for testing, default: random\n"
 		"                        Possible options:\n"
 		"                            0 - 0x55\n"
 		"                            1 - 0xAA\n"
@@ -106,18 +295,54 @@ static int parse_args(const int argc, char *const argv[], args *args)
 		"                            9 - Walking 1's - 0x8040201008040201\n"
 		"                            10 - Walking 0's - 0x7FBFDFEFF7FBFDFE\n"
 		"                            11 - Checking adjacent bits upon modifying 2 bits in between\n"
+		"                            12 - Row hammer, VALUE in victim rows and its complement in aggressors\n"
 		"  -v, --value=VALUE     Hex value of 8-byte pattern to use for testing in case if user defined pattern, default: 0xA55AAA555AA555AA\n"
 		"  -t, --time=TIME       Time to run test, if 0 - run forever, default: run forever\n"
 		"  -s, --size=SIZE       Size of the buffer to use for test, default: 0x100000\n"
 		"  -w, --workers=THREADS Number of worker threads per DDRC, default: 1\n"
 		"  -r, --random          Access to buffer not in sequential, but random order, default: no\n"
-		"  -f, --performance     prints bandwidth number of bytes per second default:no\n";
+		"  -f, --performance     prints bandwidth number of bytes per second default:no\n"
+		"  -m, --microbench      Compare pattern fill/verify bandwidth against the scalar loop and exit\n"
+		"  -P, --placement=POLICY Worker CPU placement, default: rr\n"
+		"                        Possible options:\n"
+		"                            none    - no affinity, leave it to the scheduler\n"
+		"                            rr      - interleave controllers across cores\n"
+		"                            compact - workers of one controller on adjacent cores\n"
+		"                            list    - explicit cores per controller, see --cpus\n"
+		"  -c, --cpus=LIST       Cores per controller for list placement, e.g. \"0=0-1;1=2,3;4=7\"\n"
+		"  -i, --interval=MS     Bandwidth and latency report interval in performance mode, 0 - off, default: 1000\n"
+		"  -S, --seed=SEED       Seed of the random pattern, default: current time\n"
+		"  -e, --max-errors=N    Number of failing words printed per worker, default: 16\n"
+		"  -j, --json            Print one JSON record per pattern, performance, latency, matrix or\n"
+		"                        traffic run or point on stdout\n"
+		"  -l, --latency         Measure pointer-chasing load latency for working sets from 4KiB up to SIZE\n"
+		"                        on every controller in MASK, cached and uncached, and exit\n"
+		"  -M, --matrix          Measure read, write and copy bandwidth of every controller in MASK alone,\n"
+		"                        between each pair, all at once and pairwise at once, and exit.\n"
+		"                        Use a SIZE well above the last level cache, TIME sets seconds per point\n"
+		"  -g, --traffic         Sweep a read/write traffic generator over every combination of the lists\n"
+		"                        below on every controller in MASK, print GB/s of each and exit.\n"
+		"                        SIZE is the buffer of each worker, at least 4 times the last level cache\n"
+		"                        unless uncached, TIME sets seconds per point\n"
+		"  -R, --reads=LIST      Percent of bursts that are reads, default: 100,50,0\n"
+		"  -T, --stride=LIST     Bytes from one burst of a stream to the next, default: 64,128,...,8K\n"
+		"  -B, --burst=LIST      Bytes accessed back to back, multiple of 8, default: 64\n"
+		"  -N, --streams=LIST    Interleaved address streams per worker, default: 1,4\n"
+		"  -O, --order=ORDER     Burst order within a stream, seq, rand or both, default: seq\n"
+		"  -u, --uncached        Run the traffic generator on uncached buffers, default: cached\n"
+		"      --hammer=COUNT    Reads of each aggressor per pair in row hammer mode, default: 500000\n"
+		"      --aggressors=LIST Aggressor pairs as hex buffer offsets, e.g. \"0x0:0x10000,0x2000:0x12000\",\n"
+		"                        default: every row of every bank hammered from its two neighbours\n"
+		"      --row-size=BYTES  Bytes of one DRAM row of one bank, default: 0x2000\n"
+		"      --banks=N         Banks rows rotate through, bank = phys / row-size %% N, default: 8\n"
+		"      --hammer-flush    Hammer a cached buffer and evict both lines after every read instead\n"
+		"                        of using an uncached buffer, needed on the host backend\n";
 	int option_index;
 	int c;
 
 	while (1) {
 		option_index = 0;
-		c = getopt_long(argc, argv, "hd:p:v:t:s:w:rbf", long_options, &option_index);
+		c = getopt_long(argc, argv, "hd:p:v:t:s:w:rbfmP:c:i:lS:e:MgR:T:B:N:O:uj", long_options, &option_index);
 
 		if (c == -1)
 			break;
@@ -139,7 +364,7 @@ static int parse_args(const int argc, char *const argv[], args *args)
 			break;
 		case 'p':
 			args->type = (pattern_type)strtol(optarg, NULL, 10);
-			if (args->type > PATTERN_NUM) {
+			if (args->type >= PATTERN_NUM) {
 				fprintf(stderr, "Invalid pattern type\n");
 				return -1;
 			}
@@ -165,6 +390,116 @@ static int parse_args(const int argc, char *const argv[], args *args)
 		case 'f':
 			args->performance = 1;
 			break;
+		case 'm':
+			args->microbench = 1;
+			break;
+		case 'P':
+			if (strcmp(optarg, "none") == 0)
+				args->placement = PLACEMENT_NONE;
+			else if (strcmp(optarg, "rr") == 0)
+				args->placement = PLACEMENT_ROUND_ROBIN;
+			else if (strcmp(optarg, "compact") == 0)
+				args->placement = PLACEMENT_COMPACT;
+			else if (strcmp(optarg, "list") == 0)
+				args->placement = PLACEMENT_LIST;
+			else {
+				fprintf(stderr, "Invalid placement policy\n");
+				return -1;
+			}
+			break;
+		case 'l':
+			args->latency = 1;
+			break;
+		case 'M':
+			args->matrix = 1;
+			break;
+		case 'g':
+			args->traffic = 1;
+			break;
+		case 'R':
+			if (parse_list(optarg, args->reads, &args->nreads) != 0) {
+				fprintf(stderr, "Invalid reads list\n");
+				return -1;
+			}
+			break;
+		case 'T':
+			if (parse_list(optarg, args->strides, &args->nstrides) != 0) {
+				fprintf(stderr, "Invalid strides list\n");
+				return -1;
+			}
+			break;
+		case 'B':
+			if (parse_list(optarg, args->bursts, &args->nbursts) != 0) {
+				fprintf(stderr, "Invalid bursts list\n");
+				return -1;
+			}
+			break;
+		case 'N':
+			if (parse_list(optarg, args->streams, &args->nstreams) != 0) {
+				fprintf(stderr, "Invalid streams list\n");
+				return -1;
+			}
+			break;
+		case 'O':
+			if (strcmp(optarg, "seq") == 0)
+				args->orders = 1;
+			else if (strcmp(optarg, "rand") == 0)
+				args->orders = 2;
+			else if (strcmp(optarg, "both") == 0)
+				args->orders = 3;
+			else {
+				fprintf(stderr, "Invalid order\n");
+				return -1;
+			}
+			break;
+		case 'u':
+			args->uncached = 1;
+			break;
+		case 'j':
+			args->json = 1;
+			break;
+		case OPT_HAMMER:
+			args->hammer.count = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_AGGRESSORS:
+			if (parse_pairs(optarg, &args->hammer) != 0) {
+				fprintf(stderr, "Invalid aggressor list\n");
+				return -1;
+			}
+			break;
+		case OPT_ROW_SIZE:
+			args->hammer.row_size = strtoul(optarg, NULL, 16);
+			if (args->hammer.row_size < 64 || args->hammer.row_size % 64) {
+				fprintf(stderr, "Invalid row size\n");
+				return -1;
+			}
+			break;
+		case OPT_BANKS:
+			args->hammer.banks = strtoul(optarg, NULL, 10);
+			if (args->hammer.banks == 0 || args->hammer.banks > HAMMER_MAX_BANKS) {
+				fprintf(stderr, "Invalid bank count\n");
+				return -1;
+			}
+			break;
+		case OPT_HAMMER_FLUSH:
+			args->hammer.flush = 1;
+			break;
+		case 'S':
+			args->seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			args->max_errors = strtoul(optarg, NULL, 10);
+			break;
+		case 'i':
+			args->interval = strtoul(optarg, NULL, 10);
+			break;
+		case 'c':
+			if (parse_cpu_lists(optarg, args) != 0) {
+				fprintf(stderr, "Invalid CPU list\n");
+				return -1;
+			}
+			args->placement = PLACEMENT_LIST;
+			break;
 		default:
 			fprintf(stderr, usage, basename(filename));
 			return -1;
@@ -174,176 +509,1359 @@ static int parse_args(const int argc, char *const argv[], args *args)
 
 	return 0;
 }
-unsigned long int modify_byte(unsigned long int value, int index, unsigned char new_byte) {
-	unsigned long int mask = 0xFFUL << (index * 8);
-	value&=~mask;
-	value|=((unsigned long int)new_byte << (index * 8));
-	return value;
-}
-bool check_adjacent_bytes(unsigned long int value, unsigned long int modified, int index) {
-	unsigned long int mask_left = 0xFFUL << ((index+1) * 8);
-	unsigned long int mask_right = 0xFFUL >> ((7-index) * 8);
 
-	if(((value&mask_left)!=(modified&mask_left))&&((value&mask_right)!=(modified&mask_right)))
-		return false;
-	else
-		return true;
+static void log_error(void *ctx, unsigned long int offset, unsigned long int expected,
+		      unsigned long int actual)
+{
+	error_log *log = (error_log *)ctx;
+	unsigned long int diff = expected ^ actual;
+	int lane;
+
+	if (log->errors++ < log->max_print)
+		fprintf(stderr, "ERROR: DDRC%d phys 0x%010lx: expected 0x%016lx, read 0x%016lx, xor 0x%016lx\n",
+				log->ddrc, log->phys + offset, expected, actual, diff);
+
+	for (lane = 0; lane < 8; lane++)
+		if ((diff >> (lane * 8)) & 0xff)
+			log->lanes[lane]++;
+	while (diff) {
+		log->bits[__builtin_ctzl(diff)]++;
+		diff &= diff - 1;
+	}
 }
+
 static void* loader_task(void *arg)
 {
 	volatile load_task *task = (volatile load_task *)arg;
-	unsigned long int value, i, offset, dummy = 0, err_count = 0;
+	load_task *t = (load_task *)arg;
+	worker_stats *stats = (worker_stats *)&((load_task *)arg)->stats;
 	unsigned long int *addr;
 	unsigned long int bytes_count = 0;
-	struct timespec start, current;
-	double elapsed_time;
+	//Whole pages, so a buffer reserved on its own spans its slab
+	size_t block = (t->size + PAGE_ALIGN - 1) & ~(PAGE_ALIGN - 1);
+	unsigned int pass;
+	struct timespec start, current, previous;
+	double elapsed_time = 0;
+	error_log *log = (error_log *)&((load_task *)arg)->log;
+	pattern_desc desc;
+	pattern_result result, check;
+	void *input_addr = NULL;
 
 	if(!task)
 		return NULL;
-	addr = (unsigned long int *)simaai_memory_map(task->buffer);
-	if (addr == NULL) {
-		fprintf(stderr, "Memory mapping failed\n");
+
+	//Sub-buffers of slabs reserved by main, so workers never wait on CMA
+	if (mem_pool_alloc(t->pool, block, PAGE_ALIGN, &t->block) != 0) {
+		fprintf(stderr, "ERROR: Buffer is NULL\n");
+		task->failed = 1;
 		return NULL;
 	}
+	addr = (unsigned long int *)t->block.virt;
 
-	switch(task->type) {
-	case PATTERN_55:
-		value = 0x5555555555555555;
-		break;
-	case PATTERN_AA:
-		value = 0xAAAAAAAAAAAAAAAA;
-		break;
-	case PATTERN_5A:
-		value = 0x5A5A5A5A5A5A5A5A;
-		break;
-	case PATTERN_A5:
-		value = 0xA5A5A5A5A5A5A5A5;
-		break;
-	case PATTERN_55AA:
-		value = 0x55AA55AA55AA55AA;
-		break;
-	case PATTERN_AA55:
-		value = 0xAA55AA55AA55AA55;
-		break;
-	case PATTERN_WALKING_1:
-		for (i = 0; i < (task->size); i++){
-			for (int bit = 0; bit < 8; bit++) {
-				unsigned char val = (1 << (7-bit));
-				((volatile char *)addr)[i] = val;
-				unsigned char read = ((volatile char *)addr)[i];
-				if(read != val){
-					fprintf(stderr, "Data mismatch in Walking 1\n");
-				}
-			}
-		}
-		break;
-	case PATTERN_WALKING_0:
-		for (i = 0; i < (task->size); i++){
-			for (int bit = 0; bit < 8; bit++) {
-				unsigned char val = ~(1 << (7-bit));
-				((volatile char *)addr)[i] = val;
-				unsigned char read = ((volatile char *)addr)[i];
-				if(read != val){
-					fprintf(stderr, "Data mismatch in Walking 0\n");
-				}
-			}
+	log->ddrc = task->ddrc;
+	log->phys = t->block.phys;
+	memset(&result, 0, sizeof(result));
+	result.on_error = log_error;
+	result.ctx = log;
+	desc.type = task->type;
+	desc.value = task->value;
+	desc.seed = task->seed;
+	desc.base = (unsigned long int)addr;
+	desc.random_order = task->random;
+
+	if (task->performance) {
+		if (mem_pool_alloc(t->input_pool, block, PAGE_ALIGN, &t->input) != 0) {
+			fprintf(stderr, "Input buffer allocation failed\n");
+			mem_pool_free(t->pool, &t->block);
+			task->failed = 1;
+			return NULL;
 		}
-		break;
-	case PATTERN_CHECK_ADJACENT:
-	case PATTERN_USER:
-	default:
-		value = task->value;
-		break;
+		input_addr = t->input.virt;
+		memset(input_addr, 0xAA, task->size);
+		memset(addr, 0, task->size);
 	}
 
-	static int target = SIMAAI_MEM_TARGET_DMS0;
-
-	simaai_memory_t *input_buffer = simaai_memory_alloc_flags(task->size, target, SIMAAI_MEM_FLAG_CACHED);
-    if (!input_buffer) {
-        perror("Input buffer allocation failed");
-    }
-    void *input_addr = simaai_memory_map(input_buffer);
-    if (!input_addr) {
-        perror("Input buffer mapping failed");
-        simaai_memory_free(input_buffer);
-    }
-
-	memset(input_addr, 0xAA, task->size);
-
 	double time_diff(struct timespec *start, struct timespec *end) {
     	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
 	}
 	clock_gettime(CLOCK_MONOTONIC, &start);
+	previous = start;
 
 	while(task->active) {
 		if (task->performance){
 			memcpy(addr, input_addr, task->size);
 			clock_gettime(CLOCK_MONOTONIC, &current);
-			elapsed_time = time_diff(&start, &current);			
+			//Whole iteration, including the flush of the previous one
+			hist_record(&stats->latency, (current.tv_sec - previous.tv_sec) * 1000000000UL +
+					current.tv_nsec - previous.tv_nsec);
+			__atomic_store_n(&stats->bytes, stats->bytes + task->size, __ATOMIC_RELAXED);
+			previous = current;
+			elapsed_time = time_diff(&start, &current);
 			if(elapsed_time >= (double)(task->sleep_time)) {
 				task->active=0;
 				break;
 			} else {
-				bytes_count += (task->size / (1024*1024));
+				bytes_count += task->size;
+				task->iterations++;
 			}
 		} 
+		else if (task->type == PATTERN_ROWHAMMER) {
+			if (hammer_run(addr, t->block.phys, task->size, t->hammer, &task->active,
+				       &t->hammer_stats, &result) != 0) {
+				fprintf(stderr, "ERROR: No aggressor pair fits in the buffer\n");
+				task->failed = 1;
+			}
+			task->active = 0;
+		}
 		else {
-			for(i = 0; (i < (task->size >> 8)); i++) {
-				if(task->random)
-					offset = random() % (task->size >> 8);
-				else
-					offset = i;
-
-				if(task->type == PATTERN_RANDOM)
-					value = random();
-				else if(task->type == PATTERN_ADDRESS)
-					value = (long unsigned int)&(addr[offset]);
-				else if(task->type == PATTERN_CHECK_ADJACENT){
-					int index = 3;
-					unsigned char new_byte = 0x55;
-					unsigned long int modified = modify_byte(value, index, new_byte); 
-					if (!check_adjacent_bytes(value, modified, index)) {
-						err_count++;
-						break;
-					}
-				}
-				else 
-					addr[offset] = value;
+			for (pass = 0; pass < pattern_passes(task->type); pass++) {
+				pattern_fill(addr, task->size, &desc, pass);
+				//Walking and adjacent patterns check every pass right away
+				if (pattern_passes(task->type) > 1 || task->type == PATTERN_CHECK_ADJACENT)
+					pattern_verify(addr, task->size, &desc, pass, &result);
 			}
 			task->active = 0;
 		}
-		simaai_memory_flush_cache(task->buffer);
+		mem_block_flush(t->pool, &t->block);
 		if(task->readback)
 			break;
 	}
 
-	fprintf(stderr, "Bytes Count (MB): %ld\n", bytes_count);
+	task->elapsed = elapsed_time;
+	fprintf(stderr, "Bytes Count (MB): %.2f\n", (double)bytes_count / (1024 * 1024));
 	fprintf(stderr, "Elapsed Time: %.2fs\n", elapsed_time);
 	
 	if (task->performance)
-			fprintf(stderr, "Throughput: %.2fGB/s\n", ((double) bytes_count/(1024*elapsed_time)));
+			fprintf(stderr, "Throughput: %.2fGB/s\n",
+					((double)bytes_count / (1024 * 1024 * 1024 * elapsed_time)));
 		else
 			fprintf(stderr, "Pattern Loaded\n");
 
-	if (err_count > 0)
-		fprintf(stderr, "ERROR: Adjacent bits disturbed %lu\n", err_count);
+	if (task->type == PATTERN_ROWHAMMER && !task->failed) {
+		char name[16];
+
+		snprintf(name, sizeof(name), "DDRC%d", task->ddrc);
+		hammer_report(&t->hammer_stats, t->hammer, stderr, name);
+	}
+
+	if (result.mismatches > 0) {
+		if (task->type == PATTERN_ROWHAMMER)
+			fprintf(stderr, "ERROR: Row hammer disturbed victim rows\n");
+		else if (task->type == PATTERN_CHECK_ADJACENT)
+			fprintf(stderr, "ERROR: Adjacent bits disturbed %lu\n", result.mismatches);
+		else if (task->type == PATTERN_WALKING_1)
+			fprintf(stderr, "Data mismatch in Walking 1\n");
+		else
+			fprintf(stderr, "Data mismatch in Walking 0\n");
+		fprintf(stderr, "ERROR: %lu mismatched words, first at offset 0x%lx: expected 0x%016lx, read 0x%016lx\n",
+				result.mismatches, result.first_offset,
+				result.first_expected, result.first_actual);
+	}
+
+	if(task->readback && !task->performance) {
+		//Drop cached lines, then stream the whole buffer back from memory
+		mem_block_invalidate(t->pool, &t->block);
+		memset(&check, 0, sizeof(check));
+		check.on_error = log_error;
+		check.ctx = log;
+		pattern_verify(addr, task->size, &desc, pattern_passes(task->type) - 1, &check);
+		if (check.mismatches > 0)
+			fprintf(stderr, "ERROR: Readback found %lu mismatched words, first at offset 0x%lx\n",
+					check.mismatches, check.first_offset);
+		else
+			fprintf(stderr, "Pattern Verified\n");
+	}
+	if (task->performance)
+		mem_pool_free(t->input_pool, &t->input);
+	mem_pool_free(t->pool, &t->block);
 
-	if(task->readback) {
-		task->active = 1;
-		while(task->active) {
-			simaai_memory_invalidate_cache(task->buffer);
-			for(i = 0; i < (task->size >> 8); i++) {
-				dummy += addr[offset];
+	return NULL;
+}
+
+/*
+ * Print bandwidth and iteration latency percentiles of all workers every
+ * interval, computed from the difference between two snapshots of their
+ * stats, so stalls show up while the test runs.
+ */
+static void* reporter_task(void *arg)
+{
+	reporter *rep = (reporter *)arg;
+	histogram *prev, snap, delta, merged;
+	unsigned long int *prev_bytes, bytes, total;
+	struct timespec start, next, now, last;
+	double seconds;
+	int i;
+
+	prev = (histogram *)calloc(rep->count, sizeof(*prev));
+	prev_bytes = (unsigned long int *)calloc(rep->count, sizeof(*prev_bytes));
+	if (!prev || !prev_bytes) {
+		fprintf(stderr, "Not enough memory for reporter\n");
+		free(prev);
+		free(prev_bytes);
+		return NULL;
+	}
+	for (i = 0; i < rep->count; i++)
+		hist_init(&prev[i]);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	next = last = start;
+	while (rep->active) {
+		next.tv_sec += rep->interval / 1000;
+		next.tv_nsec += (rep->interval % 1000) * 1000000L;
+		if (next.tv_nsec >= 1000000000L) {
+			next.tv_sec++;
+			next.tv_nsec -= 1000000000L;
+		}
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		if (!rep->active)
+			break;
+
+		hist_init(&merged);
+		total = 0;
+		for (i = 0; i < rep->count; i++) {
+			hist_snapshot(&snap, &rep->tasks[i].stats.latency);
+			hist_delta(&delta, &snap, &prev[i]);
+			hist_merge(&merged, &delta);
+			prev[i] = snap;
+
+			bytes = __atomic_load_n(&rep->tasks[i].stats.bytes, __ATOMIC_RELAXED);
+			total += bytes - prev_bytes[i];
+			prev_bytes[i] = bytes;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		seconds = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) / 1e9;
+		last = now;
+		fprintf(stderr, "[%8.2fs] %8.2fGB/s  p50 %9.3fms  p99 %9.3fms  p99.9 %9.3fms  max %9.3fms\n",
+				(now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9,
+				total / (seconds * 1024 * 1024 * 1024),
+				hist_percentile(&merged, 0.50) / 1e6,
+				hist_percentile(&merged, 0.99) / 1e6,
+				hist_percentile(&merged, 0.999) / 1e6,
+				merged.total ? merged.max / 1e6 : 0);
+	}
+
+	free(prev);
+	free(prev_bytes);
+
+	return NULL;
+}
+
+/* Size of the largest CPU cache in bytes, 0 if sysfs does not say */
+static unsigned long int llc_size(void)
+{
+	unsigned long int size, largest = 0;
+	char path[64], unit;
+	FILE *f;
+	int i, n;
+
+	for (i = 0; i < 8; i++) {
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+		f = fopen(path, "r");
+		if (!f)
+			break;
+		unit = '\0';
+		n = fscanf(f, "%lu%c", &size, &unit);
+		fclose(f);
+		if (n < 1)
+			continue;
+		if (unit == 'K')
+			size <<= 10;
+		else if (unit == 'M')
+			size <<= 20;
+		if (size > largest)
+			largest = size;
+	}
+
+	return largest;
+}
+
+static int allowed_cpus(int *cpus)
+{
+	cpu_set_t set;
+	int i, n = 0;
+
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		return 0;
+	for (i = 0; i < CPU_SETSIZE && n < MAX_CPUS; i++)
+		if (CPU_ISSET(i, &set))
+			cpus[n++] = i;
+
+	return n;
+}
+
+/*
+ * Core for worker number "worker" of controller "ddrc", which is the
+ * "ctrl"-th of "nctrl" selected controllers. Returns -1 for no pinning.
+ */
+static int worker_cpu(const args *args, int ddrc, int ctrl, int nctrl, int worker,
+		      const int *cpus, int ncpus)
+{
+	if (ncpus == 0)
+		return -1;
+
+	switch (args->placement) {
+	case PLACEMENT_ROUND_ROBIN:
+		return cpus[(worker * nctrl + ctrl) % ncpus];
+	case PLACEMENT_COMPACT:
+		return cpus[(ctrl * args->threads + worker) % ncpus];
+	case PLACEMENT_LIST:
+		if (args->cpu_count[ddrc] == 0)
+			return -1;
+		return args->cpu_list[ddrc][worker % args->cpu_count[ddrc]];
+	default:
+		return -1;
+	}
+}
+
+static double elapsed_since(const struct timespec *start)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Scalar store loop the loader used before the pattern engine, kept as a
+ * reference point for the microbenchmark.
+ */
+static void legacy_fill(unsigned long int *addr, unsigned long int words,
+			pattern_type type, unsigned long int value)
+{
+	unsigned long int i;
+
+	for (i = 0; i < words; i++) {
+		if (type == PATTERN_RANDOM)
+			value = random();
+		else if (type == PATTERN_ADDRESS)
+			value = (unsigned long int)&(addr[i]);
+		addr[i] = value;
+	}
+}
+
+static int microbench(args *args)
+{
+	static const pattern_type types[] = { PATTERN_55, PATTERN_ADDRESS, PATTERN_RANDOM };
+	static const char *names[] = { "0x55", "address", "random" };
+	double t_legacy, t_fill, t_verify, gb;
+	unsigned long int *addr;
+	unsigned int loops, n, i;
+	simaai_memory_t *buffer;
+	struct timespec start;
+	pattern_desc desc;
+	pattern_result result;
+	int target = -1;
+
+	for (i = 0; i < 5; i++)
+		if ((args->ddrc_mask >> i) & 1) {
+			target = targets[i];
+			break;
+		}
+	if (target < 0) {
+		fprintf(stderr, "Invalid DDRC mask\n");
+		return EXIT_FAILURE;
+	}
+
+	buffer = simaai_memory_alloc_flags(args->size, target, SIMAAI_MEM_FLAG_CACHED);
+	if (buffer == NULL) {
+		fprintf(stderr, "ERROR: Buffer is NULL\n");
+		return EXIT_FAILURE;
+	}
+	addr = (unsigned long int *)simaai_memory_map(buffer);
+	if (addr == NULL) {
+		fprintf(stderr, "Memory mapping failed\n");
+		simaai_memory_free(buffer);
+		return EXIT_FAILURE;
+	}
+
+	//Move at least 256MiB per measurement so short buffers are not timer bound
+	loops = (256UL << 20) / args->size;
+	if (loops == 0)
+		loops = 1;
+	gb = (double)args->size * loops / (1024.0 * 1024.0 * 1024.0);
+
+	printf("Buffer: 0x%lx bytes, %u loops\n", args->size, loops);
+	printf("%-10s %14s %14s %14s\n", "Pattern", "Legacy GB/s", "Fill GB/s", "Verify GB/s");
+	for (n = 0; n < sizeof(types) / sizeof(types[0]); n++) {
+		memset(&desc, 0, sizeof(desc));
+		memset(&result, 0, sizeof(result));
+		desc.type = types[n];
+		desc.value = args->value;
+		desc.seed = 1;
+		desc.base = (unsigned long int)addr;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < loops; i++)
+			legacy_fill(addr, args->size / sizeof(*addr), types[n], pattern_value(&desc, 0));
+		t_legacy = elapsed_since(&start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < loops; i++)
+			pattern_fill(addr, args->size, &desc, 0);
+		t_fill = elapsed_since(&start);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < loops; i++)
+			pattern_verify(addr, args->size, &desc, 0, &result);
+		t_verify = elapsed_since(&start);
+
+		printf("%-10s %14.2f %14.2f %14.2f\n", names[n], gb / t_legacy, gb / t_fill, gb / t_verify);
+		if (result.mismatches)
+			fprintf(stderr, "ERROR: %lu mismatched words, first at offset 0x%lx\n",
+					result.mismatches, result.first_offset);
+	}
+
+	simaai_memory_unmap(buffer);
+	simaai_memory_free(buffer);
+
+	return EXIT_SUCCESS;
+}
+
+#define LATENCY_MIN_SIZE	0x1000UL
+#define LATENCY_MIN_TIME	0.1
+#define LATENCY_MAX_STEPS	64
+
+/* One record per working set size of the latency sweep */
+static void json_latency_point(int ddrc, int flags, unsigned long int size, double ns,
+			       unsigned long int accesses)
+{
+	json_record r;
+
+	json_begin(&r, stdout, "ddr_test", "latency");
+	json_object_begin(&r, "params");
+	json_string(&r, "ddrc", target_names[ddrc]);
+	json_uint(&r, "size", size);
+	json_bool(&r, "cached", (flags & SIMAAI_MEM_FLAG_CACHED) != 0);
+	json_uint(&r, "stride", CHASE_STRIDE);
+	json_object_end(&r);
+	json_double(&r, "duration_s", ns * accesses / 1e9);
+	json_uint(&r, "accesses", accesses);
+	//A chase only yields a mean, latency_ns is kept for distributions
+	json_double(&r, "mean_latency_ns", ns);
+	json_string(&r, "status", "pass");
+	json_end(&r);
+}
+
+/*
+ * Sweep the working set of a pointer chase from 4KiB up to args->size on
+ * every selected controller, with and without SIMAAI_MEM_FLAG_CACHED, and
+ * print ns per access as one column per controller and mapping. Only one
+ * buffer is allocated at a time, so OCM can be swept up to its full size.
+ */
+static int latency_sweep(args *args)
+{
+	static const int flags[] = { SIMAAI_MEM_FLAG_CACHED, SIMAAI_MEM_FLAG_DEFAULT };
+	static double results[DDRC_NUM * 2][LATENCY_MAX_STEPS];
+	int used[DDRC_NUM * 2] = { 0 };
+	simaai_memory_t *buffer;
+	unsigned long int size, accesses;
+	int i, f, n, step, steps = 0;
+	char name[16];
+	void *addr, *start;
+
+	for (size = LATENCY_MIN_SIZE; size <= args->size && steps < LATENCY_MAX_STEPS; size *= 2)
+		steps++;
+	if (steps == 0) {
+		fprintf(stderr, "Size must be at least 0x%lx for latency mode\n", LATENCY_MIN_SIZE);
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < DDRC_NUM; i++) {
+		if (!((args->ddrc_mask >> i) & 1))
+			continue;
+		for (f = 0; f < 2; f++) {
+			n = i * 2 + f;
+			buffer = simaai_memory_alloc_flags(args->size, targets[i], flags[f]);
+			if (buffer == NULL) {
+				fprintf(stderr, "ERROR: Buffer is NULL\n");
+				return EXIT_FAILURE;
 			}
-			task->active = 0;
+			addr = simaai_memory_map(buffer);
+			if (addr == NULL) {
+				fprintf(stderr, "Memory mapping failed\n");
+				simaai_memory_free(buffer);
+				return EXIT_FAILURE;
+			}
+
+			for (step = 0, size = LATENCY_MIN_SIZE; step < steps; step++, size *= 2) {
+				start = chase_build(addr, size, size ^ n);
+				if (flags[f] & SIMAAI_MEM_FLAG_CACHED)
+					simaai_memory_flush_cache(buffer);
+				//Warm up caches and TLBs with one untimed chunk
+				chase_run(start, 0, NULL);
+				results[n][step] = chase_run(start, LATENCY_MIN_TIME, &accesses);
+				if (args->json)
+					json_latency_point(i, flags[f], size, results[n][step], accesses);
+			}
+			used[n] = 1;
+
+			simaai_memory_unmap(buffer);
+			simaai_memory_free(buffer);
+		}
+	}
+	if (args->json)
+		return EXIT_SUCCESS;
+
+	printf("Latency (ns/access)\n%-10s", "Size");
+	for (n = 0; n < DDRC_NUM * 2; n++) {
+		if (!used[n])
+			continue;
+		snprintf(name, sizeof(name), "%s/%s", target_names[n / 2], (n % 2) ? "U" : "C");
+		printf(" %10s", name);
+	}
+	printf("\n");
+
+	for (step = 0, size = LATENCY_MIN_SIZE; step < steps; step++, size *= 2) {
+		if (size >= (1UL << 30))
+			snprintf(name, sizeof(name), "%luGiB", size >> 30);
+		else if (size >= (1UL << 20))
+			snprintf(name, sizeof(name), "%luMiB", size >> 20);
+		else
+			snprintf(name, sizeof(name), "%luKiB", size >> 10);
+		printf("%-10s", name);
+		for (n = 0; n < DDRC_NUM * 2; n++)
+			if (used[n])
+				printf(" %10.2f", results[n][step]);
+		printf("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/* Slab holding as many page aligned blocks as fit, up to count of them */
+static size_t pool_slab_size(size_t block, unsigned int count)
+{
+	size_t per_slab = MEM_POOL_MAX_SLAB / block;
+
+	if (per_slab == 0)
+		return block;
+	if (per_slab > count)
+		per_slab = count;
+	return per_slab * block;
+}
+
+#define MATRIX_TIME	0.5
+
+typedef enum {
+	TRAFFIC_READ,
+	TRAFFIC_WRITE,
+	TRAFFIC_COPY,
+	TRAFFIC_NUM,
+} traffic_op;
+
+static const char *traffic_names[TRAFFIC_NUM] = { "read", "write", "copy" };
+
+/* One point of the traffic generator sweep */
+typedef struct {
+	unsigned int read_pct;		/* Share of bursts that are reads */
+	unsigned long int stride;	/* Distance between bursts of a stream */
+	unsigned long int burst;	/* Bytes accessed back to back */
+	unsigned int streams;		/* Address streams interleaved per worker */
+	int random;			/* Random burst slots instead of sequential */
+} traffic_mix;
+
+typedef struct {
+	pthread_t thread;
+	pthread_barrier_t *barrier;
+	volatile int *stop;
+	traffic_op op;
+	const traffic_mix *mix;		/* Runs the mix instead of op when set */
+	unsigned long int rng;
+	unsigned int acc;		/* Read/write ratio accumulator */
+	mem_pool *src_pool;
+	mem_pool *dst_pool;
+	mem_block *src;
+	mem_block *dst;
+	int ddrc;		/* Controller the job is accounted to */
+	int cpu;
+	unsigned long int bytes;
+	double elapsed;
+} traffic_job;
+
+/* Keeps the compiler from dropping the read loop */
+static volatile unsigned long int traffic_sink;
+
+/* Burst slots of one stream in a buffer of the given size */
+static unsigned long int mix_slots(const traffic_mix *mix, size_t size)
+{
+	size_t region = size / mix->streams;
+
+	if (mix->burst > mix->stride || region < mix->burst)
+		return 0;
+	return (region - mix->burst) / mix->stride + 1;
+}
+
+/*
+ * One pass of a mix over the job buffer, returns the bytes accessed. The
+ * buffer is split into one region per stream and the streams take turns
+ * issuing a burst each, so every worker keeps that many address streams
+ * open. Reads and writes are interleaved by an accumulator that keeps the
+ * ratio exact however short the pass.
+ */
+static unsigned long int mix_pass(traffic_job *job, unsigned long int *sum)
+{
+	const traffic_mix *mix = job->mix;
+	unsigned char *base = (unsigned char *)job->src->virt;
+	size_t region = job->src->size / mix->streams;
+	unsigned long int slots = mix_slots(mix, job->src->size);
+	unsigned long int words = mix->burst / sizeof(unsigned long int);
+	unsigned long int i, w, slot, *p;
+	unsigned int s;
+
+	for (i = 0; i < slots; i++) {
+		for (s = 0; s < mix->streams; s++) {
+			if (mix->random) {
+				job->rng ^= job->rng << 13;
+				job->rng ^= job->rng >> 7;
+				job->rng ^= job->rng << 17;
+				slot = job->rng % slots;
+			} else {
+				slot = i;
+			}
+			p = (unsigned long int *)(base + s * region + slot * mix->stride);
+			job->acc += mix->read_pct;
+			if (job->acc >= 100) {
+				job->acc -= 100;
+				for (w = 0; w < words; w++)
+					*sum += p[w];
+			} else {
+				for (w = 0; w < words; w++)
+					p[w] = i;
+			}
+		}
+	}
+
+	return slots * mix->streams * mix->burst;
+}
+
+static void* traffic_task(void *arg)
+{
+	traffic_job *job = (traffic_job *)arg;
+	unsigned long int *words, sum = 0, i, count;
+	struct timespec start, pass;
+	double maintenance = 0;
+
+	pthread_barrier_wait(job->barrier);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (!*job->stop) {
+		if (job->mix) {
+			job->bytes += mix_pass(job, &sum);
+			//Write back and drop the lines of the pass untimed, so the next one starts cold
+			if (job->src->cached) {
+				clock_gettime(CLOCK_MONOTONIC, &pass);
+				mem_block_flush(job->src_pool, job->src);
+				mem_block_invalidate(job->src_pool, job->src);
+				maintenance += elapsed_since(&pass);
+			}
+			continue;
+		}
+		//Sources are only read, so dropping their lines loses nothing and every pass reads DRAM
+		if (job->op != TRAFFIC_WRITE)
+			mem_block_invalidate(job->src_pool, job->src);
+		switch (job->op) {
+		case TRAFFIC_READ:
+			words = (unsigned long int *)job->src->virt;
+			count = (job->src->size / sizeof(*words)) & ~3UL;
+			for (i = 0; i < count; i += 4)
+				sum += words[i] ^ words[i + 1] ^ words[i + 2] ^ words[i + 3];
+			job->bytes += job->src->size;
+			break;
+		case TRAFFIC_WRITE:
+			memset(job->dst->virt, (int)job->bytes, job->dst->size);
+			mem_block_flush(job->dst_pool, job->dst);
+			job->bytes += job->dst->size;
+			break;
+		default:
+			memcpy(job->dst->virt, job->src->virt, job->dst->size);
+			mem_block_flush(job->dst_pool, job->dst);
+			job->bytes += job->dst->size;
+			break;
 		}
 	}
-	simaai_memory_unmap(task->buffer);
-	exit(EXIT_SUCCESS);
+	job->elapsed = elapsed_since(&start) - maintenance;
+	traffic_sink = sum;
 
 	return NULL;
 }
 
+/* Start all jobs together, let them run for duration seconds, then stop them */
+static int run_traffic(traffic_job *jobs, int count, double duration)
+{
+	pthread_barrier_t barrier;
+	volatile int stop = 0;
+	struct timespec delay;
+	pthread_attr_t attr;
+	cpu_set_t cpuset;
+	int i, started, res = 0;
+
+	pthread_barrier_init(&barrier, NULL, count + 1);
+	for (started = 0; started < count; started++) {
+		jobs[started].barrier = &barrier;
+		jobs[started].stop = &stop;
+		jobs[started].bytes = 0;
+		jobs[started].elapsed = 0;
+		pthread_attr_init(&attr);
+		if (jobs[started].cpu >= 0) {
+			CPU_ZERO(&cpuset);
+			CPU_SET(jobs[started].cpu, &cpuset);
+			pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+		}
+		res = pthread_create(&jobs[started].thread, &attr, &traffic_task, &jobs[started]);
+		pthread_attr_destroy(&attr);
+		if (res != 0) {
+			fprintf(stderr, "ERROR: Failed to start traffic on CPU %d\n", jobs[started].cpu);
+			break;
+		}
+	}
+
+	if (started < count) {
+		//Release the started jobs through a barrier sized for all of them
+		stop = 1;
+		for (i = started; i < count; i++)
+			pthread_barrier_wait(&barrier);
+	} else {
+		pthread_barrier_wait(&barrier);
+		delay.tv_sec = (time_t)duration;
+		delay.tv_nsec = (long)((duration - delay.tv_sec) * 1e9);
+		nanosleep(&delay, NULL);
+		stop = 1;
+	}
+
+	for (i = 0; i < started; i++)
+		pthread_join(jobs[i].thread, NULL);
+	pthread_barrier_destroy(&barrier);
+
+	return started < count ? -1 : 0;
+}
+
+/* GB/s of the jobs accounted to one controller */
+static double traffic_bandwidth(const traffic_job *jobs, int count, int ddrc)
+{
+	double bandwidth = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		if (jobs[i].ddrc == ddrc && jobs[i].elapsed > 0)
+			bandwidth += jobs[i].bytes / (jobs[i].elapsed * 1024 * 1024 * 1024);
+
+	return bandwidth;
+}
+
+typedef struct {
+	args *args;
+	mem_pool pools[DDRC_NUM];
+	mem_block *blocks[DDRC_NUM];	/* per_worker blocks per worker */
+	int ready[DDRC_NUM];
+	unsigned int per_worker;
+	int ctrls[DDRC_NUM];
+	int nctrl;
+	traffic_job *jobs;
+	int cpus[MAX_CPUS];
+	int ncpus;
+	double duration;
+} matrix;
+
+/*
+ * Pool and per_worker blocks of args->size for every worker of every
+ * selected controller, filled and written back so the first pass does not
+ * pay for the page faults.
+ */
+static int matrix_setup(matrix *m, args *args, int flags, unsigned int per_worker)
+{
+	unsigned int k, count = per_worker * args->threads;
+	size_t block;
+	int i;
+
+	memset(m, 0, sizeof(*m));
+	m->args = args;
+	m->per_worker = per_worker;
+	m->ncpus = allowed_cpus(m->cpus);
+	m->duration = args->sleep_time ? args->sleep_time : MATRIX_TIME;
+
+	for (i = 0; i < DDRC_NUM; i++)
+		if ((args->ddrc_mask >> i) & 1)
+			m->ctrls[m->nctrl++] = i;
+	if (m->nctrl == 0 || args->threads == 0) {
+		fprintf(stderr, "Invalid DDRC mask or worker count\n");
+		return -1;
+	}
+
+	m->jobs = (traffic_job *)calloc(DDRC_NUM * args->threads, sizeof(*m->jobs));
+	if (!m->jobs) {
+		fprintf(stderr, "Not enough memory for allocating jobs\n");
+		return -1;
+	}
+
+	block = (args->size + PAGE_ALIGN - 1) & ~(PAGE_ALIGN - 1);
+	for (i = 0; i < m->nctrl; i++) {
+		int c = m->ctrls[i];
+
+		m->blocks[c] = (mem_block *)calloc(count, sizeof(mem_block));
+		if (!m->blocks[c] || mem_pool_init(&m->pools[c], target_names[c], targets[c],
+				flags, pool_slab_size(block, count), block * count) != 0)
+			return -1;
+		m->ready[c] = 1;
+		for (k = 0; k < count; k++) {
+			if (mem_pool_alloc(&m->pools[c], args->size, PAGE_ALIGN, &m->blocks[c][k]) != 0)
+				return -1;
+			memset(m->blocks[c][k].virt, 0x5a, args->size);
+			mem_block_flush(&m->pools[c], &m->blocks[c][k]);
+		}
+	}
+
+	return 0;
+}
+
+static void matrix_release(matrix *m)
+{
+	unsigned int k;
+	int i;
+
+	for (i = 0; i < m->nctrl; i++) {
+		int c = m->ctrls[i];
+
+		if (m->ready[c]) {
+			for (k = 0; k < m->per_worker * m->args->threads; k++)
+				mem_pool_free(&m->pools[c], &m->blocks[c][k]);
+			mem_pool_destroy(&m->pools[c]);
+		}
+		free(m->blocks[c]);
+	}
+	free(m->jobs);
+}
+
+/*
+ * Queue args->threads jobs of one kind per controller. src and dst hold
+ * the source and destination controller of each entry, -1 if unused.
+ */
+static int matrix_jobs(matrix *m, traffic_op op, const int *src, const int *dst, int entries)
+{
+	int e, k, n = 0, ddrc;
+
+	for (e = 0; e < entries; e++) {
+		ddrc = (op == TRAFFIC_READ) ? src[e] : dst[e];
+		for (k = 0; k < (int)m->args->threads; k++, n++) {
+			traffic_job *job = &m->jobs[n];
+
+			memset(job, 0, sizeof(*job));
+			job->op = op;
+			job->ddrc = ddrc;
+			job->cpu = worker_cpu(m->args, ddrc, e, entries, k, m->cpus, m->ncpus);
+			if (src[e] >= 0) {
+				job->src_pool = &m->pools[src[e]];
+				job->src = &m->blocks[src[e]][2 * k];
+			}
+			if (dst[e] >= 0) {
+				job->dst_pool = &m->pools[dst[e]];
+				job->dst = &m->blocks[dst[e]][2 * k + 1];
+			}
+		}
+	}
+
+	return run_traffic(m->jobs, n, m->duration);
+}
+
+/* GiB/s as reported in the tables to GB/s of the JSON records */
+#define GIB_TO_GB	(1073741824.0 / 1e9)
+
+/*
+ * One record for the jobs of the last matrix_jobs() call, with the
+ * bandwidth of every controller they are accounted to. Copies between two
+ * controllers name both, efficiency is left out when negative.
+ */
+static void json_matrix(const matrix *m, const char *mode, traffic_op op, const int *src,
+			const int *dst, int entries, double efficiency)
+{
+	int e, i, ddrc, count = entries * m->args->threads;
+	unsigned long int bytes = 0;
+	double bandwidth, total = 0;
+	json_record r;
+	char mask[8];
+
+	json_begin(&r, stdout, "ddr_test", "matrix");
+	json_object_begin(&r, "params");
+	snprintf(mask, sizeof(mask), "0x%x", m->args->ddrc_mask);
+	json_string(&r, "ddrc_mask", mask);
+	json_uint(&r, "size", m->args->size);
+	json_uint(&r, "workers", m->args->threads);
+	json_bool(&r, "cached", 1);
+	json_string(&r, "mode", mode);
+	json_string(&r, "op", traffic_names[op]);
+	if (op == TRAFFIC_COPY && entries == 1) {
+		json_string(&r, "source", target_names[src[0]]);
+		json_string(&r, "destination", target_names[dst[0]]);
+	}
+	json_object_end(&r);
+	json_double(&r, "duration_s", m->duration);
+	for (i = 0; i < count; i++)
+		bytes += m->jobs[i].bytes;
+	json_uint(&r, "bytes", bytes);
+	json_object_begin(&r, "controllers");
+	for (e = 0; e < entries; e++) {
+		ddrc = (op == TRAFFIC_READ) ? src[e] : dst[e];
+		bandwidth = traffic_bandwidth(m->jobs, count, ddrc) * GIB_TO_GB;
+		total += bandwidth;
+		json_double(&r, target_names[ddrc], bandwidth);
+	}
+	json_object_end(&r);
+	json_double(&r, "bandwidth_gbps", total);
+	if (efficiency >= 0)
+		json_double(&r, "efficiency", efficiency);
+	json_string(&r, "status", "pass");
+	json_end(&r);
+}
+
+static void matrix_header(const char *title, const int *ctrls, int nctrl)
+{
+	int i;
+
+	printf("%-10s", title);
+	for (i = 0; i < nctrl; i++)
+		printf(" %8s", target_names[ctrls[i]]);
+}
+
+/*
+ * Bandwidth of read, write and copy traffic on every selected controller
+ * alone, of copies between every pair of them, of all of them at once and
+ * of every pair of them at once. Efficiency is the concurrent bandwidth
+ * over the sum of the solo bandwidths of the same controllers. Buffers are
+ * cached, so every pass invalidates its source and flushes its destination
+ * and each one goes to the controllers rather than the CPU caches.
+ */
+static int matrix_test(args *args)
+{
+	static double solo[TRAFFIC_NUM][DDRC_NUM], copy[DDRC_NUM][DDRC_NUM];
+	static double pairs[DDRC_NUM][DDRC_NUM];
+	int src[DDRC_NUM], dst[DDRC_NUM], *ctrls, nctrl;
+	double bandwidth, aggregate, expected;
+	unsigned int workers = args->threads;
+	int i, j, op, res = EXIT_FAILURE;
+	matrix m;
+
+	//Source and destination buffer per worker on every controller
+	if (matrix_setup(&m, args, SIMAAI_MEM_FLAG_CACHED, 2) != 0)
+		goto free;
+	ctrls = m.ctrls;
+	nctrl = m.nctrl;
+
+	if (!args->json)
+		printf("Matrix: 0x%lx bytes per buffer, %u workers per controller, %.2fs per point\n",
+		       args->size, workers, m.duration);
+
+	//Every controller on its own
+	for (i = 0; i < nctrl; i++) {
+		src[0] = dst[0] = ctrls[i];
+		for (op = TRAFFIC_READ; op <= TRAFFIC_WRITE; op++) {
+			if (matrix_jobs(&m, op, src, dst, 1) != 0)
+				goto free;
+			solo[op][ctrls[i]] = traffic_bandwidth(m.jobs, workers, ctrls[i]);
+			if (args->json)
+				json_matrix(&m, "solo", op, src, dst, 1, -1);
+		}
+		for (j = 0; j < nctrl; j++) {
+			dst[0] = ctrls[j];
+			if (matrix_jobs(&m, TRAFFIC_COPY, src, dst, 1) != 0)
+				goto free;
+			copy[ctrls[i]][ctrls[j]] = traffic_bandwidth(m.jobs, workers, ctrls[j]);
+			if (args->json)
+				json_matrix(&m, i == j ? "solo" : "copy", TRAFFIC_COPY, src, dst, 1, -1);
+		}
+		solo[TRAFFIC_COPY][ctrls[i]] = copy[ctrls[i]][ctrls[i]];
+	}
+
+	if (!args->json) {
+		printf("\nSolo GB/s\n");
+		matrix_header("Traffic", ctrls, nctrl);
+		printf("\n");
+		for (op = TRAFFIC_READ; op < TRAFFIC_NUM; op++) {
+			printf("%-10s", traffic_names[op]);
+			for (i = 0; i < nctrl; i++)
+				printf(" %8.2f", solo[op][ctrls[i]]);
+			printf("\n");
+		}
+
+		printf("\nCopy GB/s, rows are sources, columns destinations\n");
+		matrix_header("Source", ctrls, nctrl);
+		printf("\n");
+		for (i = 0; i < nctrl; i++) {
+			printf("%-10s", target_names[ctrls[i]]);
+			for (j = 0; j < nctrl; j++)
+				printf(" %8.2f", copy[ctrls[i]][ctrls[j]]);
+			printf("\n");
+		}
+
+		printf("\nConcurrent GB/s, all controllers at once\n");
+		matrix_header("Traffic", ctrls, nctrl);
+		printf(" %9s %9s %10s\n", "Aggregate", "Solo sum", "Efficiency");
+	}
+
+	//All selected controllers at once, copies stay within a controller
+	for (op = TRAFFIC_READ; op < TRAFFIC_NUM; op++) {
+		for (i = 0; i < nctrl; i++)
+			src[i] = dst[i] = ctrls[i];
+		if (matrix_jobs(&m, op, src, dst, nctrl) != 0)
+			goto free;
+		aggregate = expected = 0;
+		if (!args->json)
+			printf("%-10s", traffic_names[op]);
+		for (i = 0; i < nctrl; i++) {
+			bandwidth = traffic_bandwidth(m.jobs, nctrl * workers, ctrls[i]);
+			aggregate += bandwidth;
+			expected += solo[op][ctrls[i]];
+			if (!args->json)
+				printf(" %8.2f", bandwidth);
+		}
+		if (args->json)
+			json_matrix(&m, "concurrent", op, src, dst, nctrl,
+				    expected > 0 ? aggregate / expected : 0);
+		else
+			printf(" %9.2f %9.2f %9.1f%%\n", aggregate, expected,
+			       expected > 0 ? 100 * aggregate / expected : 0);
+	}
+
+	//Pairs of controllers at once, share of the solo bandwidth they keep
+	for (op = TRAFFIC_READ; op <= TRAFFIC_WRITE && nctrl > 1; op++) {
+		for (i = 0; i < nctrl; i++) {
+			for (j = i + 1; j < nctrl; j++) {
+				src[0] = dst[0] = ctrls[i];
+				src[1] = dst[1] = ctrls[j];
+				if (matrix_jobs(&m, op, src, dst, 2) != 0)
+					goto free;
+				aggregate = traffic_bandwidth(m.jobs, 2 * workers, ctrls[i]) +
+					    traffic_bandwidth(m.jobs, 2 * workers, ctrls[j]);
+				expected = solo[op][ctrls[i]] + solo[op][ctrls[j]];
+				pairs[i][j] = pairs[j][i] = expected > 0 ? 100 * aggregate / expected : 0;
+				if (args->json)
+					json_matrix(&m, "pairwise", op, src, dst, 2, pairs[i][j] / 100);
+			}
+		}
+		if (args->json)
+			continue;
+
+		printf("\nPairwise %s efficiency, %% of solo bandwidth kept\n", traffic_names[op]);
+		matrix_header("", ctrls, nctrl);
+		printf("\n");
+		for (i = 0; i < nctrl; i++) {
+			printf("%-10s", target_names[ctrls[i]]);
+			for (j = 0; j < nctrl; j++) {
+				if (i == j)
+					printf(" %8s", "-");
+				else
+					printf(" %7.1f%%", pairs[i][j]);
+			}
+			printf("\n");
+		}
+	}
+	res = EXIT_SUCCESS;
+
+free:
+	matrix_release(&m);
+
+	return res;
+}
+
+#define TRAFFIC_MAX_STREAMS	64
+/* Cached buffers are at least this many times the last level cache */
+#define TRAFFIC_LLC_FACTOR	4
+
+typedef struct {
+	traffic_mix mix;
+	double bandwidth[DDRC_NUM];
+	double total;
+	unsigned long int bytes;
+	int skipped;		/* Burst longer than the stride or the stream region */
+} traffic_point;
+
+static void traffic_defaults(args *args)
+{
+	static const unsigned long int reads[] = { 100, 50, 0 };
+	static const unsigned long int strides[] = { 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+	static const unsigned long int streams[] = { 1, 4 };
+
+	if (args->nreads == 0) {
+		memcpy(args->reads, reads, sizeof(reads));
+		args->nreads = sizeof(reads) / sizeof(reads[0]);
+	}
+	if (args->nstrides == 0) {
+		memcpy(args->strides, strides, sizeof(strides));
+		args->nstrides = sizeof(strides) / sizeof(strides[0]);
+	}
+	if (args->nbursts == 0) {
+		args->bursts[0] = 64;
+		args->nbursts = 1;
+	}
+	if (args->nstreams == 0) {
+		memcpy(args->streams, streams, sizeof(streams));
+		args->nstreams = sizeof(streams) / sizeof(streams[0]);
+	}
+	if (args->orders == 0)
+		args->orders = 1;
+}
+
+static int traffic_valid(const args *args)
+{
+	int i;
+
+	for (i = 0; i < args->nreads; i++)
+		if (args->reads[i] > 100)
+			return -1;
+	for (i = 0; i < args->nstrides; i++)
+		if (args->strides[i] == 0 || args->strides[i] % sizeof(unsigned long int))
+			return -1;
+	for (i = 0; i < args->nbursts; i++)
+		if (args->bursts[i] == 0 || args->bursts[i] % sizeof(unsigned long int))
+			return -1;
+	for (i = 0; i < args->nstreams; i++)
+		if (args->streams[i] == 0 || args->streams[i] > TRAFFIC_MAX_STREAMS)
+			return -1;
+
+	return 0;
+}
+
+static void json_traffic(const args *args, const matrix *m, const traffic_point *point, double best)
+{
+	json_record r;
+	char mask[8];
+	int i;
+
+	json_begin(&r, stdout, "ddr_test", "traffic");
+	json_object_begin(&r, "params");
+	snprintf(mask, sizeof(mask), "0x%x", args->ddrc_mask);
+	json_string(&r, "ddrc_mask", mask);
+	json_uint(&r, "size", args->size);
+	json_uint(&r, "workers", args->threads);
+	json_bool(&r, "cached", !args->uncached);
+	json_uint(&r, "reads", point->mix.read_pct);
+	json_uint(&r, "stride", point->mix.stride);
+	json_uint(&r, "burst", point->mix.burst);
+	json_uint(&r, "streams", point->mix.streams);
+	json_string(&r, "order", point->mix.random ? "rand" : "seq");
+	json_object_end(&r);
+	if (point->skipped) {
+		json_string(&r, "status", "skipped");
+		json_end(&r);
+		return;
+	}
+	json_double(&r, "duration_s", m->duration);
+	json_uint(&r, "bytes", point->bytes);
+	json_double(&r, "bandwidth_gbps", point->total * GIB_TO_GB);
+	json_object_begin(&r, "controllers");
+	for (i = 0; i < m->nctrl; i++)
+		json_double(&r, target_names[m->ctrls[i]], point->bandwidth[m->ctrls[i]] * GIB_TO_GB);
+	json_object_end(&r);
+	json_double(&r, "efficiency", best > 0 ? point->total / best : 0);
+	json_string(&r, "status", "pass");
+	json_end(&r);
+}
+
+/*
+ * Sweep every combination of read share, stream count, burst length, order
+ * and stride, with args->threads workers on each selected controller, each
+ * on its own buffer. Efficiency is the total bandwidth of a point over the
+ * best total of all points with the same read share, so strides where DRAM
+ * page hits turn into misses show up as a drop in that column. Cached
+ * buffers are written back and invalidated between passes, outside the
+ * timed part, and must be far larger than the last level cache so the
+ * accesses within a pass reach DRAM as well.
+ */
+static int traffic_test(args *args)
+{
+	unsigned long int llc = llc_size();
+	unsigned int k, workers = args->threads;
+	int r, n, b, o, t, i, count, points = 0;
+	int res = EXIT_FAILURE;
+	traffic_point *point, *all = NULL;
+	double best;
+	matrix m;
+
+	traffic_defaults(args);
+	if (traffic_valid(args) != 0) {
+		fprintf(stderr, "Invalid traffic lists, reads are 0..100, strides and bursts multiples "
+				"of 8, streams 1..%d\n", TRAFFIC_MAX_STREAMS);
+		return EXIT_FAILURE;
+	}
+	//Within a pass, lines are only evicted to DRAM when the buffer is far larger than the cache
+	if (!args->uncached && args->size < TRAFFIC_LLC_FACTOR * llc) {
+		fprintf(stderr, "ERROR: Cached buffers must be at least %d times the 0x%lx byte last level "
+				"cache, use -s 0x%lx or more, or -u\n", TRAFFIC_LLC_FACTOR, llc,
+				TRAFFIC_LLC_FACTOR * llc);
+		return EXIT_FAILURE;
+	}
+	if (matrix_setup(&m, args, args->uncached ? SIMAAI_MEM_FLAG_DEFAULT : SIMAAI_MEM_FLAG_CACHED, 1) != 0)
+		goto free;
+
+	all = (traffic_point *)calloc(args->nreads * args->nstreams * args->nbursts * 2 * args->nstrides,
+				      sizeof(*all));
+	if (!all) {
+		fprintf(stderr, "Not enough memory for traffic points\n");
+		goto free;
+	}
+
+	if (!args->json)
+		printf("Traffic: 0x%lx bytes per worker, %u workers per controller, %s, %.2fs per point\n",
+		       args->size, workers, args->uncached ? "uncached" : "cached", m.duration);
+
+	//Strides innermost, so every block of rows is a stride sweep
+	for (r = 0; r < args->nreads; r++) {
+		for (n = 0; n < args->nstreams; n++) {
+			for (b = 0; b < args->nbursts; b++) {
+				for (o = 0; o < 2; o++) {
+					for (t = 0; t < args->nstrides && ((args->orders >> o) & 1); t++) {
+						point = &all[points++];
+						point->mix.read_pct = args->reads[r];
+						point->mix.streams = args->streams[n];
+						point->mix.burst = args->bursts[b];
+						point->mix.random = o;
+						point->mix.stride = args->strides[t];
+						point->skipped = mix_slots(&point->mix, args->size) == 0;
+					}
+				}
+			}
+		}
+	}
+
+	for (point = all; point < all + points; point++) {
+		if (point->skipped)
+			continue;
+		count = 0;
+		for (i = 0; i < m.nctrl; i++) {
+			for (k = 0; k < workers; k++, count++) {
+				traffic_job *job = &m.jobs[count];
+
+				memset(job, 0, sizeof(*job));
+				job->mix = &point->mix;
+				job->rng = (args->seed + count) * 0x9e3779b97f4a7c15UL | 1;
+				job->ddrc = m.ctrls[i];
+				job->cpu = worker_cpu(args, m.ctrls[i], i, m.nctrl, k, m.cpus, m.ncpus);
+				job->src_pool = &m.pools[m.ctrls[i]];
+				job->src = &m.blocks[m.ctrls[i]][k];
+			}
+		}
+		if (run_traffic(m.jobs, count, m.duration) != 0)
+			goto free;
+		for (i = 0; i < m.nctrl; i++) {
+			point->bandwidth[m.ctrls[i]] = traffic_bandwidth(m.jobs, count, m.ctrls[i]);
+			point->total += point->bandwidth[m.ctrls[i]];
+		}
+		for (i = 0; i < count; i++)
+			point->bytes += m.jobs[i].bytes;
+	}
+
+	if (!args->json) {
+		printf("\n%5s %7s %6s %7s %-5s", "Read%", "Stride", "Burst", "Streams", "Order");
+		for (i = 0; i < m.nctrl; i++)
+			printf(" %8s", target_names[m.ctrls[i]]);
+		printf(" %8s %10s\n", "Total", "Efficiency");
+	}
+	for (point = all; point < all + points; point++) {
+		best = 0;
+		for (i = 0; i < points; i++)
+			if (all[i].mix.read_pct == point->mix.read_pct && all[i].total > best)
+				best = all[i].total;
+		if (args->json) {
+			json_traffic(args, &m, point, best);
+			continue;
+		}
+		printf("%5u %7lu %6lu %7u %-5s", point->mix.read_pct, point->mix.stride,
+		       point->mix.burst, point->mix.streams, point->mix.random ? "rand" : "seq");
+		for (i = 0; i < m.nctrl; i++) {
+			if (point->skipped)
+				printf(" %8s", "-");
+			else
+				printf(" %8.2f", point->bandwidth[m.ctrls[i]]);
+		}
+		if (point->skipped)
+			printf(" %8s %10s\n", "-", "-");
+		else
+			printf(" %8.2f %9.1f%%\n", point->total, best > 0 ? 100 * point->total / best : 0);
+	}
+	res = EXIT_SUCCESS;
+
+free:
+	free(all);
+	matrix_release(&m);
+
+	return res;
+}
+
+static const char *pattern_names[PATTERN_NUM] = {
+		"0x55", "0xAA", "0x5A", "0xA5", "0x55AA", "0xAA55", "random", "address",
+		"user", "walking1", "walking0", "adjacent", "rowhammer",
+};
+
+/* One record for a pattern or performance run, with an entry per worker */
+static void json_run(const args *args, load_task *tasks, int count, double duration,
+		     unsigned long int errors, int res)
+{
+	unsigned long int bytes, total = 0;
+	double bandwidth, aggregate = 0;
+	histogram merged;
+	json_record r;
+	char mask[8];
+	int i;
+
+	hist_init(&merged);
+	json_begin(&r, stdout, "ddr_test", args->performance ? "performance" :
+		   args->type == PATTERN_ROWHAMMER ? "rowhammer" : "pattern");
+	json_object_begin(&r, "params");
+	snprintf(mask, sizeof(mask), "0x%x", args->ddrc_mask);
+	json_string(&r, "ddrc_mask", mask);
+	if (!args->performance)
+		json_string(&r, "pattern", pattern_names[args->type]);
+	json_uint(&r, "size", args->size);
+	json_uint(&r, "workers", args->threads);
+	json_uint(&r, "time", args->sleep_time);
+	if (!args->performance) {
+		json_uint(&r, "seed", args->seed);
+		json_bool(&r, "random", args->random);
+		json_bool(&r, "readback", args->readback);
+	}
+	if (!args->performance && args->type == PATTERN_ROWHAMMER) {
+		json_uint(&r, "hammer", args->hammer.count);
+		json_uint(&r, "row_size", args->hammer.row_size);
+		json_uint(&r, "banks", args->hammer.banks);
+		json_bool(&r, "flush", args->hammer.flush);
+	}
+	json_object_end(&r);
+	json_double(&r, "duration_s", duration);
+
+	json_array_begin(&r, "workers");
+	for (i = 0; i < count; i++) {
+		json_object_begin(&r, NULL);
+		json_int(&r, "ddrc", tasks[i].ddrc);
+		json_int(&r, "cpu", tasks[i].cpu);
+		if (args->performance) {
+			bytes = tasks[i].iterations * tasks[i].size;
+			bandwidth = tasks[i].elapsed > 0 ? bytes / tasks[i].elapsed / 1e9 : 0;
+			total += bytes;
+			aggregate += bandwidth;
+			hist_merge(&merged, &tasks[i].stats.latency);
+			json_uint(&r, "bytes", bytes);
+			json_double(&r, "duration_s", tasks[i].elapsed);
+			json_double(&r, "bandwidth_gbps", bandwidth);
+		} else if (args->type == PATTERN_ROWHAMMER) {
+			json_uint(&r, "activations", tasks[i].hammer_stats.activations);
+			json_double(&r, "activation_rate", tasks[i].hammer_stats.seconds > 0 ?
+				    tasks[i].hammer_stats.activations / tasks[i].hammer_stats.seconds : 0);
+			json_uint(&r, "flips", tasks[i].hammer_stats.flips);
+		}
+		json_uint(&r, "errors", tasks[i].log.errors);
+		json_bool(&r, "failed", tasks[i].failed);
+		json_object_end(&r);
+	}
+	json_array_end(&r);
+
+	if (args->performance) {
+		json_uint(&r, "bytes", total);
+		json_double(&r, "bandwidth_gbps", aggregate);
+		json_latency(&r, "latency_ns", &merged);
+	}
+	json_uint(&r, "errors", errors);
+	json_string(&r, "status", res == 0 ? "pass" : "fail");
+	json_end(&r);
+}
+
 int main(int argc, char *argv[])
 {
 	args args = {
@@ -356,14 +1874,50 @@ int main(int argc, char *argv[])
 			.value = 0xA55AAA555AA555AA,
 			.readback = 0,
 			.performance  = 0,
+			.placement = PLACEMENT_ROUND_ROBIN,
+			.interval = 1000,
+			.seed = (unsigned long int)time(NULL),
+			.max_errors = 16,
+			.hammer = {
+				.row_size = 0x2000,
+				.banks = 8,
+				.count = 500000,
+			},
 	};
-	int i, j, k = 0, res, threads = 0;
+	int i, j, n, k = 0, res = 0, threads = 0;
+	int cpus[MAX_CPUS], ncpus, nctrl = 0, ctrl = 0;
+	unsigned long int errors = 0;
+	double bandwidth, aggregate = 0;
+	pthread_attr_t attr;
+	cpu_set_t cpuset;
 	load_task *tasks;
+	reporter rep = { 0 };
+	mem_pool pools[DDRC_NUM], input_pool;
+	int pool_ready[DDRC_NUM] = { 0 }, input_ready = 0;
+	size_t block;
+	unsigned int per_slab;
+	struct timespec start;
 
 	if (parse_args(argc, argv, &args) != 0){
 		return EXIT_FAILURE;
 	}
 
+	if (args.microbench)
+		return microbench(&args);
+
+	if (args.latency)
+		return latency_sweep(&args);
+
+	if (args.matrix)
+		return matrix_test(&args);
+
+	if (args.traffic)
+		return traffic_test(&args);
+
+	if (args.type == PATTERN_RANDOM)
+		fprintf(stderr, "Seed: 0x%lx\n", args.seed);
+	args.hammer.value = args.value;
+
 	//Calculate amount of thread
 	for(i = 0; i < 5; i++)
 		if((args.ddrc_mask >> i) & 1)
@@ -376,61 +1930,179 @@ int main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
-	for(i = 0; i < 5; i++) {
+	ncpus = allowed_cpus(cpus);
+	for(i = 0; i < 5; i++)
 		if((args.ddrc_mask >> i) & 1)
+			nctrl++;
+
+	//Reserve every worker buffer up front, one pool per controller
+	block = (args.size + PAGE_ALIGN - 1) & ~(PAGE_ALIGN - 1);
+	//Timed flushes go through libsimaaimem only when every buffer is a whole slab
+	per_slab = args.performance ? 1 : args.threads;
+	for(i = 0; i < DDRC_NUM; i++) {
+		if(!((args.ddrc_mask >> i) & 1))
+			continue;
+		//Readback invalidates before verifying, only passes checked inline need uncached
+		if(mem_pool_init(&pools[i], target_names[i], targets[i],
+				 args.type > 8 && !(args.type == PATTERN_ROWHAMMER && args.hammer.flush) ?
+				 SIMAAI_MEM_FLAG_DEFAULT : SIMAAI_MEM_FLAG_CACHED,
+				 pool_slab_size(block, per_slab), block * args.threads) != 0) {
+			res = -1;
+			goto free_pools;
+		}
+		pool_ready[i] = 1;
+	}
+	if(args.performance) {
+		if(mem_pool_init(&input_pool, "input", SIMAAI_MEM_TARGET_DMS0, SIMAAI_MEM_FLAG_CACHED,
+				 pool_slab_size(block, threads), block * threads) != 0) {
+			res = -1;
+			goto free_pools;
+		}
+		input_ready = 1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(i = 0; i < 5; i++) {
+		if((args.ddrc_mask >> i) & 1) {
 			for(j = 0; j < args.threads; j++) {
-				//Allocate CMA buffer size per worker
-				if(args.type > 8 || args.readback){
-					tasks[k].buffer = simaai_memory_alloc_flags(args.size, targets[i],SIMAAI_MEM_FLAG_DEFAULT);
-				}
-				else
-					tasks[k].buffer = simaai_memory_alloc_flags(args.size, targets[i], SIMAAI_MEM_FLAG_CACHED);
-				
-				if(tasks[k].buffer == NULL){
-					fprintf(stderr, "ERROR: Buffer is NULL\n");
-					goto error;
-				}
+				//Buffer per worker, taken from the controller pool by the worker itself
+				tasks[k].pool = &pools[i];
+				tasks[k].input_pool = &input_pool;
+				tasks[k].hammer = &args.hammer;
+				tasks[k].ddrc = i;
+				tasks[k].cpu = worker_cpu(&args, i, ctrl, nctrl, j, cpus, ncpus);
 				//Fill task structure
 				tasks[k].active = 1;
+				hist_init(&tasks[k].stats.latency);
 				tasks[k].type = args.type;
 				tasks[k].value = args.value;
+				tasks[k].seed = args.seed + k;
+				tasks[k].log.max_print = args.max_errors;
 				tasks[k].size = args.size;
 				tasks[k].random = args.random;
 				tasks[k].readback = args.readback;
 				tasks[k].performance = args.performance;
 				tasks[k].sleep_time = args.sleep_time;
-				//start thread
-				res = pthread_create(&(tasks[k].thread), NULL, &loader_task, &(tasks[k]));
-				if(res != 0)
+				//Pin and start thread
+				pthread_attr_init(&attr);
+				if (tasks[k].cpu >= 0) {
+					CPU_ZERO(&cpuset);
+					CPU_SET(tasks[k].cpu, &cpuset);
+					pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+				}
+				res = pthread_create(&(tasks[k].thread), &attr, &loader_task, &(tasks[k]));
+				pthread_attr_destroy(&attr);
+				if(res != 0) {
+					fprintf(stderr, "ERROR: Failed to start worker on CPU %d\n", tasks[k].cpu);
 					goto error;
+				}
 				k++;
 			}
+			ctrl++;
+		}
+	}
+
+	if (args.performance && args.interval) {
+		rep.active = 1;
+		rep.tasks = tasks;
+		rep.count = k;
+		rep.interval = args.interval;
+		if (pthread_create(&rep.thread, NULL, &reporter_task, &rep) != 0) {
+			fprintf(stderr, "ERROR: Failed to start reporter\n");
+			rep.active = 0;
+		}
 	}
 
-	//Sleep for n seconds or forever
+	//Run for n seconds, or until the workers are done
 	if(args.sleep_time == 0)
-		while(1);
-	else
-		sleep(args.sleep_time);
+		goto join;
+	sleep(args.sleep_time);
 
 error:
 	//Set active to 0
 	for(i = 0; i < threads; i++)
 		tasks[i].active = 0;
 
+join:
 	//Join all threads
 	for(i = 0; i < threads; i++) {
 		if(tasks[i].thread != 0) {
-			res = pthread_join(tasks[i].thread, NULL);
-			if (res != 0)
+			if (pthread_join(tasks[i].thread, NULL) != 0) {
 				fprintf(stderr, "Error joining the thread\n");
+				res = -1;
+			}
+			if (tasks[i].failed)
+				res = -1;
 		}
 	}
 
-	//Free CMA buffers
-	for(i = 0; i < threads; i++) {
-		if(tasks[i].buffer != NULL)
-			simaai_memory_free(tasks[i].buffer);
+	if (rep.active) {
+		rep.active = 0;
+		pthread_join(rep.thread, NULL);
+	}
+
+	//Report per worker and aggregate throughput
+	if (args.performance) {
+		for(i = 0; i < k; i++) {
+			if (tasks[i].failed || tasks[i].elapsed <= 0)
+				continue;
+			bandwidth = (double)tasks[i].iterations * tasks[i].size /
+				(tasks[i].elapsed * 1024 * 1024 * 1024);
+			aggregate += bandwidth;
+			fprintf(stderr, "Worker %d (DDRC%d, CPU %d): %.2fGB/s, iteration p50 %.3fms p99 %.3fms p99.9 %.3fms\n",
+					i, tasks[i].ddrc, tasks[i].cpu, bandwidth,
+					hist_percentile(&tasks[i].stats.latency, 0.50) / 1e6,
+					hist_percentile(&tasks[i].stats.latency, 0.99) / 1e6,
+					hist_percentile(&tasks[i].stats.latency, 0.999) / 1e6);
+		}
+		fprintf(stderr, "Aggregate Throughput: %.2fGB/s\n", aggregate);
+	}
+
+	//Summarize failures per controller, byte lane and data bit
+	for(i = 0; i < DDRC_NUM; i++) {
+		error_log sum = { 0 };
+
+		for(j = 0; j < k; j++) {
+			if (tasks[j].ddrc != i)
+				continue;
+			sum.errors += tasks[j].log.errors;
+			for (n = 0; n < 8; n++)
+				sum.lanes[n] += tasks[j].log.lanes[n];
+			for (n = 0; n < 64; n++)
+				sum.bits[n] += tasks[j].log.bits[n];
+		}
+		if (sum.errors == 0)
+			continue;
+
+		errors += sum.errors;
+		fprintf(stderr, "DDRC%d: %lu failing words\n", i, sum.errors);
+		fprintf(stderr, "  byte lanes:");
+		for (n = 0; n < 8; n++)
+			fprintf(stderr, " %d:%lu", n, sum.lanes[n]);
+		fprintf(stderr, "\n  bits:");
+		for (n = 0; n < 64; n++)
+			if (sum.bits[n])
+				fprintf(stderr, " %d:%lu", n, sum.bits[n]);
+		fprintf(stderr, "\n");
+	}
+	if (errors > 0)
+		res = -1;
+
+	if (args.json)
+		json_run(&args, tasks, k, elapsed_since(&start), errors, res);
+
+free_pools:
+	//Workers returned their buffers, release the slabs
+	for(i = 0; i < DDRC_NUM; i++) {
+		if(!pool_ready[i])
+			continue;
+		if(args.performance)
+			mem_pool_report(&pools[i], stderr);
+		mem_pool_destroy(&pools[i]);
+	}
+	if(input_ready) {
+		mem_pool_report(&input_pool, stderr);
+		mem_pool_destroy(&input_pool);
 	}
 
 	//Free tasks memory
@@ -0,0 +1,253 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "cache_ops.h"
+#include "hammer.h"
+
+/* State of one hammer_run() call */
+typedef struct {
+	unsigned char *addr;
+	unsigned long int phys;
+	size_t size;
+	const hammer_config *cfg;
+	hammer_stats *stats;
+	pattern_result *result;
+	unsigned long int row_offset;	/* Offset of the row being checked */
+} hammer_ctx;
+
+/* Keeps the compiler from dropping the aggressor reads */
+static volatile unsigned long int hammer_sink;
+
+static unsigned long int bank_of(const hammer_config *cfg, unsigned long int phys)
+{
+	return (phys / cfg->row_size) % cfg->banks;
+}
+
+static unsigned long int row_of(const hammer_config *cfg, unsigned long int phys)
+{
+	return phys / (cfg->row_size * cfg->banks);
+}
+
+/* Buffer offset of a bank row, -1 if the row is not fully inside the buffer */
+static long int row_offset(const hammer_ctx *h, unsigned long int row, unsigned long int bank)
+{
+	unsigned long int phys = row * h->cfg->row_size * h->cfg->banks + bank * h->cfg->row_size;
+
+	if (phys < h->phys || phys - h->phys + h->cfg->row_size > h->size)
+		return -1;
+	return (long int)(phys - h->phys);
+}
+
+/* Write a row and make sure it reaches DRAM */
+static void row_fill(const hammer_ctx *h, unsigned long int offset, unsigned long int value)
+{
+	pattern_desc desc = { .type = PATTERN_USER, .value = value };
+
+	pattern_fill(h->addr + offset, h->cfg->row_size, &desc, 0);
+	if (h->cfg->flush)
+		cache_clean_range(h->addr + offset, h->cfg->row_size);
+}
+
+static void record_flip(void *ctx, unsigned long int offset, unsigned long int expected,
+			unsigned long int actual)
+{
+	hammer_ctx *h = (hammer_ctx *)ctx;
+	hammer_stats *stats = h->stats;
+	pattern_result *result = h->result;
+	unsigned long int phys = h->phys + h->row_offset + offset;
+	unsigned long int bank = bank_of(h->cfg, phys), row = row_of(h->cfg, phys);
+	unsigned long int bits = __builtin_popcountl(expected ^ actual);
+	unsigned int i;
+
+	stats->flips += bits;
+	stats->bank_flips[bank] += bits;
+	for (i = 0; i < stats->nrows; i++)
+		if (stats->rows[i].bank == bank && stats->rows[i].row == row)
+			break;
+	if (i == stats->nrows && stats->nrows < HAMMER_MAX_ROWS) {
+		stats->rows[i].bank = bank;
+		stats->rows[i].row = row;
+		stats->rows[i].flips = 0;
+		stats->nrows++;
+	}
+	if (i < stats->nrows)
+		stats->rows[i].flips += bits;
+
+	offset += h->row_offset;
+	if (result->mismatches++ == 0) {
+		result->first_offset = offset;
+		result->first_expected = expected;
+		result->first_actual = actual;
+	}
+	if (result->on_error)
+		result->on_error(result->ctx, offset, expected, actual);
+}
+
+/* Check a victim row straight from DRAM and rewrite it if it flipped */
+static void row_check(hammer_ctx *h, unsigned long int offset)
+{
+	pattern_desc desc = { .type = PATTERN_USER, .value = h->cfg->value };
+	pattern_result local;
+
+	memset(&local, 0, sizeof(local));
+	local.on_error = record_flip;
+	local.ctx = h;
+	h->row_offset = offset;
+	if (h->cfg->flush)
+		cache_inval_range(h->addr + offset, h->cfg->row_size);
+	if (pattern_verify(h->addr + offset, h->cfg->row_size, &desc, 0, &local))
+		row_fill(h, offset, h->cfg->value);
+}
+
+static void hammer_pair(const volatile unsigned long int *a, const volatile unsigned long int *b,
+			unsigned long int count, int flush)
+{
+	unsigned long int i, sum = 0;
+
+	if (flush) {
+		for (i = 0; i < count; i++) {
+			sum += *a;
+			sum += *b;
+			cache_evict_line((const void *)a);
+			cache_evict_line((const void *)b);
+			cache_barrier();
+		}
+	} else {
+		for (i = 0; i < count; i++) {
+			sum += *a;
+			sum += *b;
+		}
+	}
+	hammer_sink = sum;
+}
+
+/*
+ * Hammer the aggressors at buffer offsets a and b, then check the rows on
+ * either side of each of them in the same bank.
+ */
+static void hammer_one(hammer_ctx *h, unsigned long int a, unsigned long int b)
+{
+	const hammer_config *cfg = h->cfg;
+	unsigned long int offsets[2] = { a, b }, phys;
+	long int rows[2], victims[4], victim;
+	int i, j, side, nvictims = 0;
+	struct timespec start, end;
+
+	//Aggressor rows hold the complement of the victims
+	for (i = 0; i < 2; i++) {
+		phys = h->phys + offsets[i];
+		rows[i] = row_offset(h, row_of(cfg, phys), bank_of(cfg, phys));
+		if (rows[i] >= 0)
+			row_fill(h, rows[i], ~cfg->value);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	hammer_pair((const volatile unsigned long int *)(h->addr + a),
+		    (const volatile unsigned long int *)(h->addr + b), cfg->count, cfg->flush);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	h->stats->seconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	h->stats->activations += 2 * cfg->count;
+	h->stats->pairs++;
+
+	for (i = 0; i < 2; i++) {
+		phys = h->phys + offsets[i];
+		if (rows[i] >= 0)
+			row_fill(h, rows[i], cfg->value);
+		for (side = -1; side <= 1; side += 2) {
+			if (row_of(cfg, phys) == 0 && side < 0)
+				continue;
+			victim = row_offset(h, row_of(cfg, phys) + side, bank_of(cfg, phys));
+			if (victim < 0 || victim == rows[0] || victim == rows[1])
+				continue;
+			//Double-sided pairs share the victim in the middle
+			for (j = 0; j < nvictims && victims[j] != victim; j++)
+				;
+			if (j == nvictims)
+				victims[nvictims++] = victim;
+		}
+	}
+	for (j = 0; j < nvictims; j++)
+		row_check(h, victims[j]);
+}
+
+int hammer_run(void *addr, unsigned long int phys, size_t size, const hammer_config *cfg,
+	       volatile int *active, hammer_stats *stats, pattern_result *result)
+{
+	pattern_desc desc = { .type = PATTERN_USER, .value = cfg->value };
+	unsigned long int row, first, last, bank, word = sizeof(unsigned long int);
+	long int a, b;
+	hammer_ctx h;
+	unsigned int i;
+
+	if (cfg->row_size == 0 || cfg->banks == 0 || cfg->banks > HAMMER_MAX_BANKS)
+		return -1;
+
+	h.addr = (unsigned char *)addr;
+	h.phys = phys;
+	h.size = size;
+	h.cfg = cfg;
+	h.stats = stats;
+	h.result = result;
+	h.row_offset = 0;
+
+	pattern_fill(addr, size, &desc, 0);
+	if (cfg->flush)
+		cache_clean_range(addr, size);
+
+	if (cfg->npairs) {
+		for (i = 0; i < cfg->npairs; i++)
+			if (cfg->pairs[i][0] + word > size || cfg->pairs[i][1] + word > size)
+				return -1;
+		for (i = 0; i < cfg->npairs && *active; i++)
+			hammer_one(&h, cfg->pairs[i][0] & ~(word - 1), cfg->pairs[i][1] & ~(word - 1));
+		return 0;
+	}
+
+	//Double-sided, every row with both neighbours in the buffer is a victim once
+	first = row_of(cfg, phys) + 1;
+	last = row_of(cfg, phys + size - 1);
+	for (row = first; row < last && *active; row++) {
+		for (bank = 0; bank < cfg->banks && *active; bank++) {
+			a = row_offset(&h, row - 1, bank);
+			b = row_offset(&h, row + 1, bank);
+			if (a >= 0 && b >= 0)
+				hammer_one(&h, a, b);
+		}
+	}
+
+	return stats->pairs ? 0 : -1;
+}
+
+void hammer_report(const hammer_stats *stats, const hammer_config *cfg, FILE *out,
+		   const char *name)
+{
+	double rate = stats->seconds > 0 ? stats->activations / stats->seconds : 0;
+	unsigned long int listed = 0;
+	unsigned int i;
+
+	fprintf(out, "%s: hammered %lu pairs, %lu activations in %.2fs, %.2fM/s, %.1fns each, "
+			"%.0f per aggressor per %dms\n",
+			name, stats->pairs, stats->activations, stats->seconds, rate / 1e6,
+			rate > 0 ? 1e9 / rate : 0, rate / 2 * HAMMER_REFRESH_MS / 1000, HAMMER_REFRESH_MS);
+	fprintf(out, "%s: %lu bit flips\n", name, stats->flips);
+	if (stats->flips == 0)
+		return;
+
+	fprintf(out, "  banks:");
+	for (i = 0; i < cfg->banks; i++)
+		if (stats->bank_flips[i])
+			fprintf(out, " %u:%lu", i, stats->bank_flips[i]);
+	fprintf(out, "\n");
+	for (i = 0; i < stats->nrows; i++) {
+		fprintf(out, "  bank %lu row 0x%lx: %lu\n", stats->rows[i].bank, stats->rows[i].row,
+				stats->rows[i].flips);
+		listed += stats->rows[i].flips;
+	}
+	if (listed < stats->flips)
+		fprintf(out, "  %lu more in other rows\n", stats->flips - listed);
+}
@@ -0,0 +1,81 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Row hammer stress of one physically contiguous buffer.
+ *
+ * Pairs of aggressor addresses are read back to back as fast as possible,
+ * each read reaching DRAM either because the buffer is uncached or because
+ * both lines are evicted after every read. When both aggressors sit in the
+ * same bank every read is a row activation. The rows next to the
+ * aggressors are checked after each pair.
+ *
+ * The controller address map is not known here, so rows and banks come
+ * from a linear model: a bank row covers row_size bytes and consecutive
+ * rows of the buffer rotate through the banks,
+ *
+ *	bank = (phys / row_size) % banks
+ *	row  = phys / (row_size * banks)
+ */
+
+#ifndef HAMMER_H
+#define HAMMER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "pattern.h"
+
+#define HAMMER_MAX_PAIRS	32
+#define HAMMER_MAX_BANKS	64
+/* Rows with flips listed one by one, the rest only count per bank */
+#define HAMMER_MAX_ROWS		64
+/* DRAM refresh window the activation rate is quoted against */
+#define HAMMER_REFRESH_MS	64
+
+typedef struct {
+	unsigned long int row_size;	/* Bytes of one row of one bank */
+	unsigned int banks;
+	unsigned long int count;	/* Reads of each aggressor per pair */
+	int flush;			/* Evict both lines after every read */
+	unsigned long int value;	/* Victim data, aggressors hold its complement */
+	/*
+	 * Buffer offsets of the aggressor pairs. With none, every row of
+	 * every bank is hammered double-sided from the rows around it.
+	 */
+	unsigned long int pairs[HAMMER_MAX_PAIRS][2];
+	unsigned int npairs;
+} hammer_config;
+
+typedef struct {
+	unsigned long int bank;
+	unsigned long int row;
+	unsigned long int flips;
+} hammer_row;
+
+typedef struct {
+	unsigned long int pairs;	/* Pairs hammered */
+	unsigned long int activations;	/* Aggressor reads */
+	double seconds;			/* Time spent in the read loop */
+	unsigned long int flips;	/* Flipped bits in checked rows */
+	unsigned long int bank_flips[HAMMER_MAX_BANKS];
+	hammer_row rows[HAMMER_MAX_ROWS];
+	unsigned int nrows;
+} hammer_stats;
+
+/*
+ * Fill the buffer with cfg->value and hammer every pair, until done or
+ * *active drops to 0. Flips are added to stats, which the caller zeroes,
+ * and to result like pattern_verify() does, offsets relative to addr. The
+ * buffer holds cfg->value again when this returns. Returns -1 if no pair
+ * fits in the buffer.
+ */
+int hammer_run(void *addr, unsigned long int phys, size_t size, const hammer_config *cfg,
+	       volatile int *active, hammer_stats *stats, pattern_result *result);
+
+void hammer_report(const hammer_stats *stats, const hammer_config *cfg, FILE *out,
+		   const char *name);
+
+#endif /* HAMMER_H */
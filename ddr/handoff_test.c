@@ -0,0 +1,516 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Producer/consumer handoff over a ring of cached simaai_memory buffers,
+ * the way an inference pipeline passes frames between CPU stages: the
+ * producer fills a buffer, flushes it and queues it, the consumer
+ * invalidates it, consumes it and returns it to the free queue.
+ *
+ * Ring slots are mem_pool blocks, so flush and invalidate go through the
+ * same path as in ddr_test and memory_test. Up to MEM_POOL_MAX_SLABS slots
+ * each get a slab of their own and are maintained through libsimaaimem,
+ * deeper rings share slabs and are maintained by VA range.
+ */
+
+#define _GNU_SOURCE
+#include <getopt.h>
+#include <libgen.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <simaai/simaai_memory.h>
+
+#include "clock.h"
+#include "histogram.h"
+#include "mem_pool.h"
+#include "spsc.h"
+
+#define MAX_DEPTH	1024
+/* Polls of an empty or full queue before yielding the CPU */
+#define SPIN_LIMIT	1000
+/* Index pushed by the producer after its last frame */
+#define FRAME_END	0xffffffffU
+
+typedef enum {
+	STAGE_WAIT_FREE,	/* Producer waiting for a free buffer */
+	STAGE_PRODUCE,
+	STAGE_FLUSH,
+	STAGE_QUEUE,		/* Queued until the consumer picks it up */
+	STAGE_INVALIDATE,
+	STAGE_CONSUME,
+	STAGE_END_TO_END,
+	STAGE_NUM,
+} stage;
+
+static const char *stage_names[STAGE_NUM] = {
+	"wait_free", "produce", "flush", "queue", "invalidate", "consume", "end-to-end",
+};
+
+typedef enum {
+	WORK_NONE,
+	WORK_WRITE,	/* Producer only */
+	WORK_READ,	/* Consumer only */
+	WORK_COPY,
+} work_mode;
+
+typedef struct {
+	unsigned int depth;
+	unsigned long int size;
+	int target;
+	int flags;
+	unsigned int sleep_time;
+	unsigned long int frames;
+	work_mode produce;
+	work_mode consume;
+	unsigned int passes;
+	int producer_cpu;
+	int consumer_cpu;
+} args;
+
+/* Written by the producer before the index is queued */
+typedef struct {
+	unsigned long int frame;
+	unsigned long int start;	/* ns, start of produce */
+	unsigned long int queued;	/* ns, after flush */
+} frame_meta;
+
+typedef struct {
+	args *args;
+	mem_pool pool;
+	mem_block buffers[MAX_DEPTH];
+	frame_meta meta[MAX_DEPTH];
+	spsc_queue full;
+	spsc_queue free;
+	void *scratch[2];		/* Producer copy source, consumer copy destination */
+	volatile int active;
+	unsigned long int produced;
+	unsigned long int consumed;
+	unsigned long int stale;	/* Frames whose header or trailer did not match */
+	histogram stages[STAGE_NUM];	/* Each one written by a single thread */
+} pipeline;
+
+static inline void cpu_relax(void)
+{
+#if defined(__aarch64__)
+	asm volatile("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+	asm volatile("pause" ::: "memory");
+#endif
+}
+
+static void backoff(unsigned int *spins)
+{
+	if (++(*spins) < SPIN_LIMIT) {
+		cpu_relax();
+	} else {
+		*spins = 0;
+		sched_yield();
+	}
+}
+
+static void produce(pipeline *p, void *addr, unsigned long int frame)
+{
+	unsigned long int *words = (unsigned long int *)addr;
+	unsigned long int count = p->args->size / sizeof(*words);
+	unsigned int pass;
+
+	for (pass = 0; pass < p->args->passes; pass++) {
+		if (p->args->produce == WORK_WRITE)
+			memset(addr, (int)(frame + pass), p->args->size);
+		else if (p->args->produce == WORK_COPY)
+			memcpy(addr, p->scratch[0], p->args->size);
+	}
+
+	//Tag the frame so the consumer can spot stale lines
+	words[0] = frame;
+	words[count - 1] = ~frame;
+}
+
+static int consume(pipeline *p, void *addr, unsigned long int frame)
+{
+	volatile unsigned long int *words = (volatile unsigned long int *)addr;
+	unsigned long int count = p->args->size / sizeof(*words);
+	unsigned long int sum = 0, i;
+	unsigned int pass;
+	int stale = (words[0] != frame || words[count - 1] != ~frame);
+
+	for (pass = 0; pass < p->args->passes; pass++) {
+		if (p->args->consume == WORK_READ) {
+			for (i = 0; i < count; i++)
+				sum += words[i];
+		} else if (p->args->consume == WORK_COPY) {
+			memcpy(p->scratch[1], addr, p->args->size);
+		}
+	}
+	(void)sum;
+
+	return stale;
+}
+
+static void *producer_task(void *arg)
+{
+	pipeline *p = (pipeline *)arg;
+	unsigned long int frame, t0, t1, t2;
+	unsigned int index, spins;
+
+	for (frame = 0; p->active && (p->args->frames == 0 || frame < p->args->frames); frame++) {
+		t0 = now_ns();
+		spins = 0;
+		while (spsc_pop(&p->free, &index) != 0) {
+			if (!p->active)
+				goto done;
+			backoff(&spins);
+		}
+
+		t1 = now_ns();
+		hist_record(&p->stages[STAGE_WAIT_FREE], t1 - t0);
+		produce(p, p->buffers[index].virt, frame);
+		t2 = now_ns();
+		hist_record(&p->stages[STAGE_PRODUCE], t2 - t1);
+		mem_block_flush(&p->pool, &p->buffers[index]);
+		t0 = now_ns();
+		hist_record(&p->stages[STAGE_FLUSH], t0 - t2);
+
+		p->meta[index].frame = frame;
+		p->meta[index].start = t1;
+		p->meta[index].queued = t0;
+		//Never full, the ring holds every buffer at most once
+		spsc_push(&p->full, index);
+	}
+
+done:
+	p->produced = frame;
+	spins = 0;
+	while (spsc_push(&p->full, FRAME_END) != 0)
+		backoff(&spins);
+	return NULL;
+}
+
+static void *consumer_task(void *arg)
+{
+	pipeline *p = (pipeline *)arg;
+	unsigned long int t0, t1, t2;
+	unsigned int index, spins;
+	frame_meta *meta;
+
+	for (;;) {
+		spins = 0;
+		while (spsc_pop(&p->full, &index) != 0)
+			backoff(&spins);
+		if (index == FRAME_END)
+			break;
+
+		meta = &p->meta[index];
+		t0 = now_ns();
+		hist_record(&p->stages[STAGE_QUEUE], t0 - meta->queued);
+		mem_block_invalidate(&p->pool, &p->buffers[index]);
+		t1 = now_ns();
+		hist_record(&p->stages[STAGE_INVALIDATE], t1 - t0);
+		if (consume(p, p->buffers[index].virt, meta->frame))
+			p->stale++;
+		t2 = now_ns();
+		hist_record(&p->stages[STAGE_CONSUME], t2 - t1);
+		hist_record(&p->stages[STAGE_END_TO_END], t2 - meta->start);
+
+		__atomic_store_n(&p->consumed, p->consumed + 1, __ATOMIC_RELAXED);
+		spsc_push(&p->free, index);
+	}
+
+	return NULL;
+}
+
+static int parse_work(const char *str, work_mode *mode, work_mode data)
+{
+	if (strcmp(str, "none") == 0)
+		*mode = WORK_NONE;
+	else if (strcmp(str, "copy") == 0)
+		*mode = WORK_COPY;
+	else if (strcmp(str, data == WORK_WRITE ? "write" : "read") == 0)
+		*mode = data;
+	else
+		return -1;
+	return 0;
+}
+
+static int parse_args(const int argc, char *const argv[], args *args)
+{
+	char *filename = argv[0];
+	struct option long_options[] = {
+		{ "help",         no_argument,       NULL, 'h' },
+		{ "depth",        required_argument, NULL, 'n' },
+		{ "size",         required_argument, NULL, 's' },
+		{ "target",       required_argument, NULL, 'm' },
+		{ "uncached",     no_argument,       NULL, 'u' },
+		{ "time",         required_argument, NULL, 't' },
+		{ "frames",       required_argument, NULL, 'f' },
+		{ "produce",      required_argument, NULL, 'p' },
+		{ "consume",      required_argument, NULL, 'c' },
+		{ "passes",       required_argument, NULL, 'k' },
+		{ "producer-cpu", required_argument, NULL, 'P' },
+		{ "consumer-cpu", required_argument, NULL, 'C' },
+		{ 0,              0,                 0,    0  }
+	};
+	const char usage[] =
+		"Usage: %s [OPTIONS]\n"
+		"Pass frames between a producer and a consumer thread over a ring of buffers.\n"
+		"\n"
+		"  -h, --help            Display this help and exit\n"
+		"  -n, --depth=N         Number of buffers in the ring, default: 4\n"
+		"  -s, --size=SIZE       Size of each buffer, default: 0x100000\n"
+		"  -m, --target=TARGET   dms0, dms1, dms2, dms3 or ocm, default: dms0\n"
+		"  -u, --uncached        Allocate uncached buffers, default: cached\n"
+		"  -t, --time=TIME       Seconds to run, default: 5\n"
+		"  -f, --frames=N        Stop after N frames instead, default: 0 (use time)\n"
+		"  -p, --produce=WORK    Producer work: write, copy or none, default: write\n"
+		"  -c, --consume=WORK    Consumer work: read, copy or none, default: read\n"
+		"  -k, --passes=N        Repeat the stage work N times per frame, default: 1\n"
+		"  -P, --producer-cpu=N  Pin the producer to a core, -1 - no pinning, default: 0\n"
+		"  -C, --consumer-cpu=N  Pin the consumer to a core, -1 - no pinning, default: 1\n";
+	int option_index;
+	int c;
+
+	while (1) {
+		option_index = 0;
+		c = getopt_long(argc, argv, "hn:s:m:ut:f:p:c:k:P:C:", long_options, &option_index);
+
+		if (c == -1)
+			break;
+
+		switch (c) {
+		case 'h':
+			fprintf(stderr, usage, basename(filename));
+			return -1;
+		case 'n':
+			args->depth = strtoul(optarg, NULL, 0);
+			if (args->depth < 1 || args->depth > MAX_DEPTH) {
+				fprintf(stderr, "Invalid depth, use 1 to %d\n", MAX_DEPTH);
+				return -1;
+			}
+			break;
+		case 's':
+			args->size = strtoul(optarg, NULL, 0);
+			if (args->size < 16) {
+				fprintf(stderr, "Invalid size, buffers hold at least 16 bytes\n");
+				return -1;
+			}
+			break;
+		case 'm':
+			if (strcmp(optarg, "ocm") == 0) {
+				args->target = SIMAAI_MEM_TARGET_OCM;
+			} else if (strncmp(optarg, "dms", 3) == 0 && optarg[3] >= '0' && optarg[3] <= '3' &&
+				   optarg[4] == '\0') {
+				args->target = SIMAAI_MEM_TARGET_DMS0 + (optarg[3] - '0');
+			} else {
+				fprintf(stderr, "Invalid target\n");
+				return -1;
+			}
+			break;
+		case 'u':
+			args->flags = SIMAAI_MEM_FLAG_DEFAULT;
+			break;
+		case 't':
+			args->sleep_time = strtoul(optarg, NULL, 10);
+			break;
+		case 'f':
+			args->frames = strtoul(optarg, NULL, 10);
+			break;
+		case 'p':
+			if (parse_work(optarg, &args->produce, WORK_WRITE) != 0) {
+				fprintf(stderr, "Invalid producer work\n");
+				return -1;
+			}
+			break;
+		case 'c':
+			if (parse_work(optarg, &args->consume, WORK_READ) != 0) {
+				fprintf(stderr, "Invalid consumer work\n");
+				return -1;
+			}
+			break;
+		case 'k':
+			args->passes = strtoul(optarg, NULL, 10);
+			break;
+		case 'P':
+			args->producer_cpu = strtol(optarg, NULL, 10);
+			break;
+		case 'C':
+			args->consumer_cpu = strtol(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, usage, basename(filename));
+			return -1;
+		}
+	}
+
+	//Buffers are tagged with whole words
+	args->size &= ~7UL;
+
+	return 0;
+}
+
+static int start_thread(pthread_t *thread, int cpu, void *(*fn)(void *), void *arg)
+{
+	pthread_attr_t attr;
+	cpu_set_t set;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int res;
+
+	pthread_attr_init(&attr);
+	if (cpu >= 0) {
+		CPU_ZERO(&set);
+		CPU_SET(cpus > 0 ? cpu % cpus : 0, &set);
+		pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+	}
+	res = pthread_create(thread, &attr, fn, arg);
+	pthread_attr_destroy(&attr);
+
+	return res;
+}
+
+static void print_results(pipeline *p, double elapsed)
+{
+	double worst = 0;
+	int bottleneck = STAGE_PRODUCE;
+	int s;
+
+	printf("Frames: %lu produced, %lu consumed in %.2fs, %.1f frames/s, %.2fGB/s\n", p->produced,
+	       p->consumed, elapsed, p->consumed / elapsed,
+	       p->consumed * (double)p->args->size / elapsed / 1e9);
+	printf("%-11s %10s %10s %10s %10s\n", "Stage", "mean(us)", "p50(us)", "p99(us)", "p99.9(us)");
+	for (s = 0; s < STAGE_NUM; s++) {
+		printf("%-11s %10.2f %10.2f %10.2f %10.2f\n", stage_names[s],
+		       hist_mean(&p->stages[s]) / 1e3,
+		       hist_percentile(&p->stages[s], 0.50) / 1e3,
+		       hist_percentile(&p->stages[s], 0.99) / 1e3,
+		       hist_percentile(&p->stages[s], 0.999) / 1e3);
+	}
+
+	//Only stages doing work can be the bottleneck, waits are a symptom
+	for (s = STAGE_PRODUCE; s <= STAGE_CONSUME; s++) {
+		if (s == STAGE_QUEUE)
+			continue;
+		if (hist_mean(&p->stages[s]) > worst) {
+			worst = hist_mean(&p->stages[s]);
+			bottleneck = s;
+		}
+	}
+	printf("Bottleneck: %s (%.2fus per frame)\n", stage_names[bottleneck], worst / 1e3);
+	printf("Producer: %.2fus per frame, consumer: %.2fus per frame\n",
+	       (hist_mean(&p->stages[STAGE_PRODUCE]) + hist_mean(&p->stages[STAGE_FLUSH])) / 1e3,
+	       (hist_mean(&p->stages[STAGE_INVALIDATE]) + hist_mean(&p->stages[STAGE_CONSUME])) / 1e3);
+	printf("Stale frames: %lu\n", p->stale);
+}
+
+int main(int argc, char *argv[])
+{
+	args args = {
+		.depth = 4,
+		.size = 0x100000,
+		.target = SIMAAI_MEM_TARGET_DMS0,
+		.flags = SIMAAI_MEM_FLAG_CACHED,
+		.sleep_time = 5,
+		.frames = 0,
+		.produce = WORK_WRITE,
+		.consume = WORK_READ,
+		.passes = 1,
+		.producer_cpu = 0,
+		.consumer_cpu = 1,
+	};
+	pthread_t producer, consumer;
+	pipeline *p;
+	unsigned long int start;
+	unsigned int i, per_slab;
+	int ret = EXIT_FAILURE;
+
+	if (parse_args(argc, argv, &args) != 0)
+		return EXIT_FAILURE;
+
+	p = (pipeline *)calloc(1, sizeof(*p));
+	if (!p) {
+		perror("Failed to allocate pipeline");
+		return EXIT_FAILURE;
+	}
+	p->args = &args;
+	p->active = 1;
+	for (i = 0; i < STAGE_NUM; i++)
+		hist_init(&p->stages[i]);
+
+	if (spsc_init(&p->full, args.depth + 1) != 0 || spsc_init(&p->free, args.depth) != 0) {
+		perror("Failed to allocate queues");
+		goto free_queues;
+	}
+
+	for (i = 0; i < 2; i++) {
+		p->scratch[i] = aligned_alloc(64, (args.size + 63) & ~63UL);
+		if (!p->scratch[i]) {
+			perror("Failed to allocate scratch buffer");
+			goto free_scratch;
+		}
+		memset(p->scratch[i], 0x5a, args.size);
+	}
+
+	//Every slot a slab of its own while they fit in the pool
+	per_slab = (args.depth + MEM_POOL_MAX_SLABS - 1) / MEM_POOL_MAX_SLABS;
+	if (mem_pool_init(&p->pool, "ring", args.target, args.flags, per_slab * args.size,
+			  (size_t)args.depth * args.size) != 0)
+		goto free_scratch;
+
+	for (i = 0; i < args.depth; i++) {
+		if (mem_pool_alloc(&p->pool, args.size, 0, &p->buffers[i]) != 0) {
+			fprintf(stderr, "Failed to allocate buffer %u\n", i);
+			goto free_buffers;
+		}
+		spsc_push(&p->free, i);
+	}
+
+	printf("Ring: %u x 0x%lx bytes, %s\n", args.depth, args.size,
+	       args.flags & SIMAAI_MEM_FLAG_CACHED ? "cached" : "uncached");
+
+	start = now_ns();
+	if (start_thread(&consumer, args.consumer_cpu, consumer_task, p) != 0) {
+		perror("Failed to create consumer");
+		goto free_buffers;
+	}
+	if (start_thread(&producer, args.producer_cpu, producer_task, p) != 0) {
+		perror("Failed to create producer");
+		//Let the consumer see the end of the stream
+		spsc_push(&p->full, FRAME_END);
+		pthread_join(consumer, NULL);
+		goto free_buffers;
+	}
+
+	//Run for n seconds, or until the requested frames are through
+	if (args.frames == 0)
+		sleep(args.sleep_time);
+	else
+		while (p->active && __atomic_load_n(&p->consumed, __ATOMIC_RELAXED) < args.frames)
+			usleep(1000);
+	p->active = 0;
+
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+
+	print_results(p, (now_ns() - start) / 1e9);
+	ret = p->stale ? EXIT_FAILURE : EXIT_SUCCESS;
+
+free_buffers:
+	for (i = 0; i < args.depth; i++)
+		mem_pool_free(&p->pool, &p->buffers[i]);
+	mem_pool_report(&p->pool, stderr);
+	mem_pool_destroy(&p->pool);
+free_scratch:
+	free(p->scratch[0]);
+	free(p->scratch[1]);
+free_queues:
+	spsc_destroy(&p->full);
+	spsc_destroy(&p->free);
+	free(p);
+
+	return ret;
+}
@@ -0,0 +1,56 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Host stand-in for libsimaaimem. It exposes the subset of the
+ * simaai_memory API used by the DDR tools, so they can be built and
+ * benchmarked on a regular Linux machine with "make host".
+ *
+ * Targets are modelled as separate pools with their own capacity and fake
+ * physical address range. Buffers are backed by (huge page) anonymous
+ * mappings. Cache maintenance on SIMAAI_MEM_FLAG_CACHED buffers walks the
+ * buffer by VA, uncached buffers skip it the same way the real driver does,
+ * but their accesses still go through the host caches.
+ */
+
+#ifndef SIMAAI_MEMORY_HOST_H
+#define SIMAAI_MEMORY_HOST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIMAAI_MEM_TARGET_GENERIC	0
+#define SIMAAI_MEM_TARGET_OCM		1
+#define SIMAAI_MEM_TARGET_DMS0		2
+#define SIMAAI_MEM_TARGET_DMS1		3
+#define SIMAAI_MEM_TARGET_DMS2		4
+#define SIMAAI_MEM_TARGET_DMS3		5
+#define SIMAAI_MEM_TARGET_NUM		6
+
+#define SIMAAI_MEM_FLAG_DEFAULT		0
+#define SIMAAI_MEM_FLAG_CACHED		1
+#define SIMAAI_MEM_FLAG_RDONLY		2
+
+typedef struct simaai_memory simaai_memory_t;
+
+simaai_memory_t *simaai_memory_alloc(unsigned int size, int target);
+simaai_memory_t *simaai_memory_alloc_flags(unsigned int size, int target, int flags);
+void simaai_memory_free(simaai_memory_t *memory);
+
+void *simaai_memory_map(simaai_memory_t *memory);
+void simaai_memory_unmap(simaai_memory_t *memory);
+
+unsigned int simaai_memory_get_size(simaai_memory_t *memory);
+unsigned long int simaai_memory_get_phys(simaai_memory_t *memory);
+
+int simaai_memory_flush_cache(simaai_memory_t *memory);
+int simaai_memory_invalidate_cache(simaai_memory_t *memory);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIMAAI_MEMORY_HOST_H */
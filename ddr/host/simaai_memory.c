@@ -0,0 +1,254 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <simaai/simaai_memory.h>
+
+#include "cache_ops.h"
+
+#define HUGE_PAGE_SIZE	(2UL << 20)
+#define PAGE_SIZE_4K	4096UL
+
+struct simaai_memory {
+	void *virt;
+	size_t size;		/* Requested size */
+	size_t mapped;		/* Size of the backing mapping */
+	unsigned long int phys;
+	int target;
+	int flags;
+	int map_count;
+	struct simaai_memory *next;	/* Next allocation of the target by phys */
+};
+
+typedef struct {
+	const char *name;
+	const char *env;	/* Environment variable overriding capacity */
+	unsigned long int phys_base;
+	unsigned long int capacity;
+	unsigned long int used;	/* Bytes currently allocated */
+	simaai_memory_t *live;	/* Allocations ordered by phys */
+} host_target;
+
+/* Capacities and address ranges roughly follow the MLSoC memory map */
+static host_target host_targets[SIMAAI_MEM_TARGET_NUM] = {
+	[SIMAAI_MEM_TARGET_GENERIC] = { "generic", "SIMAAI_HOST_GENERIC_SIZE", 0x0040000000UL, 1UL << 30 },
+	[SIMAAI_MEM_TARGET_OCM]     = { "ocm",     "SIMAAI_HOST_OCM_SIZE",     0x0000000000UL, 16UL << 20 },
+	[SIMAAI_MEM_TARGET_DMS0]    = { "dms0",    "SIMAAI_HOST_DMS_SIZE",     0x0080000000UL, 4UL << 30 },
+	[SIMAAI_MEM_TARGET_DMS1]    = { "dms1",    "SIMAAI_HOST_DMS_SIZE",     0x0180000000UL, 4UL << 30 },
+	[SIMAAI_MEM_TARGET_DMS2]    = { "dms2",    "SIMAAI_HOST_DMS_SIZE",     0x0280000000UL, 4UL << 30 },
+	[SIMAAI_MEM_TARGET_DMS3]    = { "dms3",    "SIMAAI_HOST_DMS_SIZE",     0x0380000000UL, 4UL << 30 },
+};
+
+static pthread_mutex_t host_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t host_once = PTHREAD_ONCE_INIT;
+static int host_hugepages = 1;
+
+static void host_init(void)
+{
+	const char *env;
+	int i;
+
+	for (i = 0; i < SIMAAI_MEM_TARGET_NUM; i++) {
+		env = getenv(host_targets[i].env);
+		if (env)
+			host_targets[i].capacity = strtoul(env, NULL, 0);
+	}
+
+	env = getenv("SIMAAI_HOST_HUGEPAGES");
+	if (env)
+		host_hugepages = atoi(env);
+}
+
+/*
+ * Back the buffer with explicit huge pages when possible, like CMA does
+ * with physically contiguous memory, and fall back to transparent huge
+ * pages. Pages are populated up front, allocation cost lands in alloc as
+ * it does on target.
+ */
+static void *host_map_backing(size_t size, size_t *mapped)
+{
+	void *addr = MAP_FAILED;
+	size_t len;
+
+	if (host_hugepages && size >= HUGE_PAGE_SIZE) {
+		len = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+		addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+			    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if (addr != MAP_FAILED) {
+			*mapped = len;
+			return addr;
+		}
+	}
+
+	len = (size + PAGE_SIZE_4K - 1) & ~(PAGE_SIZE_4K - 1);
+	addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED)
+		return NULL;
+	if (host_hugepages && size >= HUGE_PAGE_SIZE)
+		madvise(addr, len, MADV_HUGEPAGE);
+	madvise(addr, len, MADV_WILLNEED);
+	memset(addr, 0, len);
+
+	*mapped = len;
+	return addr;
+}
+
+/*
+ * Give memory the lowest fake physical range of t that fits it, first fit
+ * over the live allocations, so freed ranges are reused and repeated
+ * alloc/free cycles stay inside the target. Called with host_lock held.
+ */
+static int host_place(host_target *t, simaai_memory_t *memory, size_t size)
+{
+	unsigned long int len = (size + PAGE_SIZE_4K - 1) & ~(PAGE_SIZE_4K - 1);
+	unsigned long int offset = 0;
+	simaai_memory_t **link;
+
+	for (link = &t->live; *link; link = &(*link)->next) {
+		if (offset + len <= (*link)->phys - t->phys_base)
+			break;
+		offset = (*link)->phys - t->phys_base +
+			 (((*link)->size + PAGE_SIZE_4K - 1) & ~(PAGE_SIZE_4K - 1));
+	}
+	if (offset + len > t->capacity)
+		return -1;
+
+	memory->phys = t->phys_base + offset;
+	memory->next = *link;
+	*link = memory;
+	return 0;
+}
+
+/* Called with host_lock held */
+static void host_unplace(host_target *t, simaai_memory_t *memory)
+{
+	simaai_memory_t **link;
+
+	for (link = &t->live; *link; link = &(*link)->next) {
+		if (*link == memory) {
+			*link = memory->next;
+			return;
+		}
+	}
+}
+
+simaai_memory_t *simaai_memory_alloc_flags(unsigned int size, int target, int flags)
+{
+	simaai_memory_t *memory;
+	host_target *t;
+
+	pthread_once(&host_once, host_init);
+
+	if (size == 0 || target < 0 || target >= SIMAAI_MEM_TARGET_NUM) {
+		errno = EINVAL;
+		return NULL;
+	}
+	t = &host_targets[target];
+
+	memory = (simaai_memory_t *)calloc(1, sizeof(*memory));
+	if (!memory)
+		return NULL;
+
+	memory->size = size;
+	pthread_mutex_lock(&host_lock);
+	if (t->used + size > t->capacity || host_place(t, memory, size) != 0) {
+		pthread_mutex_unlock(&host_lock);
+		fprintf(stderr, "simaai_memory(host): %s exhausted, %lu of %lu bytes used\n",
+				t->name, t->used, t->capacity);
+		free(memory);
+		errno = ENOMEM;
+		return NULL;
+	}
+	t->used += size;
+	pthread_mutex_unlock(&host_lock);
+
+	memory->virt = host_map_backing(size, &memory->mapped);
+	if (!memory->virt) {
+		pthread_mutex_lock(&host_lock);
+		t->used -= size;
+		host_unplace(t, memory);
+		pthread_mutex_unlock(&host_lock);
+		free(memory);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memory->target = target;
+	memory->flags = flags;
+
+	return memory;
+}
+
+simaai_memory_t *simaai_memory_alloc(unsigned int size, int target)
+{
+	return simaai_memory_alloc_flags(size, target, SIMAAI_MEM_FLAG_DEFAULT);
+}
+
+void simaai_memory_free(simaai_memory_t *memory)
+{
+	if (!memory)
+		return;
+
+	munmap(memory->virt, memory->mapped);
+
+	pthread_mutex_lock(&host_lock);
+	host_targets[memory->target].used -= memory->size;
+	host_unplace(&host_targets[memory->target], memory);
+	pthread_mutex_unlock(&host_lock);
+
+	free(memory);
+}
+
+void *simaai_memory_map(simaai_memory_t *memory)
+{
+	if (!memory)
+		return NULL;
+
+	__atomic_add_fetch(&memory->map_count, 1, __ATOMIC_RELAXED);
+	return memory->virt;
+}
+
+void simaai_memory_unmap(simaai_memory_t *memory)
+{
+	if (memory)
+		__atomic_sub_fetch(&memory->map_count, 1, __ATOMIC_RELAXED);
+}
+
+unsigned int simaai_memory_get_size(simaai_memory_t *memory)
+{
+	return memory ? memory->size : 0;
+}
+
+unsigned long int simaai_memory_get_phys(simaai_memory_t *memory)
+{
+	return memory ? memory->phys : 0;
+}
+
+int simaai_memory_flush_cache(simaai_memory_t *memory)
+{
+	if (!memory)
+		return -EINVAL;
+
+	if (memory->flags & SIMAAI_MEM_FLAG_CACHED)
+		cache_clean_range(memory->virt, memory->size);
+
+	return 0;
+}
+
+int simaai_memory_invalidate_cache(simaai_memory_t *memory)
+{
+	if (!memory)
+		return -EINVAL;
+
+	if (memory->flags & SIMAAI_MEM_FLAG_CACHED)
+		cache_inval_range(memory->virt, memory->size);
+
+	return 0;
+}
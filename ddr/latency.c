@@ -0,0 +1,85 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <stddef.h>
+#include <time.h>
+
+#include "latency.h"
+
+/* Loads between two clock reads */
+#define CHASE_CHUNK	16384UL
+
+/* Keeps the compiler from dropping the chase */
+static void * volatile chase_sink;
+
+static inline unsigned long int xorshift64(unsigned long int *state)
+{
+	unsigned long int x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+static inline unsigned long int *node(void *addr, size_t index)
+{
+	return (unsigned long int *)((char *)addr + index * CHASE_STRIDE);
+}
+
+void *chase_build(void *addr, size_t size, unsigned long int seed)
+{
+	size_t count = size / CHASE_STRIDE, i, j;
+	unsigned long int state = seed | 1, tmp;
+
+	if (count == 0)
+		return NULL;
+
+	/* Word 1 of node k holds the k-th node visited, shuffled in place */
+	for (i = 0; i < count; i++)
+		node(addr, i)[1] = i;
+	for (i = count - 1; i > 0; i--) {
+		j = xorshift64(&state) % (i + 1);
+		tmp = node(addr, i)[1];
+		node(addr, i)[1] = node(addr, j)[1];
+		node(addr, j)[1] = tmp;
+	}
+
+	/* Word 0 of every node points to the node visited after it */
+	for (i = 0; i < count; i++)
+		node(addr, node(addr, i)[1])[0] =
+			(unsigned long int)node(addr, node(addr, (i + 1) % count)[1]);
+
+	return node(addr, node(addr, 0)[1]);
+}
+
+#define CHASE1	p = (void **)*p;
+#define CHASE16	CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 \
+		CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1 CHASE1
+
+double chase_run(void *start, double min_time, unsigned long int *accesses)
+{
+	void **p = (void **)start;
+	struct timespec t0, t1;
+	unsigned long int i, n = 0;
+	double elapsed;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	do {
+		for (i = 0; i < CHASE_CHUNK; i += 16) {
+			CHASE16
+		}
+		n += CHASE_CHUNK;
+		clock_gettime(CLOCK_MONOTONIC, &t1);
+		elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+	} while (elapsed < min_time);
+
+	chase_sink = p;
+	if (accesses)
+		*accesses = n;
+
+	return elapsed * 1e9 / n;
+}
@@ -0,0 +1,28 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stddef.h>
+
+/* Distance between ring nodes, one node per cache line */
+#define CHASE_STRIDE	64UL
+
+/*
+ * Link the first size bytes of addr into a single randomized ring of
+ * pointers, one node every CHASE_STRIDE bytes, so that every load depends
+ * on the previous one and hardware prefetchers cannot follow. The ring is
+ * built in place, no extra memory is needed. Returns the first node.
+ */
+void *chase_build(void *addr, size_t size, unsigned long int seed);
+
+/*
+ * Follow the ring for at least min_time seconds and return the average
+ * load-to-use latency in ns. The number of loads is stored in accesses.
+ */
+double chase_run(void *start, double min_time, unsigned long int *accesses);
+
+#endif /* LATENCY_H */
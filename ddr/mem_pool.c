@@ -0,0 +1,203 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "cache_ops.h"
+#include "clock.h"
+#include "mem_pool.h"
+
+static void record(mem_pool_latency *latency, unsigned long int ns)
+{
+	latency->count++;
+	latency->total += ns;
+	if (ns > latency->max)
+		latency->max = ns;
+}
+
+/* Called with the pool locked */
+static int add_slab(mem_pool *pool, size_t size)
+{
+	unsigned long int start = now_ns();
+	mem_slab *slab;
+
+	if (pool->slab_count >= MEM_POOL_MAX_SLABS) {
+		fprintf(stderr, "Pool %s: out of slabs\n", pool->name);
+		return -1;
+	}
+	if (size == 0 || size > MEM_POOL_MAX_SLAB) {
+		fprintf(stderr, "Pool %s: invalid slab size 0x%zx\n", pool->name, size);
+		return -1;
+	}
+
+	slab = &pool->slabs[pool->slab_count];
+	memset(slab, 0, sizeof(*slab));
+	slab->memory = simaai_memory_alloc_flags(size, pool->target, pool->flags);
+	if (slab->memory == NULL) {
+		fprintf(stderr, "Pool %s: failed to allocate 0x%zx byte slab\n", pool->name, size);
+		return -1;
+	}
+	slab->virt = (unsigned char *)simaai_memory_map(slab->memory);
+	if (slab->virt == NULL) {
+		fprintf(stderr, "Pool %s: failed to map slab\n", pool->name);
+		simaai_memory_free(slab->memory);
+		slab->memory = NULL;
+		return -1;
+	}
+	slab->phys = simaai_memory_get_phys(slab->memory);
+	slab->size = size;
+	pool->slab_count++;
+
+	record(&pool->reserve, now_ns() - start);
+	return 0;
+}
+
+int mem_pool_init(mem_pool *pool, const char *name, int target, int flags,
+		  size_t slab_size, size_t reserve)
+{
+	size_t reserved = 0;
+
+	memset(pool, 0, sizeof(*pool));
+	pthread_mutex_init(&pool->lock, NULL);
+	pool->name = name;
+	pool->target = target;
+	pool->flags = flags;
+	pool->slab_size = slab_size;
+
+	while (reserved < reserve) {
+		if (add_slab(pool, slab_size) != 0) {
+			mem_pool_destroy(pool);
+			return -1;
+		}
+		reserved += slab_size;
+	}
+
+	return 0;
+}
+
+int mem_pool_alloc(mem_pool *pool, size_t size, size_t align, mem_block *block)
+{
+	unsigned long int start = now_ns();
+	uintptr_t addr;
+	size_t offset = 0;
+	mem_slab *slab;
+	unsigned int i;
+
+	if (align < MEM_POOL_ALIGN)
+		align = MEM_POOL_ALIGN;
+	if (size == 0 || (align & (align - 1)))
+		return -1;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->slab_count; i++) {
+		slab = &pool->slabs[i];
+		addr = ((uintptr_t)slab->virt + slab->top + align - 1) & ~(uintptr_t)(align - 1);
+		offset = addr - (uintptr_t)slab->virt;
+		if (offset + size <= slab->size)
+			break;
+	}
+	if (i == pool->slab_count) {
+		//No room left, grow by a slab big enough for this block
+		if (add_slab(pool, size > pool->slab_size ? size : pool->slab_size) != 0) {
+			pthread_mutex_unlock(&pool->lock);
+			return -1;
+		}
+		offset = 0;
+	}
+
+	slab = &pool->slabs[i];
+	slab->top = offset + size;
+	slab->live++;
+
+	block->virt = slab->virt + offset;
+	block->phys = slab->phys + offset;
+	block->size = size;
+	block->cached = (pool->flags & SIMAAI_MEM_FLAG_CACHED) != 0;
+	block->slab = i;
+	block->offset = offset;
+	block->end = offset + size;
+
+	record(&pool->alloc, now_ns() - start);
+	pthread_mutex_unlock(&pool->lock);
+
+	return 0;
+}
+
+void mem_pool_free(mem_pool *pool, mem_block *block)
+{
+	mem_slab *slab;
+
+	if (block->virt == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	slab = &pool->slabs[block->slab];
+	if (slab->top == block->end)
+		slab->top = block->offset;
+	if (--slab->live == 0)
+		slab->top = 0;
+	pthread_mutex_unlock(&pool->lock);
+
+	memset(block, 0, sizeof(*block));
+}
+
+void mem_pool_destroy(mem_pool *pool)
+{
+	unsigned int i;
+
+	for (i = 0; i < pool->slab_count; i++) {
+		if (pool->slabs[i].live)
+			fprintf(stderr, "Pool %s: %u blocks still in use in slab %u\n",
+					pool->name, pool->slabs[i].live, i);
+		simaai_memory_unmap(pool->slabs[i].memory);
+		simaai_memory_free(pool->slabs[i].memory);
+	}
+	pool->slab_count = 0;
+	pthread_mutex_destroy(&pool->lock);
+}
+
+void mem_pool_report(mem_pool *pool, FILE *out)
+{
+	size_t reserved = 0;
+	unsigned int i;
+
+	pthread_mutex_lock(&pool->lock);
+	for (i = 0; i < pool->slab_count; i++)
+		reserved += pool->slabs[i].size;
+	fprintf(out, "Pool %s: %u slabs, 0x%zx bytes, slab alloc avg %.3fms max %.3fms, "
+			"%lu blocks avg %.2fus max %.2fus\n",
+			pool->name, pool->slab_count, reserved,
+			pool->reserve.count ? pool->reserve.total / 1e6 / pool->reserve.count : 0,
+			pool->reserve.max / 1e6, pool->alloc.count,
+			pool->alloc.count ? pool->alloc.total / 1e3 / pool->alloc.count : 0,
+			pool->alloc.max / 1e3);
+	pthread_mutex_unlock(&pool->lock);
+}
+
+static int whole_slab(mem_pool *pool, const mem_block *block)
+{
+	return block->offset == 0 && block->size == pool->slabs[block->slab].size;
+}
+
+void mem_block_flush(mem_pool *pool, const mem_block *block)
+{
+	if (!block->cached)
+		return;
+	if (whole_slab(pool, block))
+		simaai_memory_flush_cache(pool->slabs[block->slab].memory);
+	else
+		cache_clean_range(block->virt, block->size);
+}
+
+void mem_block_invalidate(mem_pool *pool, const mem_block *block)
+{
+	if (!block->cached)
+		return;
+	if (whole_slab(pool, block))
+		simaai_memory_invalidate_cache(pool->slabs[block->slab].memory);
+	else
+		cache_inval_range(block->virt, block->size);
+}
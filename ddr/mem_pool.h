@@ -0,0 +1,95 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Pooled allocator over simaai_memory_alloc_flags(). A pool reserves large
+ * mapped slabs of one target and cache mode up front and hands out aligned
+ * sub-buffers from them, so workers do not go to CMA on their own and
+ * nothing is left allocated once the pool is destroyed.
+ *
+ * Sub-buffers are carved with a bump pointer per slab. A slab is reused
+ * from the start once all of its blocks are freed, and the most recent
+ * block of a slab can be returned on its own, which covers the alloc all /
+ * free all pattern of the test tools.
+ */
+
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <simaai/simaai_memory.h>
+
+#define MEM_POOL_MAX_SLABS	64
+/* Default and minimum sub-buffer alignment, one cache line */
+#define MEM_POOL_ALIGN		64UL
+/* Largest slab simaai_memory_alloc_flags() can take */
+#define MEM_POOL_MAX_SLAB	0xfffff000UL
+
+typedef struct {
+	simaai_memory_t *memory;
+	unsigned char *virt;
+	unsigned long int phys;
+	size_t size;
+	size_t top;		/* Bump offset of the next block */
+	unsigned int live;	/* Blocks handed out and not freed */
+} mem_slab;
+
+typedef struct {
+	void *virt;
+	unsigned long int phys;
+	size_t size;
+	int cached;
+	int slab;		/* Index of the backing slab */
+	size_t offset;		/* Offset of the block in its slab */
+	size_t end;		/* Offset right after the block */
+} mem_block;
+
+/* Allocation latency in ns */
+typedef struct {
+	unsigned long int count;
+	unsigned long int total;
+	unsigned long int max;
+} mem_pool_latency;
+
+typedef struct {
+	pthread_mutex_t lock;
+	const char *name;
+	int target;
+	int flags;
+	size_t slab_size;
+	unsigned int slab_count;
+	mem_slab slabs[MEM_POOL_MAX_SLABS];
+	mem_pool_latency alloc;		/* mem_pool_alloc() */
+	mem_pool_latency reserve;	/* Slab allocation and mapping */
+} mem_pool;
+
+/*
+ * Reserve enough slabs of slab_size bytes to hold reserve bytes. Returns 0
+ * on success. More slabs are added on demand, up to MEM_POOL_MAX_SLABS.
+ */
+int mem_pool_init(mem_pool *pool, const char *name, int target, int flags,
+		  size_t slab_size, size_t reserve);
+
+/* align is a power of two, 0 for MEM_POOL_ALIGN. Returns 0 on success. */
+int mem_pool_alloc(mem_pool *pool, size_t size, size_t align, mem_block *block);
+
+void mem_pool_free(mem_pool *pool, mem_block *block);
+
+/* Unmaps and frees every slab, warns about blocks that were not freed */
+void mem_pool_destroy(mem_pool *pool);
+
+void mem_pool_report(mem_pool *pool, FILE *out);
+
+/*
+ * Cache maintenance of a block. A block spanning its whole slab goes
+ * through libsimaaimem, a smaller one is cleaned or invalidated by VA so
+ * neighbouring blocks are not touched. Uncached blocks need neither.
+ */
+void mem_block_flush(mem_pool *pool, const mem_block *block);
+void mem_block_invalidate(mem_pool *pool, const mem_block *block);
+
+#endif /* MEM_POOL_H */
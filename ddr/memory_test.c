@@ -1,25 +1,67 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
+#include <ctype.h>
+#include <getopt.h>
+#include <limits.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
 #include <simaai/simaai_memory.h>
 
+#include "cache_ops.h"
+#include "copy.h"
+#include "json_report.h"
+#include "mem_pool.h"
 
+#define PAGE_SIZE 4096
 #define MB (1024 * 1024)
 #define GB (1024 * 1024 * 1024)
 
+#define CACHE_LINE 64
+#define MAX_THREADS 8
+/* Polls of the handshake word before falling back to futex sleep */
+#define POOL_SPIN 20000
+
+typedef struct copy_pool copy_pool_t;
+
 typedef struct {
+    copy_pool_t *pool;
+    int index;
+    pthread_t thread;
+} pool_worker_t;
+
+/*
+ * Workers are created and pinned once and then woken for every copy by
+ * bumping generation. The caller copies chunk 0 itself and waits for
+ * pending to drop to zero. Both words spin briefly before sleeping on a
+ * futex, and the side that changes a word only makes the wake syscall when
+ * a waiter has gone to sleep on it, so a 1MB copy with busy workers does
+ * not pay for thread startup or a syscall.
+ */
+struct copy_pool {
     void *dest;
-    void *src;
-    size_t start;
+    const void *src;
     size_t size;
-    pthread_barrier_t *barrier;
-} thread_data_t;
+    int threads;
+    int stop;
+    cpu_set_t caller_cpus;
+    pool_worker_t workers[MAX_THREADS];
+    unsigned int generation __attribute__((aligned(CACHE_LINE)));
+    unsigned int generation_sleepers;
+    unsigned int pending __attribute__((aligned(CACHE_LINE)));
+    unsigned int pending_sleepers;
+};
 
-static inline void simaai_memcpy_inline(simaai_memory_t *dest, simaai_memory_t *src,  long unsigned int size){
-    register simaai_memory_t *r_dest asm("x0") = dest;
-    register simaai_memory_t *r_src asm("x1") = src;
+static inline void simaai_memcpy_inline(void *dest, const void *src, size_t size){
+#if defined(__aarch64__)
+    register void *r_dest asm("x0") = dest;
+    register const void *r_src asm("x1") = src;
     register size_t r_size asm("x2") = size;
     asm volatile("startr:SUBS %2, %2,#128\n\
                     LDP x4, x5, [%1, #0]\n\
@@ -44,8 +86,26 @@ static inline void simaai_memcpy_inline(simaai_memory_t *dest, simaai_memory_t *
                     : [dest] "r" (r_dest), [src] "r" (r_src), [size] "r" (r_size)
                     : "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11", "x12", "x13", "x14", "x15", "x16", "x17", "x18", "x19", "cc", "memory"
                 );
+#else
+    /* Host builds have no LDP/STP, fall back to libc */
+    memcpy(dest, src, size);
+#endif
 }
 
+static void libc_memcpy(void *dest, const void *src, size_t size) {
+    memcpy(dest, src, size);
+}
+
+static const char *test_names[] = {
+    [1] = "memcpy",
+    [2] = "LDP/STP",
+    [3] = "multithreaded memcpy",
+    [6] = "LDNP/STNP non-temporal",
+    [7] = "DC ZVA + NEON",
+    [8] = "NEON LD1/ST1 x4 + PRFM",
+    [9] = "cache maintenance",
+};
+
 void simaai_read(void *dest, const void *src, size_t size) {
     if (!dest || !src || size == 0) {
         fprintf(stderr, "simaai_read: Invalid arguments\n");
@@ -73,169 +133,839 @@ void simaai_write(void *dest, const void *src, size_t size) {
 }
 
 
-void *threaded_memcpy(void *arg) {
-    thread_data_t *data = (thread_data_t *)arg;
-    pthread_barrier_wait(data->barrier);
-    memcpy((char *)data->dest + data->start, (char *)data->src + data->start, data->size);
+static inline void cpu_relax(void) {
+#if defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#elif defined(__x86_64__) || defined(__i386__)
+    asm volatile("pause" ::: "memory");
+#endif
+}
+
+static void futex_wait(unsigned int *addr, unsigned int val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+/*
+ * Called after the word was changed. The sleeper count is raised before a
+ * waiter reads the word for the last time, and both sides are sequentially
+ * consistent, so either the waiter sees the new value or the waker sees it.
+ */
+static void futex_wake(unsigned int *addr, unsigned int *sleepers) {
+    if (__atomic_load_n(sleepers, __ATOMIC_SEQ_CST) != 0)
+        syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+static void wait_change(unsigned int *addr, unsigned int *sleepers, unsigned int old) {
+    unsigned int i;
+
+    for (i = 0; i < POOL_SPIN; i++) {
+        if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != old)
+            return;
+        cpu_relax();
+    }
+    __atomic_add_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(addr, __ATOMIC_SEQ_CST) == old)
+        futex_wait(addr, old);
+    __atomic_sub_fetch(sleepers, 1, __ATOMIC_RELAXED);
+}
+
+static void wait_zero(unsigned int *addr, unsigned int *sleepers) {
+    unsigned int i, val;
+
+    for (i = 0; i < POOL_SPIN; i++) {
+        if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) == 0)
+            return;
+        cpu_relax();
+    }
+    __atomic_add_fetch(sleepers, 1, __ATOMIC_SEQ_CST);
+    while ((val = __atomic_load_n(addr, __ATOMIC_SEQ_CST)) != 0)
+        futex_wait(addr, val);
+    __atomic_sub_fetch(sleepers, 1, __ATOMIC_RELAXED);
+}
+
+/* Chunks are cache-line multiples so no two threads write the same line */
+static void pool_copy_chunk(copy_pool_t *pool, int index) {
+    size_t chunk = (pool->size / pool->threads + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    size_t start = chunk * index;
+
+    if (start >= pool->size)
+        return;
+    if (chunk > pool->size - start)
+        chunk = pool->size - start;
+    memcpy((char *)pool->dest + start, (const char *)pool->src + start, chunk);
+}
+
+static void *pool_worker(void *arg) {
+    pool_worker_t *worker = (pool_worker_t *)arg;
+    copy_pool_t *pool = worker->pool;
+    unsigned int seen = 0;
+
+    for (;;) {
+        wait_change(&pool->generation, &pool->generation_sleepers, seen);
+        seen = __atomic_load_n(&pool->generation, __ATOMIC_ACQUIRE);
+        if (pool->stop)
+            break;
+        pool_copy_chunk(pool, worker->index);
+        if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST) == 0)
+            futex_wake(&pool->pending, &pool->pending_sleepers);
+    }
     return NULL;
 }
 
-void multithreaded_memcpy(void *dest, void *src, size_t size, int threads) {
-    pthread_t thread_ids[threads];
-    pthread_barrier_t barrier;
-    thread_data_t thread_data[threads];
-    size_t chunk_size = size / threads;
+static int pin_attr(pthread_attr_t *attr, int cpu) {
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
 
-    pthread_barrier_init(&barrier, NULL, threads);
+int copy_pool_create(copy_pool_t *pool, int threads) {
+    int cpus[MAX_THREADS], ncpus = 0;
+    pthread_attr_t attr;
+    cpu_set_t set;
+    int i, err;
 
-    for (int i = 0; i < threads; i++) {
-        thread_data[i].dest = dest;
-        thread_data[i].src = src;
-        thread_data[i].start = i * chunk_size;
-        thread_data[i].size = (i == threads - 1) ? (size - i * chunk_size) : chunk_size;
-        thread_data[i].barrier = &barrier;
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = threads;
 
-        pthread_create(&thread_ids[i], NULL, threaded_memcpy, &thread_data[i]);
+    //Take CPUs from the inherited mask, so taskset and cgroup limits are kept
+    err = pthread_getaffinity_np(pthread_self(), sizeof(pool->caller_cpus), &pool->caller_cpus);
+    if (err != 0) {
+        fprintf(stderr, "Failed to read the CPU affinity: %s\n", strerror(err));
+        pool->threads = 1;
+        return -1;
     }
+    for (i = 0; i < CPU_SETSIZE && ncpus < threads; i++)
+        if (CPU_ISSET(i, &pool->caller_cpus))
+            cpus[ncpus++] = i;
+    if (ncpus < threads)
+        fprintf(stderr, "WARN : %d copy threads share %d allowed CPUs\n", threads, ncpus);
 
-    for (int i = 0; i < threads; i++) {
-        pthread_join(thread_ids[i], NULL);
+    //The caller runs chunk 0 on the first allowed CPU, workers take the next ones
+    CPU_ZERO(&set);
+    CPU_SET(cpus[0], &set);
+    err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0)
+        fprintf(stderr, "WARN : Failed to pin the caller to CPU %d: %s\n", cpus[0], strerror(err));
+
+    for (i = 1; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        pthread_attr_init(&attr);
+        err = pin_attr(&attr, cpus[i % ncpus]);
+        if (err != 0)
+            fprintf(stderr, "WARN : Failed to pin copy worker %d to CPU %d: %s\n",
+                    i, cpus[i % ncpus], strerror(err));
+        err = pthread_create(&pool->workers[i].thread, &attr, pool_worker, &pool->workers[i]);
+        pthread_attr_destroy(&attr);
+        if (err != 0) {
+            fprintf(stderr, "Failed to create copy worker %d on CPU %d: %s\n",
+                    i, cpus[i % ncpus], strerror(err));
+            pool->threads = i;
+            return -1;
+        }
     }
-    
-    pthread_barrier_destroy(&barrier);
+    return 0;
 }
 
-void measure_time(size_t data_size, int test, int threads) {
+void copy_pool_destroy(copy_pool_t *pool) {
+    int i;
 
-    static int target = SIMAAI_MEM_TARGET_DMS0;
-    int i = 0;
+    pool->stop = 1;
+    __atomic_add_fetch(&pool->generation, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&pool->generation, &pool->generation_sleepers);
+    for (i = 1; i < pool->threads; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pthread_setaffinity_np(pthread_self(), sizeof(pool->caller_cpus), &pool->caller_cpus);
+}
+
+void multithreaded_memcpy(copy_pool_t *pool, void *dest, const void *src, size_t size) {
+    pool->dest = dest;
+    pool->src = src;
+    pool->size = size;
+    __atomic_store_n(&pool->pending, pool->threads - 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&pool->generation, 1, __ATOMIC_SEQ_CST);
+    futex_wake(&pool->generation, &pool->generation_sleepers);
+
+    pool_copy_chunk(pool, 0);
+    wait_zero(&pool->pending, &pool->pending_sleepers);
+}
+
+typedef enum {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+} output_format;
+
+typedef struct {
+    unsigned int warmup;          /* Iterations run before sampling starts */
+    unsigned int min_iterations;
+    unsigned int max_iterations;
+    double ci;                    /* Target 95% CI half-width of T2, relative to its mean */
+    output_format format;
+} bench_opts_t;
+
+/* Timings of one phase, in seconds */
+typedef struct {
+    double *samples;
+    unsigned int count;
+    double mean;
+    double m2;                    /* Running sum of squared deviations (Welford) */
+    double min;
+    double max;
+} sample_set_t;
+
+typedef struct {
+    double median;
+    double stddev;
+    double p90;
+    double p99;
+    double p999;
+} sample_stats_t;
+
+static const char *phase_names[3] = { "T1", "T2", "T3" };
+
+static double elapsed(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static int samples_init(sample_set_t *set, unsigned int capacity) {
+    memset(set, 0, sizeof(*set));
+    set->samples = malloc(capacity * sizeof(double));
+    set->min = 1e9;
+    return set->samples ? 0 : -1;
+}
+
+static void samples_add(sample_set_t *set, double value) {
+    double delta = value - set->mean;
+
+    set->samples[set->count++] = value;
+    set->mean += delta / set->count;
+    set->m2 += delta * (value - set->mean);
+    set->min = (set->min > value) ? value : set->min;
+    set->max = (set->max < value) ? value : set->max;
+}
+
+static double samples_stddev(const sample_set_t *set) {
+    return set->count > 1 ? sqrt(set->m2 / (set->count - 1)) : 0;
+}
+
+/* 95% confidence interval half-width relative to the mean */
+static double samples_ci(const sample_set_t *set) {
+    if (set->count < 2 || set->mean <= 0)
+        return 1e9;
+    return 1.96 * samples_stddev(set) / sqrt(set->count) / set->mean;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double sorted_percentile(const sample_set_t *set, double fraction) {
+    unsigned int index = (unsigned int)(fraction * (set->count - 1) + 0.5);
+
+    return set->samples[index];
+}
 
-    simaai_memory_t *input_buffer = simaai_memory_alloc_flags(data_size, target, SIMAAI_MEM_FLAG_CACHED);
-    if (!input_buffer) {
-        perror("Input buffer allocation failed");
+/* Sorts the samples in place, call once sampling is done */
+static void samples_summary(sample_set_t *set, sample_stats_t *stats) {
+    qsort(set->samples, set->count, sizeof(double), cmp_double);
+    stats->median = sorted_percentile(set, 0.5);
+    stats->p90 = sorted_percentile(set, 0.9);
+    stats->p99 = sorted_percentile(set, 0.99);
+    stats->p999 = sorted_percentile(set, 0.999);
+    stats->stddev = samples_stddev(set);
+}
+
+static double gbps(size_t size, double seconds) {
+    return seconds > 0 ? (double)size / seconds / 1e9 : 0;
+}
+
+static void print_csv_header(void) {
+    printf("test,kernel,threads,size,iterations,phase,min,max,mean,median,stddev,p90,p99,bandwidth_gbps,maintenance\n");
+}
+
+static void report(int test, int threads, size_t data_size, sample_set_t *sets,
+                   unsigned int warmup, const char *maintenance, output_format format) {
+    sample_stats_t stats[3];
+    double total = sets[0].mean + sets[1].mean + sets[2].mean;
+    int p;
+
+    for (p = 0; p < 3; p++)
+        samples_summary(&sets[p], &stats[p]);
+
+    if (format == OUTPUT_CSV) {
+        for (p = 0; p < 3; p++)
+            printf("%d,%s,%d,%zu,%u,%s,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f,%.3f,%s\n",
+                   test, test_names[test], threads, data_size, sets[p].count, phase_names[p],
+                   sets[p].min, sets[p].max, sets[p].mean, stats[p].median, stats[p].stddev,
+                   stats[p].p90, stats[p].p99, gbps(data_size, sets[p].mean), maintenance);
         return;
     }
-    void *input_addr = simaai_memory_map(input_buffer);
-    if (!input_addr) {
-        perror("Input buffer mapping failed");
-        simaai_memory_free(input_buffer);
+
+    if (format == OUTPUT_JSON) {
+        json_record r;
+
+        json_begin(&r, stdout, "memory_test", test_names[test]);
+        json_object_begin(&r, "params");
+        json_int(&r, "test", test);
+        json_int(&r, "threads", threads);
+        json_uint(&r, "size", data_size);
+        json_uint(&r, "warmup", warmup);
+        json_string(&r, "maintenance", maintenance);
+        json_object_end(&r);
+        json_uint(&r, "iterations", sets[1].count);
+        /* Phases in seconds, T2 is the copy itself */
+        for (p = 0; p < 3; p++) {
+            json_object_begin(&r, phase_names[p]);
+            json_double(&r, "min", sets[p].min);
+            json_double(&r, "max", sets[p].max);
+            json_double(&r, "mean", sets[p].mean);
+            json_double(&r, "median", stats[p].median);
+            json_double(&r, "stddev", stats[p].stddev);
+            json_double(&r, "p90", stats[p].p90);
+            json_double(&r, "p99", stats[p].p99);
+            json_object_end(&r);
+        }
+        json_double(&r, "duration_s", sets[1].mean * sets[1].count);
+        json_uint(&r, "bytes", data_size * sets[1].count);
+        json_double(&r, "bandwidth_gbps", gbps(data_size, sets[1].mean));
+        json_double(&r, "total_gbps", gbps(data_size, total));
+        json_object_begin(&r, "latency_ns");
+        json_double(&r, "p50", stats[1].median * 1e9);
+        json_double(&r, "p99", stats[1].p99 * 1e9);
+        json_double(&r, "p999", stats[1].p999 * 1e9);
+        json_double(&r, "max", sets[1].max * 1e9);
+        json_object_end(&r);
+        json_string(&r, "status", "pass");
+        json_end(&r);
         return;
     }
 
-    simaai_memory_t *output_buffer = simaai_memory_alloc_flags(data_size, target, SIMAAI_MEM_FLAG_CACHED);
-    if (!output_buffer) {
-        perror("Output memory allocation failed");
-        return;
+    printf("Test No: %d (%s)\n", test, test_names[test]);
+    if (test == 3)
+        printf("Threads: %d\n", threads);
+    printf("Size: %zu bytes, iterations: %u (+%u warm-up), cache maintenance: %s\n",
+           data_size, sets[1].count, warmup, maintenance);
+    for (p = 0; p < 3; p++)
+        printf("%s: max - %fs, min - %fs, average - %fs, median - %fs, stddev - %fs, p90 - %fs, p99 - %fs\n",
+               phase_names[p], sets[p].max, sets[p].min, sets[p].mean, stats[p].median,
+               stats[p].stddev, stats[p].p90, stats[p].p99);
+    printf("T2 bandwidth: %.2fGB/s\n", gbps(data_size, sets[1].mean));
+    printf("T1+T2+T3: average - %fs, %.2fGB/s\n", total, gbps(data_size, total));
+}
+
+/*
+ * Input and output come from the buffer pool, which holds a slab of exactly
+ * data_size bytes for each of them, so T1 and T3 always time the whole
+ * buffer operations of libsimaaimem.
+ */
+int measure_time(size_t data_size, int test, int threads, const bench_opts_t *opts, mem_pool *buffers) {
+
+    mem_block input, output;
+    sample_set_t sets[3];
+    unsigned int i = 0;
+    int p, ret = -1;
+
+    if (mem_pool_alloc(buffers, data_size, PAGE_SIZE, &input) != 0) {
+        fprintf(stderr, "Input buffer allocation failed\n");
+        return -1;
     }
-    void *output_addr = simaai_memory_map(output_buffer);
-    if (!output_addr) {
-        perror("Output memory mapping failed");
-        simaai_memory_free(output_buffer);
-        return;
+    if (mem_pool_alloc(buffers, data_size, PAGE_SIZE, &output) != 0) {
+        fprintf(stderr, "Output memory allocation failed\n");
+        mem_pool_free(buffers, &input);
+        return -1;
     }
+    void *input_addr = input.virt;
+    void *output_addr = output.virt;
 
     memset(input_addr, 0xAA, data_size);
-    double t1_max = 0, t2_max = 0, t3_max = 0;
-    double t1_min = 10, t2_min = 10, t3_min = 10;
-    double t1_sum = 0, t2_sum = 0, t3_sum = 0;
+    for (p = 0; p < 3; p++)
+        sets[p].samples = NULL;
 
     void (*memcpy_func)(void *, const void *, size_t) = NULL;
+    copy_pool_t pool;
 
     if (test == 1) {
-        memcpy_func = memcpy;
+        memcpy_func = libc_memcpy;
     } else if (test == 2) {
         memcpy_func = simaai_memcpy_inline;
+    } else if (test == 6) {
+        memcpy_func = copy_nt;
+    } else if (test == 7) {
+        memcpy_func = copy_zva;
+    } else if (test == 8) {
+        memcpy_func = copy_neon_prefetch;
     } else if (test == 4) {
         simaai_read(output_addr, input_addr, data_size);
+        ret = 0;
         goto cleanup;
     } else if (test == 5) {
         simaai_write(output_addr, input_addr, data_size);
+        ret = 0;
         goto cleanup;
-    } else if (test != 3) {
+    } else if (test == 3) {
+        if (copy_pool_create(&pool, threads) != 0) {
+            copy_pool_destroy(&pool);
+            goto cleanup;
+        }
+    } else {
         fprintf(stderr, "Invalid test number\n");
-        simaai_memory_unmap(input_buffer);
-        simaai_memory_unmap(output_buffer);
-        simaai_memory_free(input_buffer);
-        simaai_memory_free(output_buffer);
-        return;
+        goto cleanup;
     }
 
-    for( i = 0; i < 1000; i++){
+    for (p = 0; p < 3; p++) {
+        if (samples_init(&sets[p], opts->max_iterations) != 0) {
+            perror("Sample allocation failed");
+            goto done;
+        }
+    }
 
+    //Warm-up iterations are timed like the others but discarded
+    for (i = 0; i < opts->warmup + opts->max_iterations; i++) {
         struct timespec start, end;
+        double t[3];
+
         clock_gettime(CLOCK_MONOTONIC, &start);
-        simaai_memory_invalidate_cache(input_buffer);
+        mem_block_invalidate(buffers, &input);
         clock_gettime(CLOCK_MONOTONIC, &end);
+        t[0] = elapsed(&start, &end);
 
-        double invalidate_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-        t1_sum += invalidate_time;
-        t1_max = (t1_max < invalidate_time) ? invalidate_time : t1_max;
-        t1_min = (t1_min > invalidate_time) ? invalidate_time : t1_min;
-        
         clock_gettime(CLOCK_MONOTONIC, &start);
         if (test == 3) {
-            multithreaded_memcpy(output_addr, input_addr, data_size, threads);
+            multithreaded_memcpy(&pool, output_addr, input_addr, data_size);
         } else {
             memcpy_func(output_addr, input_addr, data_size);
         }
         clock_gettime(CLOCK_MONOTONIC, &end);
-        
-        double memcpy_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-        t2_sum += memcpy_time;
-        t2_max = (t2_max < memcpy_time) ? memcpy_time : t2_max;
-        t2_min = (t2_min > memcpy_time) ? memcpy_time : t2_min;
+        t[1] = elapsed(&start, &end);
 
         clock_gettime(CLOCK_MONOTONIC, &start);
-        simaai_memory_flush_cache(output_buffer);
+        mem_block_flush(buffers, &output);
         clock_gettime(CLOCK_MONOTONIC, &end);
+        t[2] = elapsed(&start, &end);
+
+        if (i < opts->warmup)
+            continue;
+        for (p = 0; p < 3; p++)
+            samples_add(&sets[p], t[p]);
+
+        //Stop once the copy time is known precisely enough
+        if (sets[1].count >= opts->min_iterations && samples_ci(&sets[1]) <= opts->ci)
+            break;
+    }
+
+    report(test, threads, data_size, sets, opts->warmup,
+           (input.size == buffers->slab_size) ? "whole buffer" : "by VA", opts->format);
+    ret = 0;
+
+done:
+    if (test == 3)
+        copy_pool_destroy(&pool);
+
+cleanup:
+    for (p = 0; p < 3; p++)
+        free(sets[p].samples);
+    mem_pool_free(buffers, &output);
+    mem_pool_free(buffers, &input);
+    return ret;
+}
+
+typedef enum {
+    DIRTY_NONE,
+    DIRTY_PARTIAL,
+    DIRTY_FULL,
+    DIRTY_NUM,
+} dirty_state;
+
+typedef enum {
+    CMO_CLEAN_VA,
+    CMO_CIVAC_VA,
+    CMO_FLUSH_FULL,
+    CMO_INVAL_FULL,
+    CMO_NUM,
+} cmo_op;
+
+#define MAX_RANGES 64
+
+static const char *dirty_names[DIRTY_NUM] = { "clean", "partial", "dirty" };
+static const char *cmo_names[CMO_NUM] = { "clean_va", "civac_va", "flush_full", "inval_full" };
+
+/*
+ * Bring the first range bytes into the cache. Every line is written for
+ * DIRTY_FULL, every 4th line for DIRTY_PARTIAL and none for DIRTY_NONE,
+ * the remaining lines are only read, so they are resident but clean.
+ */
+static void cache_prepare(volatile unsigned char *addr, size_t range, size_t line, dirty_state state) {
+    size_t i, n;
+
+    for (i = 0, n = 0; i < range; i += line, n++) {
+        if (state == DIRTY_FULL || (state == DIRTY_PARTIAL && (n & 3) == 0))
+            addr[i] = (unsigned char)n;
+        else
+            (void)addr[i];
+    }
+}
+
+static void cache_op(simaai_memory_t *buffer, void *addr, size_t range, cmo_op op) {
+    switch (op) {
+    case CMO_CLEAN_VA:
+        cache_clean_range(addr, range);
+        break;
+    case CMO_CIVAC_VA:
+        cache_clean_inval_range(addr, range);
+        break;
+    case CMO_FLUSH_FULL:
+        simaai_memory_flush_cache(buffer);
+        break;
+    case CMO_INVAL_FULL:
+        simaai_memory_invalidate_cache(buffer);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Smallest range where the by-VA walk costs at least as much as the full operation */
+static size_t cache_crossover(double (*median)[CMO_NUM], const size_t *ranges, int count,
+                              cmo_op va, cmo_op full) {
+    int r;
+
+    for (r = 0; r < count; r++)
+        if (median[r][va] >= median[r][full])
+            return ranges[r];
+    return 0;
+}
+
+/*
+ * Cost of cache maintenance on the first range bytes of a cached buffer
+ * against the same operation on the whole buffer through libsimaaimem,
+ * for clean, partially dirty and fully dirty lines.
+ */
+static void json_cache_point(size_t buffer_size, const char *state, size_t range, const char *op,
+                             const sample_set_t *set, const sample_stats_t *stats) {
+    json_record r;
+
+    json_begin(&r, stdout, "memory_test", test_names[9]);
+    json_object_begin(&r, "params");
+    json_int(&r, "test", 9);
+    json_uint(&r, "buffer", buffer_size);
+    json_string(&r, "state", state);
+    json_uint(&r, "range", range);
+    json_string(&r, "op", op);
+    json_object_end(&r);
+    json_uint(&r, "iterations", set->count);
+    json_double(&r, "duration_s", set->mean * set->count);
+    json_uint(&r, "bytes", range * set->count);
+    json_object_begin(&r, "latency_ns");
+    json_double(&r, "p50", stats->median * 1e9);
+    json_double(&r, "p99", stats->p99 * 1e9);
+    json_double(&r, "p999", stats->p999 * 1e9);
+    json_double(&r, "max", set->max * 1e9);
+    json_object_end(&r);
+    json_double(&r, "min_latency_ns", set->min * 1e9);
+    json_double(&r, "mean_latency_ns", set->mean * 1e9);
+    json_string(&r, "status", "pass");
+    json_end(&r);
+}
+
+int measure_cache(size_t buffer_size, size_t start, size_t end, double factor, const bench_opts_t *opts) {
+    static int target = SIMAAI_MEM_TARGET_DMS0;
+    double median[DIRTY_NUM][MAX_RANGES][CMO_NUM];
+    size_t ranges[MAX_RANGES];
+    size_t line = cache_line_size();
+    sample_set_t set;
+    sample_stats_t stats;
+    int count = 0, r, s, o, ret = 0;
+    unsigned int i;
+
+    for (size_t range = start; range <= end && count < MAX_RANGES; count++) {
+        size_t next = (size_t)(range * factor);
+
+        ranges[count] = range;
+        range = (next > range) ? next : range + 1;
+    }
+
+    simaai_memory_t *buffer = simaai_memory_alloc_flags(buffer_size, target, SIMAAI_MEM_FLAG_CACHED);
+    if (!buffer) {
+        perror("Buffer allocation failed");
+        return -1;
+    }
+    unsigned char *addr = simaai_memory_map(buffer);
+    if (!addr) {
+        perror("Buffer mapping failed");
+        simaai_memory_free(buffer);
+        return -1;
+    }
+    if (samples_init(&set, opts->max_iterations) != 0) {
+        perror("Sample allocation failed");
+        simaai_memory_unmap(buffer);
+        simaai_memory_free(buffer);
+        return -1;
+    }
+
+    memset(addr, 0, buffer_size);
+    simaai_memory_flush_cache(buffer);
+
+    if (opts->format == OUTPUT_CSV)
+        printf("test,kernel,buffer,state,range,op,iterations,min,mean,median,p99\n");
+
+    for (s = 0; s < DIRTY_NUM; s++) {
+        for (r = 0; r < count; r++) {
+            for (o = 0; o < CMO_NUM; o++) {
+                free(set.samples);
+                if (samples_init(&set, opts->max_iterations) != 0) {
+                    perror("Sample allocation failed");
+                    ret = -1;
+                    goto out;
+                }
+
+                for (i = 0; i < opts->warmup + opts->max_iterations; i++) {
+                    struct timespec t0, t1;
+
+                    cache_prepare(addr, ranges[r], line, s);
+                    clock_gettime(CLOCK_MONOTONIC, &t0);
+                    cache_op(buffer, addr, ranges[r], o);
+                    clock_gettime(CLOCK_MONOTONIC, &t1);
 
-        double flush_time = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
-        t3_sum += flush_time;
-        t3_max = (t3_max < flush_time) ? flush_time : t3_max;
-        t3_min = (t3_min > flush_time) ? flush_time : t3_min;
+                    if (i < opts->warmup)
+                        continue;
+                    samples_add(&set, elapsed(&t0, &t1));
+                    if (set.count >= opts->min_iterations && samples_ci(&set) <= opts->ci)
+                        break;
+                }
+
+                samples_summary(&set, &stats);
+                median[s][r][o] = stats.median;
+
+                if (opts->format == OUTPUT_CSV)
+                    printf("9,%s,%zu,%s,%zu,%s,%u,%.9f,%.9f,%.9f,%.9f\n", test_names[9], buffer_size,
+                           dirty_names[s], ranges[r], cmo_names[o], set.count, set.min, set.mean,
+                           stats.median, stats.p99);
+                else if (opts->format == OUTPUT_JSON)
+                    json_cache_point(buffer_size, dirty_names[s], ranges[r], cmo_names[o], &set, &stats);
+            }
+        }
     }
-    printf("Test No: %d\n", test);
-    printf("T1: max - %fs, min - %fs, average - %fs\n", t1_max, t1_min, t1_sum/1000);
-    printf("T2: max - %fs, min - %fs, average - %fs\n", t2_max, t2_min, t2_sum/1000);
-    printf("T3: max - %fs, min - %fs, average - %fs\n", t3_max, t3_min, t3_sum/1000);
-    goto cleanup;
 
-    cleanup:
-        simaai_memory_unmap(input_buffer);
-        simaai_memory_unmap(output_buffer);
-        simaai_memory_free(input_buffer);
-        simaai_memory_free(output_buffer);
+    if (opts->format == OUTPUT_TEXT) {
+        printf("Test No: 9 (%s)\n", test_names[9]);
+        printf("Buffer: %zu bytes, cache line: %zu bytes, median us per operation\n", buffer_size, line);
+        printf("%-8s %12s %10s %10s %10s %10s\n", "State", "Range", cmo_names[0], cmo_names[1],
+               cmo_names[2], cmo_names[3]);
+        for (s = 0; s < DIRTY_NUM; s++)
+            for (r = 0; r < count; r++)
+                printf("%-8s %12zu %10.2f %10.2f %10.2f %10.2f\n", dirty_names[s], ranges[r],
+                       median[s][r][0] * 1e6, median[s][r][1] * 1e6,
+                       median[s][r][2] * 1e6, median[s][r][3] * 1e6);
+    }
+
+    for (s = 0; s < DIRTY_NUM; s++) {
+        size_t flush = cache_crossover(median[s], ranges, count, CMO_CLEAN_VA, CMO_FLUSH_FULL);
+        size_t inval = cache_crossover(median[s], ranges, count, CMO_CIVAC_VA, CMO_INVAL_FULL);
+
+        if (opts->format == OUTPUT_JSON) {
+            json_record rec;
+
+            json_begin(&rec, stdout, "memory_test", "cache crossover");
+            json_object_begin(&rec, "params");
+            json_int(&rec, "test", 9);
+            json_uint(&rec, "buffer", buffer_size);
+            json_string(&rec, "state", dirty_names[s]);
+            json_object_end(&rec);
+            json_uint(&rec, "flush_crossover", flush);
+            json_uint(&rec, "invalidate_crossover", inval);
+            json_end(&rec);
+        } else if (opts->format == OUTPUT_TEXT) {
+            printf("Crossover (%s): ", dirty_names[s]);
+            if (flush)
+                printf("full flush wins from %zu bytes, ", flush);
+            else
+                printf("by-VA clean always wins, ");
+            if (inval)
+                printf("full invalidate wins from %zu bytes\n", inval);
+            else
+                printf("by-VA invalidate always wins\n");
+        }
+    }
+
+out:
+    free(set.samples);
+    simaai_memory_unmap(buffer);
+    simaai_memory_free(buffer);
+    return ret;
 }
 
+/* Byte count with an optional K, M or G suffix and an optional B, e.g. 4K, 1MB, 3000 */
 size_t get_size_from_string(const char *size_str) {
-    if (strcmp(size_str, "1MB") == 0) return 1 * MB;
-    if (strcmp(size_str, "2MB") == 0) return 2 * MB;
-    if (strcmp(size_str, "4MB") == 0) return 4 * MB;
-    if (strcmp(size_str, "8MB") == 0) return 8 * MB;
-    if (strcmp(size_str, "256MB") == 0) return 256 * MB;
-    if (strcmp(size_str, "512MB") == 0) return 512 * MB;
-    if (strcmp(size_str, "1GB") == 0) return 1 * GB;
+    unsigned long long size;
+    char *end;
+
+    size = strtoull(size_str, &end, 10);
+    if (end == size_str || size == 0)
+        return 0;
+
+    switch (toupper((unsigned char)*end)) {
+    case 'G':
+        size <<= 10;
+        /* fall through */
+    case 'M':
+        size <<= 10;
+        /* fall through */
+    case 'K':
+        size <<= 10;
+        end++;
+        break;
+    }
+    if (toupper((unsigned char)*end) == 'B')
+        end++;
+    if (*end != '\0' || size > UINT_MAX)
+        return 0;
+
+    return size;
+}
+
+/* START:END[:FACTOR], sizes grow geometrically by FACTOR (default 2) */
+static int parse_sweep(const char *str, size_t *start, size_t *end, double *factor) {
+    char buf[64];
+    char *sep, *sep2;
+
+    snprintf(buf, sizeof(buf), "%s", str);
+    sep = strchr(buf, ':');
+    if (!sep)
+        return -1;
+    *sep++ = '\0';
+    sep2 = strchr(sep, ':');
+    if (sep2)
+        *sep2++ = '\0';
+
+    *start = get_size_from_string(buf);
+    *end = get_size_from_string(sep);
+    *factor = sep2 ? strtod(sep2, NULL) : 2.0;
+
+    if (*start == 0 || *end < *start || *factor <= 1.0)
+        return -1;
     return 0;
 }
 
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [OPTIONS] <test_number> <size> [threads]\n", name);
+    fprintf(stderr, "       %s [OPTIONS] --sweep START:END[:FACTOR] <test_number> [threads]\n", name);
+    fprintf(stderr, "Tests: 1 memcpy, 2 LDP/STP, 3 multithreaded memcpy, 4 read, 5 write,\n"
+                    "       6 LDNP/STNP, 7 DC ZVA + NEON, 8 NEON LD1/ST1 + PRFM,\n"
+                    "       9 cache maintenance cost by range size, <size> is the buffer size\n"
+                    "         and ranges double from 4K, or follow --sweep up to END\n");
+    fprintf(stderr, "Sizes are in bytes with an optional K, M or G suffix, e.g. 4K, 1MB, 1536M\n");
+    fprintf(stderr, "Options:\n"
+                    "  -s, --sweep=START:END[:FACTOR]  Run every size from START to END, default FACTOR: 2\n"
+                    "  -w, --warmup=N                  Discarded iterations per size, default: 10\n"
+                    "  -n, --iterations=N              Run exactly N iterations instead of adapting\n"
+                    "  -m, --max-iterations=N          Iteration limit when adapting, default: 1000\n"
+                    "  -c, --ci=PERCENT                Stop when the 95%% CI of T2 is within PERCENT\n"
+                    "                                  of its mean, default: 1\n"
+                    "  -o, --output=text|csv|json      Output format, default: text\n"
+                    "  -h, --help                      Show this help\n");
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 3) {
-        fprintf(stderr, "Usage: %s <test_number> <size> [threads]\n", argv[0]);
+    static const struct option long_options[] = {
+        { "sweep",          required_argument, NULL, 's' },
+        { "warmup",         required_argument, NULL, 'w' },
+        { "iterations",     required_argument, NULL, 'n' },
+        { "max-iterations", required_argument, NULL, 'm' },
+        { "ci",             required_argument, NULL, 'c' },
+        { "output",         required_argument, NULL, 'o' },
+        { "help",           no_argument,       NULL, 'h' },
+        { NULL,             0,                 NULL, 0 },
+    };
+    bench_opts_t opts = {
+        .warmup = 10,
+        .min_iterations = 30,
+        .max_iterations = 1000,
+        .ci = 0.01,
+        .format = OUTPUT_TEXT,
+    };
+    size_t sweep_start = 0, sweep_end = 0, data_size;
+    double sweep_factor = 2.0;
+    int sweep = 0, fixed = 0, opt, pos;
+
+    while ((opt = getopt_long(argc, argv, "s:w:n:m:c:o:h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 's':
+            if (parse_sweep(optarg, &sweep_start, &sweep_end, &sweep_factor) != 0) {
+                fprintf(stderr, "Invalid sweep %s, use START:END[:FACTOR], e.g. 4K:512M:2\n", optarg);
+                return EXIT_FAILURE;
+            }
+            sweep = 1;
+            break;
+        case 'w':
+            opts.warmup = strtoul(optarg, NULL, 0);
+            break;
+        case 'n':
+            fixed = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            opts.max_iterations = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            opts.ci = strtod(optarg, NULL) / 100;
+            break;
+        case 'o':
+            if (strcmp(optarg, "text") == 0) {
+                opts.format = OUTPUT_TEXT;
+            } else if (strcmp(optarg, "csv") == 0) {
+                opts.format = OUTPUT_CSV;
+            } else if (strcmp(optarg, "json") == 0) {
+                opts.format = OUTPUT_JSON;
+            } else {
+                fprintf(stderr, "Invalid output format %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (fixed > 0)
+        opts.min_iterations = opts.max_iterations = fixed;
+    if (opts.max_iterations == 0) {
+        fprintf(stderr, "Iteration count must be positive\n");
         return EXIT_FAILURE;
     }
+    if (opts.min_iterations > opts.max_iterations)
+        opts.min_iterations = opts.max_iterations;
 
-    int test = atoi(argv[1]);
-    if (test < 1 || test > 5) {
-        fprintf(stderr, "Invalid test number. Use 1, 2, or 3.\n");
+    pos = optind;
+    if (argc - pos < (sweep ? 1 : 2)) {
+        usage(argv[0]);
         return EXIT_FAILURE;
     }
 
-    size_t data_size = get_size_from_string(argv[2]);
-    if (data_size == 0) {
-        fprintf(stderr, "Invalid size specified. Use one of the following: 1MB, 2MB, 4MB, 8MB, 256MB, 512MB, 1GB\n");
+    int test = atoi(argv[pos++]);
+    if (test < 1 || test > 9) {
+        fprintf(stderr, "Invalid test number. Use 1 to 9.\n");
         return EXIT_FAILURE;
     }
 
+    if (sweep) {
+        if (test == 4 || test == 5) {
+            fprintf(stderr, "Tests 4 and 5 run once and cannot be swept.\n");
+            return EXIT_FAILURE;
+        }
+        data_size = sweep_start;
+    } else {
+        data_size = get_size_from_string(argv[pos++]);
+        if (data_size == 0) {
+            fprintf(stderr, "Invalid size specified. Use a byte count with an optional K, M or G suffix, up to 4G - 1\n");
+            return EXIT_FAILURE;
+        }
+    }
+
     if ((test == 4 || test == 5) && !(data_size == 1 * 1024 * 1024 || data_size == 4 * 1024 * 1024 ||
                                       data_size == 8 * 1024 * 1024 || data_size == 1 * 1024 * 1024 * 1024)) {
         fprintf(stderr, "Invalid size for test 4 or test 5. Allowed sizes are: 1MB, 4MB, 8MB, or 1GB.\n");
@@ -244,23 +974,53 @@ int main(int argc, char *argv[]) {
 
     int threads = 0;
     if (test == 3) {
-        if (argc < 4) {
+        if (pos >= argc) {
             fprintf(stderr, "Test 3 requires a thread count. Usage: %s 3 <size> <threads>\n", argv[0]);
             return EXIT_FAILURE;
         }
-        threads = atoi(argv[3]);
+        threads = atoi(argv[pos]);
         if (threads != 1 && threads != 2 && threads != 4 && threads != 8) {
             fprintf(stderr, "Invalid thread count specified. Use 1, 2, 4, or 8.\n");
             return EXIT_FAILURE;
         }
     }
 
-    if (test >= 1 && test <= 5) {
-        int thread_count = (test == 3) ? threads : 0;
-        measure_time(data_size, test, thread_count);
-    } else {
-        printf("Invalid option\n");
+    if (test == 9) {
+        if (!sweep) {
+            sweep_start = 4096;
+            sweep_end = data_size;
+        }
+        return measure_cache(sweep_end, sweep_start, sweep_end, sweep_factor, &opts) == 0 ?
+               EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    int ret = EXIT_SUCCESS;
+
+    if (opts.format == OUTPUT_CSV)
+        print_csv_header();
+
+    if (!sweep)
+        sweep_end = data_size;
+
+    //A pool per size, every buffer is a whole slab so the maintenance method never changes
+    while (data_size <= sweep_end) {
+        size_t next = (size_t)(data_size * sweep_factor);
+        mem_pool buffers;
+
+        if (mem_pool_init(&buffers, "dms0", SIMAAI_MEM_TARGET_DMS0, SIMAAI_MEM_FLAG_CACHED,
+                          data_size, 2 * data_size) != 0) {
+            ret = EXIT_FAILURE;
+            break;
+        }
+        if (measure_time(data_size, test, threads, &opts, &buffers) != 0)
+            ret = EXIT_FAILURE;
+        if (opts.format == OUTPUT_TEXT)
+            mem_pool_report(&buffers, stderr);
+        mem_pool_destroy(&buffers);
+        if (ret != EXIT_SUCCESS || !sweep)
+            break;
+        data_size = (next > data_size) ? next : data_size + 1;
     }
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+    return ret;
+}
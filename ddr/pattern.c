@@ -0,0 +1,448 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PATTERN_USE_NEON 1
+#endif
+
+#include "pattern.h"
+
+typedef enum {
+	GEN_CONST,
+	GEN_ADDRESS,
+	GEN_RANDOM,
+} gen_kind;
+
+/*
+ * Expected data generator for one block. Random data is produced by two
+ * xorshift64 lanes, even words come from lane 0 and odd words from lane 1,
+ * which maps directly onto one 128-bit NEON register per pair of words.
+ */
+typedef struct {
+	gen_kind kind;
+	unsigned int phase;
+	unsigned long int value;
+	unsigned long int next;
+	unsigned long int lane[2];
+} gen_state;
+
+static inline unsigned long int splitmix64(unsigned long int x)
+{
+	x += 0x9E3779B97F4A7C15UL;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9UL;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBUL;
+	return x ^ (x >> 31);
+}
+
+static inline unsigned long int xorshift64(unsigned long int x)
+{
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	return x;
+}
+
+unsigned long int modify_byte(unsigned long int value, int index, unsigned char new_byte)
+{
+	unsigned long int mask = 0xFFUL << (index * 8);
+	value &= ~mask;
+	value |= ((unsigned long int)new_byte << (index * 8));
+	return value;
+}
+
+unsigned int pattern_passes(pattern_type type)
+{
+	switch (type) {
+	case PATTERN_WALKING_1:
+	case PATTERN_WALKING_0:
+		return 8;
+	default:
+		return 1;
+	}
+}
+
+unsigned long int pattern_value(const pattern_desc *desc, unsigned int pass)
+{
+	switch (desc->type) {
+	case PATTERN_55:
+		return 0x5555555555555555;
+	case PATTERN_AA:
+		return 0xAAAAAAAAAAAAAAAA;
+	case PATTERN_5A:
+		return 0x5A5A5A5A5A5A5A5A;
+	case PATTERN_A5:
+		return 0xA5A5A5A5A5A5A5A5;
+	case PATTERN_55AA:
+		return 0x55AA55AA55AA55AA;
+	case PATTERN_AA55:
+		return 0xAA55AA55AA55AA55;
+	case PATTERN_WALKING_1:
+		/* Every byte walks its set bit from bit 7 down to bit 0 */
+		return 0x0101010101010101UL << (7 - pass);
+	case PATTERN_WALKING_0:
+		return ~(0x0101010101010101UL << (7 - pass));
+	case PATTERN_CHECK_ADJACENT:
+	case PATTERN_USER:
+	default:
+		return desc->value;
+	}
+}
+
+static void gen_init(gen_state *g, const pattern_desc *desc, unsigned int pass,
+		     unsigned long int offset, int verify)
+{
+	unsigned long int block = offset / PATTERN_BLOCK_SIZE;
+
+	memset(g, 0, sizeof(*g));
+	switch (desc->type) {
+	case PATTERN_ADDRESS:
+		g->kind = GEN_ADDRESS;
+		g->next = desc->base + offset;
+		break;
+	case PATTERN_RANDOM:
+		g->kind = GEN_RANDOM;
+		/* xorshift state must never be zero */
+		g->lane[0] = splitmix64(desc->seed + 2 * block) | 1;
+		g->lane[1] = splitmix64(desc->seed + 2 * block + 1) | 1;
+		break;
+	default:
+		g->kind = GEN_CONST;
+		g->value = pattern_value(desc, pass);
+		if (verify && desc->type == PATTERN_CHECK_ADJACENT)
+			g->value = modify_byte(g->value, PATTERN_ADJACENT_INDEX,
+					       PATTERN_ADJACENT_BYTE);
+		break;
+	}
+}
+
+static inline unsigned long int gen_next(gen_state *g)
+{
+	unsigned long int v;
+
+	switch (g->kind) {
+	case GEN_ADDRESS:
+		v = g->next;
+		g->next += sizeof(v);
+		return v;
+	case GEN_RANDOM:
+		if (g->phase == 0) {
+			g->lane[0] = xorshift64(g->lane[0]);
+			g->lane[1] = xorshift64(g->lane[1]);
+		}
+		v = g->lane[g->phase];
+		g->phase ^= 1;
+		return v;
+	default:
+		return g->value;
+	}
+}
+
+static inline void record_mismatch(pattern_result *result, unsigned long int offset,
+				   unsigned long int expected, unsigned long int actual)
+{
+	if (result->mismatches++ == 0) {
+		result->first_offset = offset;
+		result->first_expected = expected;
+		result->first_actual = actual;
+	}
+	if (result->on_error)
+		result->on_error(result->ctx, offset, expected, actual);
+}
+
+#ifdef PATTERN_USE_NEON
+
+static inline uint64x2_t vxorshift64(uint64x2_t s)
+{
+	s = veorq_u64(s, vshlq_n_u64(s, 13));
+	s = veorq_u64(s, vshrq_n_u64(s, 7));
+	s = veorq_u64(s, vshlq_n_u64(s, 17));
+	return s;
+}
+
+static inline uint64x2_t vpair(unsigned long int lo, unsigned long int hi)
+{
+	return vcombine_u64(vcreate_u64(lo), vcreate_u64(hi));
+}
+
+/*
+ * Fill the 64-byte aligned part of a block with 128-bit stores, four
+ * registers per iteration. Returns the number of words written.
+ */
+static size_t fill_bulk(unsigned long int *p, size_t words, gen_state *g)
+{
+	size_t i, n = words & ~7UL;
+	uint64_t *d = (uint64_t *)p;
+
+	switch (g->kind) {
+	case GEN_CONST: {
+		uint64x2_t v = vdupq_n_u64(g->value);
+
+		for (i = 0; i < n; i += 8) {
+			vst1q_u64(d + i, v);
+			vst1q_u64(d + i + 2, v);
+			vst1q_u64(d + i + 4, v);
+			vst1q_u64(d + i + 6, v);
+		}
+		break;
+	}
+	case GEN_ADDRESS: {
+		uint64x2_t v0 = vpair(g->next, g->next + 8);
+		const uint64x2_t inc = vdupq_n_u64(16);
+		const uint64x2_t inc2 = vdupq_n_u64(32);
+		uint64x2_t v1 = vaddq_u64(v0, inc);
+
+		for (i = 0; i < n; i += 8) {
+			vst1q_u64(d + i, v0);
+			vst1q_u64(d + i + 2, v1);
+			v0 = vaddq_u64(v0, inc2);
+			v1 = vaddq_u64(v1, inc2);
+			vst1q_u64(d + i + 4, v0);
+			vst1q_u64(d + i + 6, v1);
+			v0 = vaddq_u64(v0, inc2);
+			v1 = vaddq_u64(v1, inc2);
+		}
+		g->next += n * sizeof(*p);
+		break;
+	}
+	case GEN_RANDOM: {
+		uint64x2_t s = vpair(g->lane[0], g->lane[1]);
+
+		for (i = 0; i < n; i += 8) {
+			s = vxorshift64(s);
+			vst1q_u64(d + i, s);
+			s = vxorshift64(s);
+			vst1q_u64(d + i + 2, s);
+			s = vxorshift64(s);
+			vst1q_u64(d + i + 4, s);
+			s = vxorshift64(s);
+			vst1q_u64(d + i + 6, s);
+		}
+		g->lane[0] = vgetq_lane_u64(s, 0);
+		g->lane[1] = vgetq_lane_u64(s, 1);
+		break;
+	}
+	}
+
+	return n;
+}
+
+/* Slow path for a 64-byte chunk that is known to contain a mismatch */
+static void verify_chunk(const uint64_t *p, const uint64x2_t e[4], unsigned long int offset,
+			 pattern_result *result)
+{
+	uint64_t expected[8];
+	int i;
+
+	for (i = 0; i < 4; i++)
+		vst1q_u64(expected + 2 * i, e[i]);
+	for (i = 0; i < 8; i++)
+		if (p[i] != expected[i])
+			record_mismatch(result, offset + i * sizeof(*p), expected[i], p[i]);
+}
+
+/*
+ * Compare the 64-byte aligned part of a block four 128-bit registers at a
+ * time. Only chunks whose XOR difference is non-zero take the slow path.
+ */
+static size_t verify_bulk(const unsigned long int *p, size_t words, gen_state *g,
+			  unsigned long int offset, pattern_result *result)
+{
+	size_t i, n = words & ~7UL;
+	const uint64_t *s = (const uint64_t *)p;
+	uint64x2_t e[4], d;
+	uint64x2_t v0 = vdupq_n_u64(0), v1 = v0, st = v0;
+	const uint64x2_t inc2 = vdupq_n_u64(32);
+
+	if (g->kind == GEN_CONST) {
+		e[0] = e[1] = e[2] = e[3] = vdupq_n_u64(g->value);
+	} else if (g->kind == GEN_ADDRESS) {
+		v0 = vpair(g->next, g->next + 8);
+		v1 = vaddq_u64(v0, vdupq_n_u64(16));
+	} else {
+		st = vpair(g->lane[0], g->lane[1]);
+	}
+
+	for (i = 0; i < n; i += 8) {
+		if (g->kind == GEN_ADDRESS) {
+			e[0] = v0;
+			e[1] = v1;
+			e[2] = v0 = vaddq_u64(v0, inc2);
+			e[3] = v1 = vaddq_u64(v1, inc2);
+			v0 = vaddq_u64(v0, inc2);
+			v1 = vaddq_u64(v1, inc2);
+		} else if (g->kind == GEN_RANDOM) {
+			e[0] = st = vxorshift64(st);
+			e[1] = st = vxorshift64(st);
+			e[2] = st = vxorshift64(st);
+			e[3] = st = vxorshift64(st);
+		}
+		d = vorrq_u64(veorq_u64(vld1q_u64(s + i), e[0]),
+			      veorq_u64(vld1q_u64(s + i + 2), e[1]));
+		d = vorrq_u64(d, veorq_u64(vld1q_u64(s + i + 4), e[2]));
+		d = vorrq_u64(d, veorq_u64(vld1q_u64(s + i + 6), e[3]));
+		if (vmaxvq_u32(vreinterpretq_u32_u64(d)))
+			verify_chunk(s + i, e, offset + i * sizeof(*p), result);
+	}
+
+	if (g->kind == GEN_ADDRESS) {
+		g->next += n * sizeof(*p);
+	} else if (g->kind == GEN_RANDOM) {
+		g->lane[0] = vgetq_lane_u64(st, 0);
+		g->lane[1] = vgetq_lane_u64(st, 1);
+	}
+
+	return n;
+}
+
+#else /* !PATTERN_USE_NEON */
+
+/* Portable fallback for host builds, the compiler is free to vectorize it */
+static size_t fill_bulk(unsigned long int *p, size_t words, gen_state *g)
+{
+	size_t i;
+
+	switch (g->kind) {
+	case GEN_CONST:
+		for (i = 0; i < words; i++)
+			p[i] = g->value;
+		break;
+	case GEN_ADDRESS:
+		for (i = 0; i < words; i++)
+			p[i] = g->next + i * sizeof(*p);
+		g->next += words * sizeof(*p);
+		break;
+	case GEN_RANDOM:
+		for (i = 0; i + 1 < words; i += 2) {
+			g->lane[0] = xorshift64(g->lane[0]);
+			g->lane[1] = xorshift64(g->lane[1]);
+			p[i] = g->lane[0];
+			p[i + 1] = g->lane[1];
+		}
+		return i;
+	}
+
+	return words;
+}
+
+static size_t verify_bulk(const unsigned long int *p, size_t words, gen_state *g,
+			  unsigned long int offset, pattern_result *result)
+{
+	unsigned long int diff = 0, expected;
+	size_t i, n = words & ~7UL;
+	gen_state start = *g;
+
+	/* Cheap OR-reduction first, rescan word by word only on mismatch */
+	for (i = 0; i < n; i++)
+		diff |= p[i] ^ gen_next(g);
+
+	if (diff) {
+		*g = start;
+		for (i = 0; i < n; i++) {
+			expected = gen_next(g);
+			if (p[i] != expected)
+				record_mismatch(result, offset + i * sizeof(*p), expected, p[i]);
+		}
+	}
+
+	return n;
+}
+
+#endif /* PATTERN_USE_NEON */
+
+static inline size_t block_count(size_t size)
+{
+	return (size + PATTERN_BLOCK_SIZE - 1) / PATTERN_BLOCK_SIZE;
+}
+
+static inline size_t gcd(size_t a, size_t b)
+{
+	while (b) {
+		size_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * Blocks are visited as (i * step + start) % count with step coprime to
+ * count, which is a full permutation that costs no memory.
+ */
+static void block_order(const pattern_desc *desc, size_t count, size_t *step, size_t *start)
+{
+	unsigned long int r = splitmix64(desc->seed ^ count);
+
+	*step = 1;
+	*start = 0;
+	if (!desc->random_order || count < 2)
+		return;
+
+	*start = r % count;
+	*step = (r >> 32) % count;
+	if (*step == 0)
+		*step = 1;
+	while (gcd(*step, count) != 1)
+		(*step)++;
+}
+
+void pattern_fill(void *addr, size_t size, const pattern_desc *desc, unsigned int pass)
+{
+	unsigned long int *words = (unsigned long int *)addr;
+	size_t count = block_count(size), step, start, i, j, n, blk;
+	unsigned long int offset;
+	gen_state g;
+
+	block_order(desc, count, &step, &start);
+
+	for (i = 0; i < count; i++) {
+		blk = (i * step + start) % count;
+		offset = blk * PATTERN_BLOCK_SIZE;
+		n = ((size - offset) < PATTERN_BLOCK_SIZE ? (size - offset) : PATTERN_BLOCK_SIZE) /
+			sizeof(*words);
+
+		gen_init(&g, desc, pass, offset, 0);
+		j = fill_bulk(words + offset / sizeof(*words), n, &g);
+		for (; j < n; j++)
+			words[offset / sizeof(*words) + j] = gen_next(&g);
+	}
+
+	/* Narrow byte writes must not disturb the neighbouring bytes */
+	if (desc->type == PATTERN_CHECK_ADJACENT) {
+		volatile unsigned char *bytes = (volatile unsigned char *)addr;
+
+		for (i = 0; i < size / sizeof(*words); i++)
+			bytes[i * sizeof(*words) + PATTERN_ADJACENT_INDEX] = PATTERN_ADJACENT_BYTE;
+	}
+}
+
+unsigned long int pattern_verify(const void *addr, size_t size, const pattern_desc *desc,
+				 unsigned int pass, pattern_result *result)
+{
+	const unsigned long int *words = (const unsigned long int *)addr;
+	unsigned long int before = result->mismatches, offset, expected, actual;
+	size_t count = block_count(size), i, j, n;
+	gen_state g;
+
+	for (i = 0; i < count; i++) {
+		offset = i * PATTERN_BLOCK_SIZE;
+		n = ((size - offset) < PATTERN_BLOCK_SIZE ? (size - offset) : PATTERN_BLOCK_SIZE) /
+			sizeof(*words);
+
+		gen_init(&g, desc, pass, offset, 1);
+		j = verify_bulk(words + offset / sizeof(*words), n, &g, offset, result);
+		for (; j < n; j++) {
+			expected = gen_next(&g);
+			actual = words[offset / sizeof(*words) + j];
+			if (actual != expected)
+				record_mismatch(result, offset + j * sizeof(*words), expected, actual);
+		}
+	}
+
+	return result->mismatches - before;
+}
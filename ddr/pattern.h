@@ -0,0 +1,79 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stddef.h>
+
+typedef enum {
+	PATTERN_55,
+	PATTERN_AA,
+	PATTERN_5A,
+	PATTERN_A5,
+	PATTERN_55AA,
+	PATTERN_AA55,
+	PATTERN_RANDOM,
+	PATTERN_ADDRESS,
+	PATTERN_USER,
+	PATTERN_WALKING_1,
+	PATTERN_WALKING_0,
+	PATTERN_CHECK_ADJACENT,
+	PATTERN_ROWHAMMER,		/* Constant value, rows hammered by hammer.c */
+	PATTERN_NUM,
+} pattern_type;
+
+/*
+ * Buffers are filled and verified in blocks of this size. Random data is
+ * seeded per block, so blocks can be visited in any order and the expected
+ * value of any word can be regenerated without replaying the whole buffer.
+ */
+#define PATTERN_BLOCK_SIZE	4096UL
+
+/* Byte overwritten in every word by PATTERN_CHECK_ADJACENT */
+#define PATTERN_ADJACENT_INDEX	3
+#define PATTERN_ADJACENT_BYTE	0x55
+
+typedef struct {
+	pattern_type type;
+	unsigned long int value;	/* PATTERN_USER / PATTERN_CHECK_ADJACENT / PATTERN_ROWHAMMER */
+	unsigned long int seed;		/* PATTERN_RANDOM */
+	unsigned long int base;		/* PATTERN_ADDRESS, value of the first word */
+	int random_order;		/* Visit blocks in pseudo-random order */
+} pattern_desc;
+
+/* Called for every mismatched word, offset is in bytes from the buffer start */
+typedef void (*pattern_error_fn)(void *ctx, unsigned long int offset,
+				 unsigned long int expected, unsigned long int actual);
+
+typedef struct {
+	unsigned long int mismatches;	/* Number of mismatched 8-byte words */
+	unsigned long int first_offset;	/* Byte offset of the first mismatch */
+	unsigned long int first_expected;
+	unsigned long int first_actual;
+	pattern_error_fn on_error;	/* Optional */
+	void *ctx;
+} pattern_result;
+
+unsigned long int modify_byte(unsigned long int value, int index, unsigned char new_byte);
+
+/* Number of fill/verify passes a pattern needs, e.g. 8 for walking bits */
+unsigned int pattern_passes(pattern_type type);
+
+/* 8-byte value written by a constant pattern on a given pass */
+unsigned long int pattern_value(const pattern_desc *desc, unsigned int pass);
+
+/* Fill every 8-byte word of the buffer, size is in bytes */
+void pattern_fill(void *addr, size_t size, const pattern_desc *desc, unsigned int pass);
+
+/*
+ * Compare the buffer against the pattern written by pattern_fill() for the
+ * same pass. Mismatches are accumulated into result, which the caller
+ * zeroes. Returns the number of mismatched words found by this call.
+ */
+unsigned long int pattern_verify(const void *addr, size_t size, const pattern_desc *desc,
+				 unsigned int pass, pattern_result *result);
+
+#endif /* PATTERN_H */
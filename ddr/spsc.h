@@ -0,0 +1,85 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Bounded lock-free single-producer single-consumer queue of unsigned ints.
+ *
+ * The producer owns tail and the consumer owns head, each on its own cache
+ * line next to a cached copy of the other side's index, so the shared lines
+ * only move between cores when the cached copy runs out.
+ */
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stdlib.h>
+
+#define SPSC_LINE	64
+
+typedef struct {
+	unsigned int *slots;
+	unsigned int mask;
+
+	unsigned int tail __attribute__((aligned(SPSC_LINE)));	/* Producer */
+	unsigned int head_cache;
+
+	unsigned int head __attribute__((aligned(SPSC_LINE)));	/* Consumer */
+	unsigned int tail_cache;
+} __attribute__((aligned(SPSC_LINE))) spsc_queue;
+
+/* Capacity is rounded up to a power of two */
+static inline int spsc_init(spsc_queue *q, unsigned int capacity)
+{
+	unsigned int size = 1;
+
+	while (size < capacity)
+		size <<= 1;
+
+	q->slots = (unsigned int *)calloc(size, sizeof(*q->slots));
+	if (!q->slots)
+		return -1;
+	q->mask = size - 1;
+	q->head = q->tail = 0;
+	q->head_cache = q->tail_cache = 0;
+	return 0;
+}
+
+static inline void spsc_destroy(spsc_queue *q)
+{
+	free(q->slots);
+	q->slots = NULL;
+}
+
+/* Returns 0 on success, -1 if the queue is full */
+static inline int spsc_push(spsc_queue *q, unsigned int value)
+{
+	unsigned int tail = q->tail;
+
+	if (tail - q->head_cache > q->mask) {
+		q->head_cache = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+		if (tail - q->head_cache > q->mask)
+			return -1;
+	}
+	q->slots[tail & q->mask] = value;
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+/* Returns 0 on success, -1 if the queue is empty */
+static inline int spsc_pop(spsc_queue *q, unsigned int *value)
+{
+	unsigned int head = q->head;
+
+	if (head == q->tail_cache) {
+		q->tail_cache = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+		if (head == q->tail_cache)
+			return -1;
+	}
+	*value = q->slots[head & q->mask];
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+#endif /* SPSC_H */
@@ -1,5 +1,6 @@
 MMC_DEVICE=""
 SD_CARD="/dev/mmcblk1"
+BENCH=${BENCH:-$(dirname "$0")/storage_bench}
 
 insertions=0
 removals=0
@@ -22,24 +23,27 @@ esac
 
 test1() {
   local partition="${MMC_DEVICE}p6"
-  dd if=/dev/urandom of="${partition}" bs=1M count=1024 
-  sync
-  dd if="${partition}" of=/tmp/readback.bin bs=1M count=1024
+  "$BENCH" -d "${partition}" -s 1G -m seq-write,seq-read
 }
 
 test2() {
   local partition="${MMC_DEVICE}p6"
-  exec_time=$( { time dd if=/dev/urandom of="${partition}" bs=1M count=1024 status=none; } 2>&1 | awk '/real/ {print $2}' )
-  elapsed_time=$(echo "$exec_time" | awk -F'[ms]' '{print $1 * 60 + $2}')
-  file_size_mb=1024
-  throughput=$(echo "$file_size_mb $elapsed_time" | awk '{print $1 / $2}')
+  local seq rand
+  seq=$("$BENCH" -d "${partition}" -s 1G -m seq-write,seq-read -q 1,32) || { echo "$seq"; return 1; }
+  rand=$("$BENCH" -d "${partition}" -s 1G -m rand-write,rand-read -q 1,32 -t 10 -V) || { echo "$rand"; return 1; }
+  echo "$seq"
+  echo "$rand" | tail -n +2
+  throughput=$(echo "$seq" | awk '$1 == "seq-write" && $4 > max {max = $4} END {print max}')
   echo "Throughput: $throughput MB/s"
 }
 
 test3() {
-  dd if=/dev/urandom of="${MMC_DEVICE}" bs=1M count=1024 
-  sync
-  dd if="${MMC_DEVICE}" of=/tmp/readback.bin bs=1M count=1024
+  "$BENCH" -d "${MMC_DEVICE}" -s 1G -m seq-write,seq-read
+}
+
+test5() {
+  local partition="${MMC_DEVICE}p6"
+  "$BENCH" -d "${partition}" -s 1G -m seq-write -P all -q 8 -t 30
 }
 
 test4() {
@@ -74,7 +78,8 @@ echo "1) Test 1: Memory Operations"
 echo "2) Test 2: Throughput Measurement"
 echo "3) Test 3: Whole memory read and write"
 echo "4) Test 4: sd_card insertion and connection back"
-read -p "Enter your choice (1 or 2 or 3 or 4): " test_choice
+echo "5) Test 5: Mixed, logging and read under write workloads"
+read -p "Enter your choice (1 or 2 or 3 or 4 or 5): " test_choice
 
 case $test_choice in
   1)
@@ -89,6 +94,9 @@ case $test_choice in
   4)
     test4
     ;;
+  5)
+    test5
+    ;;
   *)
     echo "Invalid choice. Exiting."
     exit 1
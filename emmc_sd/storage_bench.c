@@ -0,0 +1,595 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * eMMC/SD block device benchmark. The device is opened with O_DIRECT so
+ * neither the page cache nor a data generator is measured. The basic tests
+ * sweep block sizes and queue depths over sequential and random reads and
+ * writes, the workload profiles of storage_profile.h mix them the way the
+ * board does. The I/O engines and data verification are in storage_io.h.
+ */
+
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <linux/fs.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hist_json.h"
+#include "histogram.h"
+#include "json_report.h"
+#include "storage_io.h"
+#include "storage_profile.h"
+
+#define LIST_MAX		8
+#define DEFAULT_SEED		0x5eed5eedUL
+#define DEFAULT_PROFILE_TIME	10
+#define DEFAULT_READ_PERCENT	70
+#define DEFAULT_FSYNC_EVERY	16
+#define DEFAULT_PROBE_INTERVAL	10000	/* us */
+#define DEFAULT_STALL		100	/* ms */
+
+typedef enum {
+	MODE_SEQ_WRITE,
+	MODE_SEQ_READ,
+	MODE_RAND_WRITE,
+	MODE_RAND_READ,
+	MODE_NUM
+} bench_mode;
+
+static const char *mode_names[MODE_NUM] = {
+	"seq-write",
+	"seq-read",
+	"rand-write",
+	"rand-read",
+};
+
+typedef struct {
+	const char *path;
+	unsigned long int offset;
+	unsigned long int size;
+	unsigned long int block_sizes[LIST_MAX];
+	unsigned int nblock_sizes;
+	unsigned int depths[LIST_MAX];
+	unsigned int ndepths;
+	unsigned int modes;		/* Bit per bench_mode */
+	unsigned int profiles;		/* Bit per storage_profile */
+	double time;			/* Seconds per test, 0 for one pass over the region */
+	unsigned long int seed;
+	io_engine engine;
+	int direct;
+	int create;			/* Create or extend a file target to the region */
+	int verify;			/* -1 verifies reads once a write covered the region */
+	unsigned int read_percent;
+	unsigned long int fsync_every;
+	unsigned long int probe_interval;
+	unsigned long int stall;	/* ms */
+	int json;
+} bench_args;
+
+static void report_header(void)
+{
+	printf("%-10s %7s %5s %10s %10s %9s %9s %9s %9s %7s %7s\n", "Test", "Block", "Depth",
+	       "MB/s", "IOPS", "p50 us", "p99 us", "p999 us", "max us", "Errors", "Corrupt");
+}
+
+/* Errors of a test are those of its I/O and of the final fdatasync() */
+static unsigned long int test_errors(const io_job *j)
+{
+	return j->total[OP_READ].errors + j->total[OP_WRITE].errors + j->total[OP_SYNC].errors;
+}
+
+static void report_test(bench_mode mode, const io_job *j)
+{
+	const io_stats *s = &j->total[j->write_percent ? OP_WRITE : OP_READ];
+	double mbps = j->seconds > 0 ? s->bytes / j->seconds / 1e6 : 0;
+	double iops = j->seconds > 0 ? s->ios / j->seconds : 0;
+
+	printf("%-10s %6luK %5u %10.1f %10.0f %9.1f %9.1f %9.1f %9.1f %7lu %7lu\n",
+	       mode_names[mode], j->bs / 1024, j->depth, mbps, iops,
+	       hist_percentile(&s->latency, 0.50) / 1e3, hist_percentile(&s->latency, 0.99) / 1e3,
+	       hist_percentile(&s->latency, 0.999) / 1e3, s->latency.max / 1e3, test_errors(j),
+	       s->corrupt);
+}
+
+static void json_test(const bench_args *args, bench_mode mode, const io_job *j)
+{
+	const io_stats *s = &j->total[j->write_percent ? OP_WRITE : OP_READ];
+	json_record r;
+
+	json_begin(&r, stdout, "storage_bench", mode_names[mode]);
+	json_object_begin(&r, "params");
+	json_string(&r, "device", args->path);
+	json_uint(&r, "offset", args->offset);
+	json_uint(&r, "size", args->size);
+	json_uint(&r, "block_size", j->bs);
+	json_uint(&r, "queue_depth", j->depth);
+	json_string(&r, "engine", engine_names[j->engine]);
+	json_bool(&r, "direct", args->direct);
+	json_bool(&r, "verify", j->verify);
+	json_object_end(&r);
+	json_double(&r, "duration_s", j->seconds);
+	json_uint(&r, "bytes", s->bytes);
+	json_double(&r, "bandwidth_gbps", j->seconds > 0 ? s->bytes / j->seconds / 1e9 : 0);
+	json_double(&r, "iops", j->seconds > 0 ? s->ios / j->seconds : 0);
+	json_latency(&r, "latency_ns", &s->latency);
+	json_uint(&r, "corrupt", s->corrupt);
+	json_uint(&r, "errors", test_errors(j) + s->corrupt);
+	json_string(&r, "status", test_errors(j) || s->corrupt || !s->ios ? "fail" : "pass");
+	json_end(&r);
+}
+
+/* Byte count with an optional K, M or G suffix and an optional B, e.g. 4K, 1MB, 3000 */
+static unsigned long int parse_size(const char *str)
+{
+	unsigned long int size;
+	char *end;
+
+	size = strtoul(str, &end, 0);
+	if (end == str)
+		return 0;
+	switch (toupper((unsigned char)*end)) {
+	case 'G':
+		size <<= 10;
+		/* fall through */
+	case 'M':
+		size <<= 10;
+		/* fall through */
+	case 'K':
+		size <<= 10;
+		end++;
+		break;
+	}
+	if (toupper((unsigned char)*end) == 'B')
+		end++;
+	return *end ? 0 : size;
+}
+
+/* Comma separated list of sizes, returns the count or -1 */
+static int parse_size_list(char *str, unsigned long int *list)
+{
+	char *item;
+	int n = 0;
+
+	for (item = strtok(str, ","); item; item = strtok(NULL, ",")) {
+		if (n == LIST_MAX)
+			return -1;
+		list[n] = parse_size(item);
+		if (!list[n])
+			return -1;
+		n++;
+	}
+	return n;
+}
+
+/* Comma separated names out of names, or all, into a bit mask */
+static int parse_names(char *str, const char **names, int count, unsigned int *mask)
+{
+	char *item;
+	int i;
+
+	*mask = 0;
+	for (item = strtok(str, ","); item; item = strtok(NULL, ",")) {
+		if (!strcmp(item, "all")) {
+			*mask |= (1U << count) - 1;
+			continue;
+		}
+		for (i = 0; i < count; i++)
+			if (!strcmp(item, names[i]))
+				break;
+		if (i == count)
+			return -1;
+		*mask |= 1U << i;
+	}
+	return 0;
+}
+
+/* Open the target, a missing file is only created with --create */
+static int open_target(const bench_args *args)
+{
+	int flags = O_RDWR | O_CLOEXEC, fd;
+
+	if (args->create)
+		flags |= O_CREAT;
+	if (args->direct)
+		flags |= O_DIRECT;
+	fd = open(args->path, flags, 0644);
+	if (fd < 0 && args->direct && errno == EINVAL)
+		fprintf(stderr, "%s does not support O_DIRECT, give --buffered to go through the page cache\n",
+			args->path);
+	else if (fd < 0)
+		fprintf(stderr, "Cannot open %s: %s\n", args->path, strerror(errno));
+	return fd;
+}
+
+static unsigned long int target_size(int fd)
+{
+	unsigned long long size = 0;
+	struct stat st;
+
+	if (fstat(fd, &st) != 0)
+		return 0;
+	if (S_ISBLK(st.st_mode))
+		return ioctl(fd, BLKGETSIZE64, &size) == 0 ? size : 0;
+	return st.st_size;
+}
+
+static int target_is_file(int fd)
+{
+	struct stat st;
+
+	return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [OPTIONS] -d DEVICE\n"
+		"Measures sequential and random read/write bandwidth, IOPS and latency of a block\n"
+		"device or file with O_DIRECT and verifies the data read back. Write tests\n"
+		"overwrite the region under test.\n"
+		"Sizes are in bytes with an optional K, M or G suffix.\n"
+		"\n"
+		"  -d, --device=PATH         Block device, partition, loop device or file\n"
+		"  -o, --offset=SIZE         Start of the region under test, default: 0\n"
+		"  -s, --size=SIZE           Size of the region, default: up to the end of DEVICE\n"
+		"  -C, --create              Create DEVICE as a file if it is missing and extend a\n"
+		"                            file shorter than the region\n"
+		"  -m, --mode=LIST           Tests to run in order, any of seq-write, seq-read,\n"
+		"                            rand-write, rand-read or all, default: all unless\n"
+		"                            --profile is given\n"
+		"  -P, --profile=LIST        Workload profiles to run after the tests, any of\n"
+		"                            mixed, log, probe or all. They report every second.\n"
+		"  -b, --block-size=LIST     Block sizes, multiples of 4K, default: 1M for the\n"
+		"                            sequential and 4K for the random tests. Profiles use\n"
+		"                            the first one, for the writer of probe.\n"
+		"  -q, --queue-depth=LIST    I/Os in flight, up to %d, default: 1\n"
+		"  -t, --time=SECONDS        Length of every test, default: one pass over the\n"
+		"                            region, %d seconds for the profiles\n"
+		"  -e, --engine=NAME         io_uring or psync (one pread/pwrite thread per queue\n"
+		"                            slot), default: io_uring, psync if it is not available\n"
+		"  -B, --buffered            Go through the page cache instead of O_DIRECT\n"
+		"  -V, --verify              Verify reads even without a write test in this run,\n"
+		"                            for a region written earlier with the same seed\n"
+		"  -N, --no-verify           Do not verify reads\n"
+		"  -S, --seed=N              Seed of the data pattern, default: 0x%lx\n"
+		"  -R, --read-percent=N      Reads of the mixed profile, default: %d\n"
+		"  -F, --fsync-every=N       Writes between fdatasync() of the log profile,\n"
+		"                            default: %d\n"
+		"  -I, --probe-interval=US   Time between the reads of the probe profile,\n"
+		"                            default: %d\n"
+		"  -L, --stall=MS            Latency that marks a second as a stall, default: %d\n"
+		"  -j, --json                Print one JSON record per test\n"
+		"  -h, --help                Display this help and exit\n",
+		name, MAX_DEPTH, DEFAULT_PROFILE_TIME, DEFAULT_SEED, DEFAULT_READ_PERCENT,
+		DEFAULT_FSYNC_EVERY, DEFAULT_PROBE_INTERVAL, DEFAULT_STALL);
+}
+
+static int run_modes(bench_args *args, const data_pool *pool, int fd, int *written)
+{
+	unsigned int b, d, mode, failed = 0;
+	unsigned long int bs;
+	io_job j;
+
+	if (!args->json)
+		report_header();
+	for (mode = 0; mode < MODE_NUM; mode++) {
+		if (!(args->modes & (1U << mode)))
+			continue;
+		for (b = 0; b < (args->nblock_sizes ? args->nblock_sizes : 1); b++) {
+			if (args->nblock_sizes)
+				bs = args->block_sizes[b];
+			else
+				bs = (mode == MODE_RAND_WRITE || mode == MODE_RAND_READ) ? 4096 : 1 << 20;
+			if (bs > args->size) {
+				fprintf(stderr, "Block size %lu is larger than the region\n", bs);
+				failed++;
+				continue;
+			}
+			for (d = 0; d < args->ndepths; d++) {
+				memset(&j, 0, sizeof(j));
+				j.pool = pool;
+				j.fd = fd;
+				j.engine = args->engine;
+				j.offset = args->offset;
+				j.bs = bs;
+				j.nblocks = args->size / bs;
+				j.depth = args->depths[d] ? args->depths[d] : 1;
+				j.random = mode == MODE_RAND_WRITE || mode == MODE_RAND_READ;
+				j.write_percent = (mode == MODE_SEQ_WRITE || mode == MODE_RAND_WRITE) ? 100 : 0;
+				j.verify = args->verify < 0 ? *written : args->verify;
+				j.time = args->time;
+				j.seed = args->seed ^ ((uint64_t)mode << 56);
+
+				if (io_job_run(&j) != 0) {
+					fprintf(stderr, "%s failed to run\n", mode_names[mode]);
+					io_job_free(&j);
+					failed++;
+					continue;
+				}
+				//Reads can be verified once a full sequential pass wrote the region
+				if (mode == MODE_SEQ_WRITE && j.total[OP_WRITE].ios >= j.nblocks &&
+				    !test_errors(&j))
+					*written = 1;
+				if (test_errors(&j) || j.total[j.write_percent ? OP_WRITE : OP_READ].corrupt ||
+				    !j.total[j.write_percent ? OP_WRITE : OP_READ].ios)
+					failed++;
+				if (args->json)
+					json_test(args, mode, &j);
+				else
+					report_test(mode, &j);
+				io_job_free(&j);
+			}
+		}
+	}
+	return failed;
+}
+
+static int run_profiles(bench_args *args, const data_pool *pool, int fd, int written)
+{
+	profile_config cfg = {
+		.pool = pool,
+		.fd = fd,
+		.engine = args->engine,
+		.path = args->path,
+		.offset = args->offset,
+		.size = args->size,
+		.block_size = args->nblock_sizes ? args->block_sizes[0] : 0,
+		.time = args->time > 0 ? args->time : DEFAULT_PROFILE_TIME,
+		.read_percent = args->read_percent,
+		.fsync_every = args->fsync_every,
+		.probe_interval = args->probe_interval,
+		.stall = args->stall * 1000000UL,
+		.seed = args->seed,
+		.verify = args->verify < 0 ? written : args->verify,
+	};
+	unsigned int profile, d, op, failed = 0;
+	profile_result res;
+
+	for (profile = 0; profile < PROFILE_NUM; profile++) {
+		if (!(args->profiles & (1U << profile)))
+			continue;
+		for (d = 0; d < args->ndepths; d++) {
+			cfg.depth = args->depths[d] ? args->depths[d] : 1;
+			if (!args->json)
+				printf("\n%s profile\n", profile_names[profile]);
+			if (profile_run(profile, &cfg, &res, args->json ? NULL : stdout) != 0) {
+				fprintf(stderr, "%s profile failed to run\n", profile_names[profile]);
+				failed++;
+			}
+			for (op = 0; op < OP_NUM; op++)
+				if (res.ops[op].errors || res.ops[op].corrupt)
+					failed++;
+			if (args->json)
+				profile_json(&cfg, &res, stdout);
+			else
+				profile_report(&cfg, &res, stdout);
+			profile_result_free(&res);
+		}
+	}
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct option long_options[] = {
+		{ "device",         required_argument, NULL, 'd' },
+		{ "offset",         required_argument, NULL, 'o' },
+		{ "size",           required_argument, NULL, 's' },
+		{ "create",         no_argument,       NULL, 'C' },
+		{ "mode",           required_argument, NULL, 'm' },
+		{ "profile",        required_argument, NULL, 'P' },
+		{ "block-size",     required_argument, NULL, 'b' },
+		{ "queue-depth",    required_argument, NULL, 'q' },
+		{ "time",           required_argument, NULL, 't' },
+		{ "engine",         required_argument, NULL, 'e' },
+		{ "buffered",       no_argument,       NULL, 'B' },
+		{ "verify",         no_argument,       NULL, 'V' },
+		{ "no-verify",      no_argument,       NULL, 'N' },
+		{ "seed",           required_argument, NULL, 'S' },
+		{ "read-percent",   required_argument, NULL, 'R' },
+		{ "fsync-every",    required_argument, NULL, 'F' },
+		{ "probe-interval", required_argument, NULL, 'I' },
+		{ "stall",          required_argument, NULL, 'L' },
+		{ "json",           no_argument,       NULL, 'j' },
+		{ "help",           no_argument,       NULL, 'h' },
+		{ NULL,             0,                 NULL, 0 },
+	};
+	bench_args args = {
+		.modes = (1U << MODE_NUM) - 1,
+		.depths = { 1 },
+		.ndepths = 1,
+		.seed = DEFAULT_SEED,
+		.engine = ENGINE_URING,
+		.direct = 1,
+		.verify = -1,
+		.read_percent = DEFAULT_READ_PERCENT,
+		.fsync_every = DEFAULT_FSYNC_EVERY,
+		.probe_interval = DEFAULT_PROBE_INTERVAL,
+		.stall = DEFAULT_STALL,
+	};
+	unsigned long int depths[LIST_MAX], size;
+	unsigned int b, d, failed = 0;
+	int opt, n, fd, engine_set = 0, modes_set = 0, written = 0;
+	data_pool pool;
+
+	while ((opt = getopt_long(argc, argv, "d:o:s:Cm:P:b:q:t:e:BVNS:R:F:I:L:jh", long_options,
+				  NULL)) != -1) {
+		switch (opt) {
+		case 'd':
+			args.path = optarg;
+			break;
+		case 'o':
+			args.offset = parse_size(optarg);
+			/* parse_size() returns 0 on errors, so only a plain 0 may give offset 0 */
+			if (!args.offset && (!*optarg || optarg[strspn(optarg, "0")])) {
+				fprintf(stderr, "Invalid offset %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 's':
+			args.size = parse_size(optarg);
+			if (!args.size) {
+				fprintf(stderr, "Invalid size %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'C':
+			args.create = 1;
+			break;
+		case 'm':
+			if (parse_names(optarg, mode_names, MODE_NUM, &args.modes) != 0) {
+				fprintf(stderr, "Invalid test list %s\n", optarg);
+				return 1;
+			}
+			modes_set = 1;
+			break;
+		case 'P':
+			if (parse_names(optarg, profile_names, PROFILE_NUM, &args.profiles) != 0) {
+				fprintf(stderr, "Invalid profile list %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'b':
+			n = parse_size_list(optarg, args.block_sizes);
+			if (n < 0) {
+				fprintf(stderr, "Invalid block size list\n");
+				return 1;
+			}
+			args.nblock_sizes = n;
+			break;
+		case 'q':
+			n = parse_size_list(optarg, depths);
+			if (n < 0) {
+				fprintf(stderr, "Invalid queue depth list\n");
+				return 1;
+			}
+			for (d = 0; d < (unsigned int)n; d++) {
+				if (depths[d] > MAX_DEPTH) {
+					fprintf(stderr, "Queue depth is limited to %d\n", MAX_DEPTH);
+					return 1;
+				}
+				args.depths[d] = depths[d];
+			}
+			args.ndepths = n;
+			break;
+		case 't':
+			args.time = strtod(optarg, NULL);
+			break;
+		case 'e':
+			for (n = 0; n < ENGINE_NUM; n++)
+				if (!strcmp(optarg, engine_names[n]))
+					break;
+			if (n == ENGINE_NUM) {
+				fprintf(stderr, "Unknown engine %s\n", optarg);
+				return 1;
+			}
+			args.engine = n;
+			engine_set = 1;
+			break;
+		case 'B':
+			args.direct = 0;
+			break;
+		case 'V':
+			args.verify = 1;
+			break;
+		case 'N':
+			args.verify = 0;
+			break;
+		case 'S':
+			args.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'R':
+			args.read_percent = strtoul(optarg, NULL, 0);
+			if (args.read_percent > 100) {
+				fprintf(stderr, "Invalid read percentage %s\n", optarg);
+				return 1;
+			}
+			break;
+		case 'F':
+			args.fsync_every = strtoul(optarg, NULL, 0);
+			break;
+		case 'I':
+			args.probe_interval = strtoul(optarg, NULL, 0);
+			break;
+		case 'L':
+			args.stall = strtoul(optarg, NULL, 0);
+			break;
+		case 'j':
+			args.json = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+	if (!args.path) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (args.profiles && !modes_set)
+		args.modes = 0;
+
+	for (b = 0; b < args.nblock_sizes; b++) {
+		if (args.block_sizes[b] % CHUNK_SIZE) {
+			fprintf(stderr, "Block sizes must be multiples of %lu\n", CHUNK_SIZE);
+			return 1;
+		}
+	}
+	if (args.offset % CHUNK_SIZE) {
+		fprintf(stderr, "The offset must be a multiple of %lu\n", CHUNK_SIZE);
+		return 1;
+	}
+
+	if (args.engine == ENGINE_URING && io_uring_probe() != 0) {
+		if (engine_set) {
+			fprintf(stderr, "io_uring is not available: %s\n", strerror(errno));
+			return 1;
+		}
+		args.engine = ENGINE_PSYNC;
+	}
+
+	fd = open_target(&args);
+	if (fd < 0)
+		return 1;
+	size = target_size(fd);
+	if (!args.size)
+		args.size = size > args.offset ? size - args.offset : 0;
+	if (!args.size) {
+		fprintf(stderr, "%s is empty, give the region with --size\n", args.path);
+		return 1;
+	}
+	if (args.offset + args.size > size && args.create && target_is_file(fd)) {
+		if (ftruncate(fd, args.offset + args.size) != 0) {
+			fprintf(stderr, "Cannot extend %s: %s\n", args.path, strerror(errno));
+			return 1;
+		}
+	} else if (args.offset + args.size > size) {
+		fprintf(stderr, "%s is only %lu bytes%s\n", args.path, size,
+			target_is_file(fd) ? ", give --create to extend it" : "");
+		return 1;
+	}
+	if (pool_init(&pool, args.seed) != 0) {
+		fprintf(stderr, "Cannot allocate the data pool\n");
+		return 1;
+	}
+
+	if (args.modes)
+		failed += run_modes(&args, &pool, fd, &written);
+	if (args.profiles)
+		failed += run_profiles(&args, &pool, fd, written);
+
+	pool_free(&pool);
+	close(fd);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,573 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <linux/io_uring.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "storage_io.h"
+
+const char *op_names[OP_NUM] = {
+	"read",
+	"write",
+	"sync",
+};
+
+const char *engine_names[ENGINE_NUM] = {
+	"io_uring",
+	"psync",
+};
+
+typedef struct {
+	uint64_t offset;
+	uint64_t seed;
+} chunk_stamp;
+
+static uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static uint64_t checksum(const void *data, size_t len)
+{
+	const uint64_t *word = (const uint64_t *)data;
+	uint64_t sum = 0x84222325cbf29ce4ULL;
+	size_t i;
+
+	for (i = 0; i < len / sizeof(uint64_t); i++) {
+		sum = (sum ^ word[i]) * 0x100000001b3ULL;
+		sum = (sum << 29) | (sum >> 35);
+	}
+	return sum;
+}
+
+static unsigned int chunk_index(const data_pool *pool, uint64_t offset)
+{
+	return splitmix64(pool->seed ^ offset) % POOL_CHUNKS;
+}
+
+int pool_init(data_pool *pool, uint64_t seed)
+{
+	uint64_t *word;
+	unsigned long int i;
+
+	if (posix_memalign((void **)&pool->data, CHUNK_SIZE, POOL_CHUNKS * CHUNK_SIZE) != 0)
+		return -1;
+	pool->seed = seed;
+	word = (uint64_t *)pool->data;
+	for (i = 0; i < POOL_CHUNKS * CHUNK_SIZE / sizeof(uint64_t); i++)
+		word[i] = splitmix64(seed + i);
+	for (i = 0; i < POOL_CHUNKS; i++)
+		pool->sums[i] = checksum(pool->data + i * CHUNK_SIZE + sizeof(chunk_stamp),
+					 CHUNK_SIZE - sizeof(chunk_stamp));
+	return 0;
+}
+
+void pool_free(data_pool *pool)
+{
+	free(pool->data);
+	pool->data = NULL;
+}
+
+static void fill_buffer(const data_pool *pool, unsigned char *buf, uint64_t offset, size_t len)
+{
+	chunk_stamp stamp = { .seed = pool->seed };
+	size_t done;
+
+	for (done = 0; done < len; done += CHUNK_SIZE) {
+		memcpy(buf + done, pool->data + chunk_index(pool, offset + done) * CHUNK_SIZE,
+		       CHUNK_SIZE);
+		stamp.offset = offset + done;
+		memcpy(buf + done, &stamp, sizeof(stamp));
+	}
+}
+
+/* Returns the number of chunks that are not what fill_buffer() wrote */
+static unsigned long int verify_buffer(const data_pool *pool, const unsigned char *buf,
+				       uint64_t offset, size_t len)
+{
+	unsigned long int bad = 0;
+	chunk_stamp stamp;
+	size_t done;
+
+	for (done = 0; done < len; done += CHUNK_SIZE) {
+		memcpy(&stamp, buf + done, sizeof(stamp));
+		if (stamp.offset != offset + done || stamp.seed != pool->seed ||
+		    checksum(buf + done + sizeof(stamp), CHUNK_SIZE - sizeof(stamp)) !=
+		    pool->sums[chunk_index(pool, offset + done)])
+			bad++;
+	}
+	return bad;
+}
+
+void io_stats_init(io_stats *ops)
+{
+	unsigned int op;
+
+	memset(ops, 0, OP_NUM * sizeof(*ops));
+	for (op = 0; op < OP_NUM; op++)
+		hist_init(&ops[op].latency);
+}
+
+/* Lane counters have a single writer, see hist_record() */
+static void count(unsigned long int *counter, unsigned long int n)
+{
+	__atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+/* Device offset of the index-th I/O of a job */
+static unsigned long int io_offset(const io_job *j, unsigned long int index)
+{
+	unsigned long int block = index % j->nblocks;
+
+	if (j->random)
+		block = splitmix64(j->seed ^ index) % j->nblocks;
+	return j->offset + block * j->bs;
+}
+
+static int io_is_write(const io_job *j, unsigned long int index)
+{
+	if (j->write_percent == 0 || j->write_percent >= 100)
+		return j->write_percent != 0;
+	return splitmix64(~j->seed ^ index) % 100 < j->write_percent;
+}
+
+/* Hand out the next I/O index, or -1 once the job is done */
+static long int io_next(io_job *j)
+{
+	unsigned long int index;
+
+	if (__atomic_load_n(&j->stop, __ATOMIC_RELAXED))
+		return -1;
+	if (j->deadline && now_ns() >= j->deadline)
+		return -1;
+	index = __atomic_fetch_add(&j->next, 1, __ATOMIC_RELAXED);
+	return index < j->count ? (long int)index : -1;
+}
+
+/* Account a completed I/O, res is the byte count or a negative errno */
+static void io_done(io_job *j, io_lane *lane, int write, const unsigned char *buf,
+		    unsigned long int offset, long int res, unsigned long int start)
+{
+	io_stats *s = &lane->ops[write ? OP_WRITE : OP_READ];
+
+	hist_record(&s->latency, now_ns() - start);
+	count(&s->ios, 1);
+	if (res != (long int)j->bs) {
+		count(&s->errors, 1);
+		return;
+	}
+	count(&s->bytes, res);
+	if (!write && j->verify)
+		count(&s->corrupt, verify_buffer(j->pool, buf, offset, j->bs));
+}
+
+/*
+ * io_uring through the raw system calls, the tool does not depend on
+ * liburing being available in the root file system.
+ */
+typedef struct {
+	int fd;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void *sq_ptr;
+	void *cq_ptr;
+	size_t sq_len;
+	size_t cq_len;
+	size_t sqes_len;
+} uring;
+
+static void uring_exit(uring *u)
+{
+	if (u->sqes)
+		munmap(u->sqes, u->sqes_len);
+	if (u->cq_ptr && u->cq_ptr != u->sq_ptr)
+		munmap(u->cq_ptr, u->cq_len);
+	if (u->sq_ptr)
+		munmap(u->sq_ptr, u->sq_len);
+	if (u->fd >= 0)
+		close(u->fd);
+	memset(u, 0, sizeof(*u));
+	u->fd = -1;
+}
+
+static int uring_init(uring *u, unsigned int entries)
+{
+	struct io_uring_params p;
+	unsigned char *sq, *cq;
+
+	memset(u, 0, sizeof(*u));
+	memset(&p, 0, sizeof(p));
+	u->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (u->fd < 0)
+		return -1;
+
+	u->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	u->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (u->cq_len > u->sq_len)
+			u->sq_len = u->cq_len;
+		u->cq_len = u->sq_len;
+	}
+
+	u->sq_ptr = mmap(NULL, u->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd,
+			 IORING_OFF_SQ_RING);
+	if (u->sq_ptr == MAP_FAILED) {
+		u->sq_ptr = NULL;
+		goto err;
+	}
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		u->cq_ptr = u->sq_ptr;
+	} else {
+		u->cq_ptr = mmap(NULL, u->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+				 u->fd, IORING_OFF_CQ_RING);
+		if (u->cq_ptr == MAP_FAILED) {
+			u->cq_ptr = NULL;
+			goto err;
+		}
+	}
+	u->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	u->sqes = mmap(NULL, u->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd,
+		       IORING_OFF_SQES);
+	if (u->sqes == MAP_FAILED) {
+		u->sqes = NULL;
+		goto err;
+	}
+
+	sq = u->sq_ptr;
+	cq = u->cq_ptr;
+	u->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	u->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	u->sq_array = (unsigned int *)(sq + p.sq_off.array);
+	u->cq_head = (unsigned int *)(cq + p.cq_off.head);
+	u->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	u->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+	return 0;
+err:
+	uring_exit(u);
+	return -1;
+}
+
+static void uring_prep(uring *u, int write, int fd, void *buf, unsigned int len,
+		       unsigned long int offset, unsigned long int data)
+{
+	unsigned int tail = *u->sq_tail, index = tail & *u->sq_mask;
+	struct io_uring_sqe *sqe = &u->sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long int)buf;
+	sqe->len = len;
+	sqe->off = offset;
+	sqe->user_data = data;
+	u->sq_array[index] = index;
+	__atomic_store_n(u->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_enter(uring *u, unsigned int submit, unsigned int wait)
+{
+	int rv;
+
+	do {
+		rv = syscall(__NR_io_uring_enter, u->fd, submit, wait,
+			     wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (rv < 0 && errno == EINTR);
+	return rv;
+}
+
+int io_uring_probe(void)
+{
+	uring u;
+
+	if (uring_init(&u, 1) != 0)
+		return -1;
+	uring_exit(&u);
+	return 0;
+}
+
+typedef struct {
+	unsigned char *buf;
+	unsigned long int offset;
+	unsigned long int start;
+	int write;
+} io_slot;
+
+static int run_uring(io_job *j, io_lane *lane)
+{
+	unsigned int inflight = 0, pending = 0, nfree = j->depth, head, tail, i;
+	unsigned int freelist[MAX_DEPTH];
+	io_slot slots[MAX_DEPTH];
+	unsigned char *bufs;
+	struct io_uring_cqe *cqe;
+	long int index;
+	int done = 0, failed = 0, rv;
+	uring u;
+
+	if (uring_init(&u, j->depth) != 0)
+		return -1;
+	if (posix_memalign((void **)&bufs, CHUNK_SIZE, j->depth * j->bs) != 0) {
+		uring_exit(&u);
+		return -1;
+	}
+	for (i = 0; i < j->depth; i++) {
+		slots[i].buf = bufs + i * j->bs;
+		freelist[i] = j->depth - 1 - i;
+	}
+
+	while (!done || inflight) {
+		while (!done && nfree) {
+			index = io_next(j);
+			if (index < 0) {
+				done = 1;
+				break;
+			}
+			i = freelist[--nfree];
+			slots[i].offset = io_offset(j, index);
+			slots[i].write = io_is_write(j, index);
+			if (slots[i].write)
+				fill_buffer(j->pool, slots[i].buf, slots[i].offset, j->bs);
+			slots[i].start = now_ns();
+			uring_prep(&u, slots[i].write, j->fd, slots[i].buf, j->bs, slots[i].offset, i);
+			pending++;
+			inflight++;
+		}
+		if (!inflight)
+			break;
+
+		rv = uring_enter(&u, pending, 1);
+		if (rv < 0) {
+			fprintf(stderr, "io_uring_enter failed: %s\n", strerror(errno));
+			//Entries the kernel did not take are never completed
+			count(&lane->ops[j->write_percent ? OP_WRITE : OP_READ].errors, pending);
+			inflight -= pending;
+			pending = 0;
+			done = 1;
+			//I/Os the kernel holds still use their buffers, keep reaping them
+			if (failed++)
+				break;
+			continue;
+		}
+		//Entries the kernel did not take yet go with the next enter
+		pending -= rv;
+
+		head = *u.cq_head;
+		tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			cqe = &u.cqes[head & *u.cq_mask];
+			i = cqe->user_data;
+			io_done(j, lane, slots[i].write, slots[i].buf, slots[i].offset, cqe->res,
+				slots[i].start);
+			freelist[nfree++] = i;
+			inflight--;
+		}
+		__atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
+	}
+
+	if (inflight) {
+		//The kernel may still write into bufs after the ring is gone, leak them
+		count(&lane->ops[j->write_percent ? OP_WRITE : OP_READ].errors, inflight);
+		uring_exit(&u);
+		return -1;
+	}
+	free(bufs);
+	uring_exit(&u);
+	return failed ? -1 : 0;
+}
+
+typedef struct {
+	io_job *j;
+	io_lane *lane;
+} psync_worker;
+
+static void *psync_thread(void *arg)
+{
+	psync_worker *w = (psync_worker *)arg;
+	io_job *j = w->j;
+	io_lane *lane = w->lane;
+	unsigned long int offset, start, writes = 0;
+	struct timespec next;
+	unsigned char *buf;
+	long int index;
+	ssize_t res;
+	int write;
+
+	if (posix_memalign((void **)&buf, CHUNK_SIZE, j->bs) != 0) {
+		count(&lane->ops[OP_READ].errors, 1);
+		return NULL;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	while ((index = io_next(j)) >= 0) {
+		//Paced lanes issue at absolute deadlines, a slow I/O does not shift the rest
+		if (j->interval) {
+			timespec_add_ns(&next, j->interval);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		offset = io_offset(j, index);
+		write = io_is_write(j, index);
+		if (write)
+			fill_buffer(j->pool, buf, offset, j->bs);
+		start = now_ns();
+		if (write)
+			res = pwrite(j->fd, buf, j->bs, offset);
+		else
+			res = pread(j->fd, buf, j->bs, offset);
+		io_done(j, lane, write, buf, offset, res < 0 ? -errno : res, start);
+
+		if (write && j->fsync_every && ++writes % j->fsync_every == 0) {
+			start = now_ns();
+			if (fdatasync(j->fd) != 0)
+				count(&lane->ops[OP_SYNC].errors, 1);
+			hist_record(&lane->ops[OP_SYNC].latency, now_ns() - start);
+			count(&lane->ops[OP_SYNC].ios, 1);
+		}
+	}
+	free(buf);
+	return NULL;
+}
+
+static int run_psync(io_job *j)
+{
+	pthread_t threads[MAX_DEPTH];
+	psync_worker workers[MAX_DEPTH];
+	unsigned int i, started;
+
+	for (started = 0; started < j->nlanes; started++) {
+		workers[started].j = j;
+		workers[started].lane = &j->lanes[started];
+		if (pthread_create(&threads[started], NULL, psync_thread, &workers[started]) != 0)
+			break;
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	return started ? 0 : -1;
+}
+
+int io_job_run(io_job *j)
+{
+	unsigned int i, op, nlanes;
+	unsigned long int start;
+	io_lane *lanes;
+	int rv;
+
+	//Fsync cadence and pacing are per thread, io_uring has a single submitter
+	if (j->fsync_every || j->interval)
+		j->engine = ENGINE_PSYNC;
+	nlanes = j->engine == ENGINE_URING ? 1 : j->depth;
+	lanes = calloc(nlanes, sizeof(*lanes));
+	if (!lanes)
+		return -1;
+	for (i = 0; i < nlanes; i++)
+		io_stats_init(lanes[i].ops);
+	io_stats_init(j->total);
+	//Published initialised for io_job_snapshot()
+	j->nlanes = nlanes;
+	__atomic_store_n(&j->lanes, lanes, __ATOMIC_RELEASE);
+	if (!j->count)
+		j->count = j->time > 0 ? ULONG_MAX : j->nblocks;
+	j->next = 0;
+
+	start = now_ns();
+	if (j->time > 0)
+		j->deadline = start + j->time * 1e9;
+	if (j->engine == ENGINE_URING)
+		rv = run_uring(j, &j->lanes[0]);
+	else
+		rv = run_psync(j);
+	if (rv == 0 && j->write_percent && fdatasync(j->fd) != 0)
+		count(&j->lanes[0].ops[OP_SYNC].errors, 1);
+	j->seconds = (now_ns() - start) / 1e9;
+
+	for (i = 0; i < j->nlanes; i++) {
+		for (op = 0; op < OP_NUM; op++) {
+			hist_merge(&j->total[op].latency, &j->lanes[i].ops[op].latency);
+			j->total[op].ios += j->lanes[i].ops[op].ios;
+			j->total[op].bytes += j->lanes[i].ops[op].bytes;
+			j->total[op].errors += j->lanes[i].ops[op].errors;
+			j->total[op].corrupt += j->lanes[i].ops[op].corrupt;
+		}
+	}
+	__atomic_store_n(&j->done, 1, __ATOMIC_RELEASE);
+	return rv;
+}
+
+static void *io_job_thread(void *arg)
+{
+	io_job *j = (io_job *)arg;
+
+	j->rv = io_job_run(j);
+	return NULL;
+}
+
+int io_job_start(io_job *j)
+{
+	j->done = 0;
+	j->lanes = NULL;
+	j->nlanes = 0;
+	if (pthread_create(&j->thread, NULL, io_job_thread, j) != 0) {
+		j->done = 1;
+		return -1;
+	}
+	return 0;
+}
+
+int io_job_wait(io_job *j)
+{
+	pthread_join(j->thread, NULL);
+	return j->rv;
+}
+
+void io_job_stop(io_job *j)
+{
+	__atomic_store_n(&j->stop, 1, __ATOMIC_RELAXED);
+}
+
+void io_job_snapshot(io_job *j, io_stats *ops)
+{
+	io_lane *lanes = __atomic_load_n(&j->lanes, __ATOMIC_ACQUIRE);
+	histogram latency;
+	unsigned int i, op;
+
+	io_stats_init(ops);
+	if (!lanes)
+		return;
+	for (i = 0; i < j->nlanes; i++) {
+		for (op = 0; op < OP_NUM; op++) {
+			hist_snapshot(&latency, &lanes[i].ops[op].latency);
+			hist_merge(&ops[op].latency, &latency);
+			ops[op].ios += __atomic_load_n(&lanes[i].ops[op].ios, __ATOMIC_RELAXED);
+			ops[op].bytes += __atomic_load_n(&lanes[i].ops[op].bytes, __ATOMIC_RELAXED);
+			ops[op].errors += __atomic_load_n(&lanes[i].ops[op].errors, __ATOMIC_RELAXED);
+			ops[op].corrupt += __atomic_load_n(&lanes[i].ops[op].corrupt, __ATOMIC_RELAXED);
+		}
+	}
+}
+
+void io_job_free(io_job *j)
+{
+	free(j->lanes);
+	j->lanes = NULL;
+	j->nlanes = 0;
+}
@@ -0,0 +1,124 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * I/O jobs of the storage benchmark. A job issues block sized reads and
+ * writes over a region of a device, sequentially or at random offsets, with
+ * a number of I/Os in flight. It runs through io_uring, or through one
+ * pread/pwrite thread per queue slot where io_uring is not available or
+ * the job needs fsync cadence or pacing.
+ *
+ * Written data is made of 4KiB chunks taken from a pre-generated pool. Each
+ * chunk carries a stamp with its device offset and the seed, and reads check
+ * the stamp and the checksum of the rest of the chunk, so misplaced, stale
+ * and corrupted blocks are all caught without storing a copy of the data.
+ * The data at an offset only depends on the seed, so reads racing rewrites
+ * of the same block still verify.
+ *
+ * Statistics are kept per lane, the io_uring loop or one psync thread, with
+ * a single writer each, so another thread can take snapshots while the job
+ * runs.
+ */
+
+#ifndef STORAGE_IO_H
+#define STORAGE_IO_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "histogram.h"
+
+#define CHUNK_SIZE	4096UL		/* Unit of the data pattern and O_DIRECT alignment */
+#define POOL_CHUNKS	256
+#define MAX_DEPTH	256
+
+typedef enum {
+	OP_READ,
+	OP_WRITE,
+	OP_SYNC,
+	OP_NUM
+} io_op;
+
+typedef enum {
+	ENGINE_URING,
+	ENGINE_PSYNC,
+	ENGINE_NUM
+} io_engine;
+
+extern const char *op_names[OP_NUM];
+extern const char *engine_names[ENGINE_NUM];
+
+typedef struct {
+	unsigned char *data;
+	uint64_t sums[POOL_CHUNKS];
+	uint64_t seed;
+} data_pool;
+
+typedef struct {
+	histogram latency;
+	unsigned long int ios;
+	unsigned long int bytes;
+	unsigned long int errors;	/* Failed or short I/Os */
+	unsigned long int corrupt;	/* Chunks failing verification */
+} io_stats;
+
+typedef struct {
+	io_stats ops[OP_NUM];
+} io_lane;
+
+typedef struct {
+	const data_pool *pool;
+	int fd;
+	io_engine engine;
+	unsigned long int offset;	/* Start of the region */
+	unsigned long int nblocks;	/* Size of the region in blocks */
+	unsigned long int bs;
+	unsigned int depth;
+	int random;
+	unsigned int write_percent;	/* 0 for reads only, 100 for writes only */
+	int verify;
+	unsigned long int count;	/* I/Os to issue, 0 for one pass over the region */
+	double time;			/* Seconds to run, 0 for no limit */
+	unsigned long int fsync_every;	/* fdatasync() after every N writes of a lane */
+	unsigned long int interval;	/* ns between the I/Os of a lane, 0 back to back */
+	uint64_t seed;			/* Random offsets and read/write mix */
+
+	unsigned long int deadline;
+	unsigned long int next;		/* Next I/O index, shared by the lanes */
+	int stop;
+	int done;
+	io_lane *lanes;
+	unsigned int nlanes;
+	pthread_t thread;
+	int rv;
+
+	io_stats total[OP_NUM];		/* Lanes merged once the job is done */
+	double seconds;
+} io_job;
+
+int pool_init(data_pool *pool, uint64_t seed);
+void pool_free(data_pool *pool);
+
+/* Returns 0 if io_uring can be used */
+int io_uring_probe(void);
+
+/* Run a job to completion, returns 0 or -1 if it could not run */
+int io_job_run(io_job *j);
+
+/* Run a job in a thread of its own, io_job_wait() returns what io_job_run() did */
+int io_job_start(io_job *j);
+int io_job_wait(io_job *j);
+
+/* Stop issuing I/O, what is in flight completes */
+void io_job_stop(io_job *j);
+
+/* Merge a snapshot of every lane into ops, while the job may still run */
+void io_job_snapshot(io_job *j, io_stats *ops);
+
+void io_job_free(io_job *j);
+
+void io_stats_init(io_stats *ops);
+
+#endif /* STORAGE_IO_H */
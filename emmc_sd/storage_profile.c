@@ -0,0 +1,361 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clock.h"
+#include "hist_json.h"
+#include "storage_profile.h"
+
+#define PROFILE_MAX_JOBS	2
+#define POLL_NS			20000000UL	/* How soon a finished profile is noticed */
+#define MIN_BUCKET_NS		100000000UL
+
+const char *profile_names[PROFILE_NUM] = {
+	"mixed",
+	"log",
+	"probe",
+};
+
+static void job_init(io_job *j, const profile_config *cfg, unsigned long int bs)
+{
+	memset(j, 0, sizeof(*j));
+	j->pool = cfg->pool;
+	j->fd = cfg->fd;
+	j->engine = cfg->engine;
+	j->offset = cfg->offset;
+	j->bs = bs;
+	j->nblocks = cfg->size / bs;
+	j->depth = cfg->depth ? cfg->depth : 1;
+	j->verify = cfg->verify;
+	j->time = cfg->time;
+}
+
+/* Set up the jobs of a profile, returns how many */
+static unsigned int profile_jobs(storage_profile profile, const profile_config *cfg,
+				 profile_result *res, io_job *jobs)
+{
+	switch (profile) {
+	case PROFILE_MIXED:
+		res->block_size = cfg->block_size ? cfg->block_size : CHUNK_SIZE;
+		res->op_mask = (1U << OP_READ) | (1U << OP_WRITE);
+		job_init(&jobs[0], cfg, res->block_size);
+		jobs[0].random = 1;
+		jobs[0].write_percent = 100 - cfg->read_percent;
+		jobs[0].seed = cfg->seed ^ ((uint64_t)PROFILE_MIXED << 56);
+		return 1;
+	case PROFILE_LOG:
+		res->block_size = cfg->block_size ? cfg->block_size : CHUNK_SIZE;
+		res->op_mask = (1U << OP_WRITE) | (1U << OP_SYNC);
+		job_init(&jobs[0], cfg, res->block_size);
+		jobs[0].depth = 1;
+		jobs[0].write_percent = 100;
+		jobs[0].fsync_every = cfg->fsync_every;
+		return 1;
+	case PROFILE_PROBE:
+		res->block_size = cfg->block_size ? cfg->block_size : 1UL << 20;
+		res->op_mask = (1U << OP_READ) | (1U << OP_WRITE);
+		job_init(&jobs[0], cfg, res->block_size);
+		jobs[0].write_percent = 100;
+		//The probes are stopped once the writer is done
+		job_init(&jobs[1], cfg, CHUNK_SIZE);
+		jobs[1].depth = 1;
+		jobs[1].random = 1;
+		jobs[1].time = 0;
+		jobs[1].count = ~0UL;
+		jobs[1].interval = cfg->probe_interval * 1000;
+		jobs[1].seed = cfg->seed ^ ((uint64_t)PROFILE_PROBE << 56);
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static void stats_add(io_stats *dst, const io_stats *src)
+{
+	unsigned int op;
+
+	for (op = 0; op < OP_NUM; op++) {
+		hist_merge(&dst[op].latency, &src[op].latency);
+		dst[op].ios += src[op].ios;
+		dst[op].bytes += src[op].bytes;
+		dst[op].errors += src[op].errors;
+		dst[op].corrupt += src[op].corrupt;
+	}
+}
+
+static void print_header(const profile_result *res, FILE *out)
+{
+	unsigned int op;
+
+	fprintf(out, "%7s", "Time");
+	for (op = 0; op < OP_NUM; op++) {
+		if (!(res->op_mask & (1U << op)))
+			continue;
+		if (op == OP_SYNC)
+			fprintf(out, " | %7s %9s %9s", "syncs", "p99 us", "max us");
+		else
+			fprintf(out, " | %5s MB/s %8s %9s %9s", op_names[op], "IOPS", "p99 us", "max us");
+	}
+	fprintf(out, "\n");
+}
+
+static void print_second(const profile_result *res, const profile_second *s, FILE *out)
+{
+	unsigned int op;
+
+	fprintf(out, "%6us", res->nseconds);
+	for (op = 0; op < OP_NUM; op++) {
+		if (!(res->op_mask & (1U << op)))
+			continue;
+		if (op == OP_SYNC)
+			fprintf(out, " | %7lu %9.1f %9.1f", s->ios[op], s->p99[op] / 1e3,
+				s->max[op] / 1e3);
+		else
+			fprintf(out, " | %10.1f %8.0f %9.1f %9.1f", s->bytes[op] / s->seconds / 1e6,
+				s->ios[op] / s->seconds, s->p99[op] / 1e3, s->max[op] / 1e3);
+	}
+	fprintf(out, "%s\n", s->stall ? "  STALL" : "");
+	fflush(out);
+}
+
+/* Close the bucket between the before and now snapshots */
+static int add_second(profile_result *res, const profile_config *cfg, const io_stats *now,
+		      const io_stats *before, double seconds, FILE *live)
+{
+	profile_second *s, *timeline;
+	unsigned long int ios = 0;
+	histogram delta;
+	unsigned int op;
+
+	timeline = realloc(res->timeline, (res->nseconds + 1) * sizeof(*timeline));
+	if (!timeline)
+		return -1;
+	res->timeline = timeline;
+	s = &res->timeline[res->nseconds];
+	memset(s, 0, sizeof(*s));
+	s->seconds = seconds;
+	for (op = 0; op < OP_NUM; op++) {
+		hist_delta(&delta, &now[op].latency, &before[op].latency);
+		s->ios[op] = now[op].ios - before[op].ios;
+		s->bytes[op] = now[op].bytes - before[op].bytes;
+		s->p99[op] = hist_percentile(&delta, 0.99);
+		s->max[op] = delta.total ? delta.max : 0;
+		if (s->max[op] > cfg->stall)
+			s->stall = 1;
+		ios += s->ios[op];
+	}
+	//A second without any completion is a stall as well, the I/O is still in flight
+	if (!ios && seconds > 0.5)
+		s->stall = 1;
+	res->stalls += s->stall;
+	res->nseconds++;
+	if (live)
+		print_second(res, s, live);
+	return 0;
+}
+
+int profile_run(storage_profile profile, const profile_config *cfg, profile_result *res,
+		FILE *live)
+{
+	io_stats now[OP_NUM], before[OP_NUM], job[OP_NUM];
+	unsigned long int start, next, t;
+	io_job jobs[PROFILE_MAX_JOBS];
+	unsigned int njobs, i, started;
+	int done, rv = 0;
+
+	memset(res, 0, sizeof(*res));
+	res->profile = profile;
+	io_stats_init(res->ops);
+	njobs = profile_jobs(profile, cfg, res, jobs);
+	if (!njobs || cfg->size / res->block_size == 0)
+		return -1;
+
+	io_stats_init(before);
+	start = now_ns();
+	for (started = 0; started < njobs; started++) {
+		if (io_job_start(&jobs[started]) != 0) {
+			rv = -1;
+			break;
+		}
+	}
+	if (live && started == njobs)
+		print_header(res, live);
+
+	next = start + 1000000000UL;
+	do {
+		//The first job drives the profile, the others run alongside it
+		done = __atomic_load_n(&jobs[0].done, __ATOMIC_ACQUIRE) || rv != 0;
+		if (done) {
+			for (i = 1; i < started; i++)
+				io_job_stop(&jobs[i]);
+			for (i = 0; i < started; i++)
+				done &= __atomic_load_n(&jobs[i].done, __ATOMIC_ACQUIRE);
+		}
+
+		t = now_ns();
+		if (!done && t < next) {
+			t = next - t < POLL_NS ? next : t + POLL_NS;
+			sleep_until_ns(t);
+			continue;
+		}
+
+		//A final bucket of a few straggling completions says nothing about the rate
+		if (done && t - (next - 1000000000UL) < MIN_BUCKET_NS && res->nseconds)
+			break;
+		io_stats_init(now);
+		for (i = 0; i < started; i++) {
+			io_job_snapshot(&jobs[i], job);
+			stats_add(now, job);
+		}
+		if (add_second(res, cfg, now, before, (t - (next - 1000000000UL)) / 1e9, live) != 0)
+			rv = -1;
+		memcpy(before, now, sizeof(before));
+		next += 1000000000UL;
+	} while (!done);
+
+	for (i = 0; i < started; i++) {
+		if (io_job_wait(&jobs[i]) != 0)
+			rv = -1;
+		stats_add(res->ops, jobs[i].total);
+		if (jobs[i].seconds > res->seconds)
+			res->seconds = jobs[i].seconds;
+		io_job_free(&jobs[i]);
+	}
+	return rv;
+}
+
+void profile_result_free(profile_result *res)
+{
+	free(res->timeline);
+	res->timeline = NULL;
+	res->nseconds = 0;
+}
+
+static const char *profile_summary(const profile_config *cfg, const profile_result *res,
+				   char *buf, size_t len)
+{
+	switch (res->profile) {
+	case PROFILE_MIXED:
+		snprintf(buf, len, "%luK random, %u%% reads, depth %u", res->block_size / 1024,
+			 cfg->read_percent, cfg->depth);
+		break;
+	case PROFILE_LOG:
+		snprintf(buf, len, "%luK appends, fdatasync every %lu writes", res->block_size / 1024,
+			 cfg->fsync_every);
+		break;
+	case PROFILE_PROBE:
+		snprintf(buf, len, "4K reads every %luus under %luK sequential writes, depth %u",
+			 cfg->probe_interval, res->block_size / 1024, cfg->depth);
+		break;
+	default:
+		buf[0] = '\0';
+	}
+	return buf;
+}
+
+void profile_report(const profile_config *cfg, const profile_result *res, FILE *out)
+{
+	const io_stats *s;
+	char summary[128];
+	unsigned int op;
+
+	fprintf(out, "%s: %s, %.1fs, %u of %u seconds stalled (max latency over %.0fms or no I/O)\n",
+		profile_names[res->profile], profile_summary(cfg, res, summary, sizeof(summary)),
+		res->seconds, res->stalls, res->nseconds, cfg->stall / 1e6);
+	for (op = 0; op < OP_NUM; op++) {
+		if (!(res->op_mask & (1U << op)))
+			continue;
+		s = &res->ops[op];
+		if (op == OP_SYNC)
+			fprintf(out, "  %-6s %10lu syncs %15s", op_names[op], s->ios, "");
+		else
+			fprintf(out, "  %-6s %10.1f MB/s %10.0f IOPS", op_names[op],
+				res->seconds > 0 ? s->bytes / res->seconds / 1e6 : 0,
+				res->seconds > 0 ? s->ios / res->seconds : 0);
+		fprintf(out, "  lat us p50 %.1f p99 %.1f p999 %.1f max %.1f",
+			hist_percentile(&s->latency, 0.50) / 1e3, hist_percentile(&s->latency, 0.99) / 1e3,
+			hist_percentile(&s->latency, 0.999) / 1e3, s->latency.max / 1e3);
+		fprintf(out, "  errors %lu corrupt %lu\n", s->errors, s->corrupt);
+	}
+}
+
+void profile_json(const profile_config *cfg, const profile_result *res, FILE *out)
+{
+	unsigned long int bytes = 0, errors = 0, ios = 0;
+	const profile_second *s;
+	const io_stats *primary;
+	json_record r;
+	unsigned int op, i;
+
+	//The latency that matters to the workload, fsync for loggers, reads otherwise
+	primary = &res->ops[res->profile == PROFILE_LOG ? OP_SYNC : OP_READ];
+	for (op = 0; op < OP_NUM; op++) {
+		bytes += res->ops[op].bytes;
+		ios += res->ops[op].ios;
+		errors += res->ops[op].errors + res->ops[op].corrupt;
+	}
+
+	json_begin(&r, out, "storage_bench", profile_names[res->profile]);
+	json_object_begin(&r, "params");
+	json_string(&r, "device", cfg->path);
+	json_uint(&r, "offset", cfg->offset);
+	json_uint(&r, "size", cfg->size);
+	json_uint(&r, "block_size", res->block_size);
+	json_uint(&r, "queue_depth", cfg->depth);
+	json_string(&r, "engine", engine_names[cfg->engine]);
+	if (res->profile == PROFILE_MIXED)
+		json_uint(&r, "read_percent", cfg->read_percent);
+	if (res->profile == PROFILE_LOG)
+		json_uint(&r, "fsync_every", cfg->fsync_every);
+	if (res->profile == PROFILE_PROBE)
+		json_uint(&r, "probe_interval_us", cfg->probe_interval);
+	json_uint(&r, "stall_ns", cfg->stall);
+	json_bool(&r, "verify", cfg->verify);
+	json_object_end(&r);
+	json_double(&r, "duration_s", res->seconds);
+	json_uint(&r, "bytes", bytes);
+	json_double(&r, "bandwidth_gbps", res->seconds > 0 ? bytes / res->seconds / 1e9 : 0);
+	json_latency(&r, "latency_ns", &primary->latency);
+
+	for (op = 0; op < OP_NUM; op++) {
+		if (!(res->op_mask & (1U << op)))
+			continue;
+		json_object_begin(&r, op_names[op]);
+		json_uint(&r, "ios", res->ops[op].ios);
+		json_uint(&r, "bytes", res->ops[op].bytes);
+		json_double(&r, "iops", res->seconds > 0 ? res->ops[op].ios / res->seconds : 0);
+		json_latency(&r, "latency_ns", &res->ops[op].latency);
+		json_uint(&r, "errors", res->ops[op].errors);
+		json_uint(&r, "corrupt", res->ops[op].corrupt);
+		json_object_end(&r);
+	}
+
+	json_array_begin(&r, "timeline");
+	for (i = 0; i < res->nseconds; i++) {
+		s = &res->timeline[i];
+		json_object_begin(&r, NULL);
+		json_double(&r, "seconds", s->seconds);
+		for (op = 0; op < OP_NUM; op++) {
+			if (!(res->op_mask & (1U << op)))
+				continue;
+			json_object_begin(&r, op_names[op]);
+			json_uint(&r, "ios", s->ios[op]);
+			json_uint(&r, "bytes", s->bytes[op]);
+			json_uint(&r, "p99_ns", s->p99[op]);
+			json_uint(&r, "max_ns", s->max[op]);
+			json_object_end(&r);
+		}
+		json_bool(&r, "stall", s->stall);
+		json_object_end(&r);
+	}
+	json_array_end(&r);
+	json_uint(&r, "stalls", res->stalls);
+	json_uint(&r, "errors", errors);
+	json_string(&r, "status", errors || !ios ? "fail" : "pass");
+	json_end(&r);
+}
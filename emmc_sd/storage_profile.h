@@ -0,0 +1,84 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * Workload profiles of the storage benchmark, closer to how the board uses
+ * its eMMC than a single stream:
+ *
+ *	mixed	Random 4K I/O, by default 70% reads and 30% writes
+ *	log	Sequential 4K appends with an fdatasync() every N writes, the
+ *		way inference results are logged
+ *	probe	Paced random 4K reads while a sequential writer runs, the read
+ *		latency an application sees under a background write
+ *
+ * Besides the totals, every profile reports throughput and tail latency per
+ * one second bucket, so write amplification stalls and garbage collection
+ * pauses of the device show up as seconds with a latency spike or without
+ * any completed I/O.
+ */
+
+#ifndef STORAGE_PROFILE_H
+#define STORAGE_PROFILE_H
+
+#include <stdio.h>
+
+#include "storage_io.h"
+
+typedef enum {
+	PROFILE_MIXED,
+	PROFILE_LOG,
+	PROFILE_PROBE,
+	PROFILE_NUM
+} storage_profile;
+
+extern const char *profile_names[PROFILE_NUM];
+
+typedef struct {
+	const data_pool *pool;
+	int fd;
+	io_engine engine;
+	const char *path;
+	unsigned long int offset;
+	unsigned long int size;
+	unsigned long int block_size;	/* 0 for the profile default */
+	unsigned int depth;
+	double time;			/* Seconds */
+	unsigned int read_percent;	/* mixed */
+	unsigned long int fsync_every;	/* log */
+	unsigned long int probe_interval; /* probe, in us */
+	unsigned long int stall;	/* Latency in ns that marks a second as a stall */
+	uint64_t seed;
+	int verify;
+} profile_config;
+
+typedef struct {
+	unsigned long int ios[OP_NUM];
+	unsigned long int bytes[OP_NUM];
+	unsigned long int p99[OP_NUM];
+	unsigned long int max[OP_NUM];
+	double seconds;			/* Length of the bucket, the last one may be short */
+	int stall;
+} profile_second;
+
+typedef struct {
+	storage_profile profile;
+	unsigned long int block_size;
+	unsigned int op_mask;		/* Bit per io_op the profile issues */
+	io_stats ops[OP_NUM];
+	profile_second *timeline;
+	unsigned int nseconds;
+	unsigned int stalls;
+	double seconds;
+} profile_result;
+
+/* Buckets are printed to live as they complete unless it is NULL */
+int profile_run(storage_profile profile, const profile_config *cfg, profile_result *res,
+		FILE *live);
+void profile_result_free(profile_result *res);
+
+void profile_report(const profile_config *cfg, const profile_result *res, FILE *out);
+void profile_json(const profile_config *cfg, const profile_result *res, FILE *out);
+
+#endif /* STORAGE_PROFILE_H */
@@ -0,0 +1,57 @@
+#!/bin/sh
+# Create four 8 line gpio-sim chips standing in for GPIO ports A to D, so
+# gpio_test can run on a host. Prints the value for gpio_test --chips.
+#
+#   gpio_test --chips=$(./gpio-sim-setup.sh) --self --pattern=all
+#   ./gpio-sim-setup.sh -r
+#
+# gpio-sim has no wiring between chips, use --self to read the driven lines
+# back. This does not exercise the sink lines or the reverse direction, those
+# need a board with the loopback wiring. Needs root, configfs and the gpio-sim
+# module.
+
+name="gpio_test"
+config=/sys/kernel/config/gpio-sim
+
+remove() {
+  [ -d "${config}/${name}" ] || return 0
+  echo 0 > "${config}/${name}/live"
+  for bank in "${config}/${name}"/gpio-bank*; do
+    rmdir "${bank}"
+  done
+  rmdir "${config}/${name}"
+}
+
+case "$1" in
+  -r)
+    remove
+    exit $?
+    ;;
+  "")
+    ;;
+  *)
+    echo "Usage: gpio-sim-setup.sh [-r]
+    -r: remove the simulated chips" >&2
+    exit 1
+    ;;
+esac
+
+modprobe gpio-sim || exit 1
+if [ ! -d "${config}" ]; then
+  mount -t configfs none /sys/kernel/config || exit 1
+fi
+
+remove
+mkdir "${config}/${name}" || exit 1
+for port in 0 1 2 3; do
+  mkdir "${config}/${name}/gpio-bank${port}"
+  echo 8 > "${config}/${name}/gpio-bank${port}/num_lines"
+done
+echo 1 > "${config}/${name}/live" || exit 1
+
+chips=""
+for port in 0 1 2 3; do
+  chip=$(cat "${config}/${name}/gpio-bank${port}/chip_name")
+  chips="${chips:+${chips},}/dev/${chip}"
+done
+echo "${chips}"
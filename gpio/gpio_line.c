@@ -0,0 +1,206 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "gpio_line.h"
+
+void gpio_config_init(gpio_config *cfg, __u64 flags)
+{
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->flags = flags;
+}
+
+static struct gpio_v2_line_config_attribute *config_attr(gpio_config *cfg, __u64 mask, __u32 id)
+{
+	struct gpio_v2_line_config_attribute *attr;
+
+	if (cfg->num_attrs >= GPIO_V2_LINE_NUM_ATTRS_MAX) {
+		fprintf(stderr, "ERROR : more than %d line attributes\n", GPIO_V2_LINE_NUM_ATTRS_MAX);
+		return NULL;
+	}
+	attr = &cfg->attrs[cfg->num_attrs++];
+	attr->attr.id = id;
+	attr->mask = mask;
+	return attr;
+}
+
+int gpio_config_flags(gpio_config *cfg, __u64 mask, __u64 flags)
+{
+	struct gpio_v2_line_config_attribute *attr;
+
+	attr = config_attr(cfg, mask, GPIO_V2_LINE_ATTR_ID_FLAGS);
+	if (!attr)
+		return -1;
+	attr->attr.flags = flags;
+	return 0;
+}
+
+int gpio_config_outputs(gpio_config *cfg, __u64 mask, __u64 values)
+{
+	struct gpio_v2_line_config_attribute *attr;
+
+	attr = config_attr(cfg, mask, GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES);
+	if (!attr)
+		return -1;
+	attr->attr.values = values;
+	return 0;
+}
+
+int gpio_config_debounce(gpio_config *cfg, __u64 mask, unsigned int period_us)
+{
+	struct gpio_v2_line_config_attribute *attr;
+
+	attr = config_attr(cfg, mask, GPIO_V2_LINE_ATTR_ID_DEBOUNCE);
+	if (!attr)
+		return -1;
+	attr->attr.debounce_period_us = period_us;
+	return 0;
+}
+
+int gpio_lines_request_events(gpio_lines *lines, const char *chip, const unsigned int *offsets,
+			      unsigned int count, const char *consumer, const gpio_config *cfg,
+			      unsigned int event_buffer_size)
+{
+	struct gpio_v2_line_request req;
+	int fd, rv;
+
+	lines->fd = -1;
+	lines->count = 0;
+	if (count == 0 || count > GPIO_V2_LINES_MAX) {
+		fprintf(stderr, "ERROR : invalid number of lines %u\n", count);
+		return -1;
+	}
+
+	fd = open(chip, O_RDWR | O_CLOEXEC);
+	if (fd == -1) {
+		fprintf(stderr, "ERROR : opening port %s, errno:%d\n", chip, errno);
+		return -1;
+	}
+
+	memset(&req, 0, sizeof(req));
+	memcpy(req.offsets, offsets, count * sizeof(offsets[0]));
+	req.num_lines = count;
+	req.config = *cfg;
+	req.event_buffer_size = event_buffer_size;
+	strncpy(req.consumer, consumer, sizeof(req.consumer) - 1);
+
+	//The request fd stays valid once the chip is closed
+	rv = ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req);
+	close(fd);
+	if (rv == -1) {
+		fprintf(stderr, "ERROR : ioctl GPIO_V2_GET_LINE_IOCTL failed for port %s errno:%d\n",
+			chip, errno);
+		return -1;
+	}
+
+	lines->fd = req.fd;
+	lines->count = count;
+	memcpy(lines->offsets, offsets, count * sizeof(offsets[0]));
+	return 0;
+}
+
+int gpio_lines_request(gpio_lines *lines, const char *chip, const unsigned int *offsets,
+		       unsigned int count, const char *consumer, const gpio_config *cfg)
+{
+	return gpio_lines_request_events(lines, chip, offsets, count, consumer, cfg, 0);
+}
+
+int gpio_lines_request_mask(gpio_lines *lines, const char *chip, __u64 offsets,
+			    const char *consumer, const gpio_config *cfg)
+{
+	unsigned int list[GPIO_V2_LINES_MAX], count = 0, offset;
+
+	for (offset = 0; offset < GPIO_V2_LINES_MAX; offset++)
+		if (offsets & (1ULL << offset))
+			list[count++] = offset;
+	return gpio_lines_request(lines, chip, list, count, consumer, cfg);
+}
+
+int gpio_lines_reconfigure(gpio_lines *lines, const gpio_config *cfg)
+{
+	gpio_config copy = *cfg;
+
+	if (ioctl(lines->fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &copy) == -1) {
+		fprintf(stderr, "ERROR : ioctl GPIO_V2_LINE_SET_CONFIG_IOCTL failed errno:%d\n",
+			errno);
+		return -1;
+	}
+	return 0;
+}
+
+void gpio_lines_release(gpio_lines *lines)
+{
+	if (lines->fd >= 0)
+		close(lines->fd);
+	lines->fd = -1;
+	lines->count = 0;
+}
+
+int gpio_lines_set(const gpio_lines *lines, __u64 mask, __u64 bits)
+{
+	struct gpio_v2_line_values values = { .bits = bits, .mask = mask };
+
+	if (ioctl(lines->fd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values) == -1) {
+		fprintf(stderr, "ERROR : ioctl GPIO_V2_LINE_SET_VALUES_IOCTL failed errno:%d\n",
+			errno);
+		return -1;
+	}
+	return 0;
+}
+
+int gpio_lines_get(const gpio_lines *lines, __u64 mask, __u64 *bits)
+{
+	struct gpio_v2_line_values values = { .bits = 0, .mask = mask };
+
+	if (ioctl(lines->fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) == -1) {
+		fprintf(stderr, "ERROR : ioctl GPIO_V2_LINE_GET_VALUES_IOCTL failed errno:%d\n",
+			errno);
+		return -1;
+	}
+	*bits = values.bits & mask;
+	return 0;
+}
+
+int gpio_lines_events(const gpio_lines *lines, struct gpio_v2_line_event *events,
+		      unsigned int max)
+{
+	ssize_t rv;
+
+	rv = read(lines->fd, events, max * sizeof(events[0]));
+	if (rv == -1) {
+		if (errno != EAGAIN && errno != EINTR)
+			fprintf(stderr, "ERROR : reading line events failed errno:%d\n", errno);
+		return -1;
+	}
+	return rv / sizeof(events[0]);
+}
+
+__u64 gpio_lines_pack(const gpio_lines *lines, __u64 offsets)
+{
+	__u64 bits = 0;
+	unsigned int i;
+
+	for (i = 0; i < lines->count; i++)
+		if (lines->offsets[i] < 64 && (offsets & (1ULL << lines->offsets[i])))
+			bits |= 1ULL << i;
+	return bits;
+}
+
+__u64 gpio_lines_unpack(const gpio_lines *lines, __u64 bits)
+{
+	__u64 offsets = 0;
+	unsigned int i;
+
+	for (i = 0; i < lines->count; i++)
+		if ((bits & (1ULL << i)) && lines->offsets[i] < 64)
+			offsets |= 1ULL << lines->offsets[i];
+	return offsets;
+}
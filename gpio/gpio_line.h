@@ -0,0 +1,68 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * GPIO line requests on the character device v2 uAPI. A request holds up
+ * to 64 lines of one chip; values are bitmaps where bit n is the n-th line
+ * of the request, so all of them are driven or sampled with one ioctl.
+ */
+
+#ifndef GPIO_LINE_H
+#define GPIO_LINE_H
+
+#include <linux/gpio.h>
+
+/* Hardware timestamp engine clock, not in headers before Linux 5.19 */
+#define GPIO_LINE_FLAG_EVENT_CLOCK_HTE	(1ULL << 12)
+
+typedef struct {
+	int fd;
+	unsigned int count;
+	unsigned int offsets[GPIO_V2_LINES_MAX];
+} gpio_lines;
+
+/*
+ * Line configuration of a request. flags apply to every line not covered
+ * by an attribute, the helpers add attributes for the lines of mask.
+ */
+typedef struct gpio_v2_line_config gpio_config;
+
+void gpio_config_init(gpio_config *cfg, __u64 flags);
+int gpio_config_flags(gpio_config *cfg, __u64 mask, __u64 flags);
+int gpio_config_outputs(gpio_config *cfg, __u64 mask, __u64 values);
+int gpio_config_debounce(gpio_config *cfg, __u64 mask, unsigned int period_us);
+
+/* Request the count lines at offsets of chip, returns 0 or -1 */
+int gpio_lines_request(gpio_lines *lines, const char *chip, const unsigned int *offsets,
+		       unsigned int count, const char *consumer, const gpio_config *cfg);
+/*
+ * Same with room for event_buffer_size edge events in the kernel, 0 for the
+ * default of 16 per line. Events past a full buffer are dropped, which
+ * shows up as a gap in the event sequence numbers.
+ */
+int gpio_lines_request_events(gpio_lines *lines, const char *chip, const unsigned int *offsets,
+			      unsigned int count, const char *consumer, const gpio_config *cfg,
+			      unsigned int event_buffer_size);
+/* Same with the lines given as a bitmap of chip offsets, in ascending order */
+int gpio_lines_request_mask(gpio_lines *lines, const char *chip, __u64 offsets,
+			    const char *consumer, const gpio_config *cfg);
+int gpio_lines_reconfigure(gpio_lines *lines, const gpio_config *cfg);
+void gpio_lines_release(gpio_lines *lines);
+
+int gpio_lines_set(const gpio_lines *lines, __u64 mask, __u64 bits);
+int gpio_lines_get(const gpio_lines *lines, __u64 mask, __u64 *bits);
+
+/*
+ * Read up to max queued edge events, blocks unless the request fd was made
+ * non-blocking. Returns the number of events or -1.
+ */
+int gpio_lines_events(const gpio_lines *lines, struct gpio_v2_line_event *events,
+		      unsigned int max);
+
+/* Convert between bitmaps of chip offsets and of request lines */
+__u64 gpio_lines_pack(const gpio_lines *lines, __u64 offsets);
+__u64 gpio_lines_unpack(const gpio_lines *lines, __u64 bits);
+
+#endif /* GPIO_LINE_H */
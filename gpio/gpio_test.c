@@ -9,6 +9,14 @@
 #include <unistd.h>
 #include <string.h>
 #include <pthread.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "gpio_line.h"
+#include "irq_bench.h"
+#include "json_report.h"
+#include "reg_map.h"
+#include "toggle_bench.h"
 
 #define PORTA "/dev/gpiochip0"
 #define PORTB "/dev/gpiochip1"
@@ -17,7 +25,6 @@
 
 #define GPIO_PAD_REGISTER 			0x719000
 #define GPIOS_PER_PAD_REGISTER		4
-#define DEFAULT_PAD_REGISTER_VALUE	0x2040810
 
 #define GPIO_0_PULL_UP_BIT			1
 #define GPIO_1_PULL_UP_BIT			7
@@ -39,7 +46,8 @@
 #define GPIO_2_PULL_DOWN_BIT_MASK	(1 << GPIO_2_PULL_DOWN_BIT)
 #define GPIO_3_PULL_DOWN_BIT_MASK	(1 << GPIO_3_PULL_DOWN_BIT)
 
-#define DEVMEM_STR "devmem2 0x%x %c 0x%x"
+/* Pad registers of all four ports, two per port */
+#define GPIO_PAD_REGISTERS_SIZE		0x20
 
 
 char *port_paths[] = {
@@ -49,10 +57,25 @@ char *port_paths[] = {
 	PORTD
 };
 
+/* Set by --json, results are printed as JSON records only */
+static int json_output;
+
+/* Set by --pad-map, NULL maps the pad registers from /dev/mem */
+static const char *pad_map_path;
+
 #define TOTAL_NUM_PORTS (sizeof(port_paths)/sizeof(port_paths[0]))
 #define MAX_GPIOS_PER_PORT 	8
 #define MAX_GPIOS			32
 
+/*
+** Loopback wiring, pin n of ports A and B is connected to pin n + 16 of ports
+** C and D. Pins 0, 1, 16 and 17 are left out as in loopback_long_run_test.
+*/
+#define LOOPBACK_PORTS			(TOTAL_NUM_PORTS/2)
+#define LOOPBACK_SINK_OFFSET	(MAX_GPIOS/2)
+#define DEFAULT_LOOPBACK_PINS	0xfffc
+#define PRBS_STEPS				4096
+
 int port_pull_up_regs_bit_mask[] = {
 	GPIO_0_PULL_UP_BIT_MASK,
 	GPIO_1_PULL_UP_BIT_MASK,
@@ -100,52 +123,28 @@ void print_port_info(char *port_path) {
 void toggle_gpio(char *port_path, unsigned int *led_arr,
 					unsigned int arr_size, int toggle_count) {
 
-	struct gpiohandle_request req;
-	struct gpiohandle_data data;
-	int fd, rv;
-	unsigned int iter = 0;
+	gpio_lines lines;
+	gpio_config cfg;
+	__u64 all, bits = 0;
 
 	if(toggle_count <= 0) {
 		printf("ERROR : provide valid toggle count %d\n", toggle_count);
 		return;
 	}
 
-	fd = open(port_path, O_RDWR);
-	if(fd == -1) {
-		printf("ERROR : opening port %s, errno:%d\n",port_path, errno);
+	gpio_config_init(&cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+	if(gpio_lines_request(&lines, port_path, led_arr, arr_size, "LED_TOGGLER", &cfg) != 0)
 		return;
-	}
-
-	for(iter = 0; iter < arr_size; iter++) {
-		req.lineoffsets[iter] = led_arr[iter];
-		req.default_values[iter] = 0;
-	}
-
-	req.lines = arr_size;
-	req.flags = GPIOHANDLE_REQUEST_OUTPUT;
-	strncpy(req.consumer_label,"LED_TOGGLER",12);
-
-	rv = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIO_GET_LINEHANDLE_IOCTL failed errno:%d\n",errno);
-		return;
-	}
+	all = (arr_size == GPIO_V2_LINES_MAX) ? ~0ULL : (1ULL << arr_size) - 1;
 
 	while ((--toggle_count) >= 0 ) {
 
-		for(iter = 0; iter < arr_size; iter++) {
-			data.values[iter] = !data.values[iter];
-		}
-
-		rv = ioctl(req.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
-		if(rv == -1) {
-			printf("ERROR : ioctl GPIOHANDLE_SET_LINE_VALUES_IOCTL failed errno:%d\n",errno);
-			return;
-		}
+		bits ^= all;
+		if(gpio_lines_set(&lines, all, bits) != 0)
+			break;
 		sleep(1);
 	}
-	close(req.fd);
-	close(fd);
+	gpio_lines_release(&lines);
 }
 
 void toggle_all_gpios(int toggle_count) {
@@ -169,146 +168,29 @@ void toggle_all_gpios(int toggle_count) {
 void print_binary_pattern(char *port_path, unsigned int *led_arr, unsigned int arr_size,
 							unsigned int num) {
 
-	struct gpiohandle_request req;
-	struct gpiohandle_data data;
-	int fd, rv;
-	unsigned int iter = 0;
+	gpio_lines lines;
+	gpio_config cfg;
 	unsigned int pattern = 0;
 
 	printf("INFO : printing binary pattern for number %u\n", num);
 
-	fd = open(port_path, O_RDWR);
-	if(fd == -1) {
-		printf("ERROR : opening port %s, errno:%d\n",port_path, errno);
-		return;
-	}
-
-	for(iter = 0; iter < arr_size; iter++) {
-		req.lineoffsets[iter] = led_arr[iter];
-		req.default_values[iter] = 0;
-	}
-
-	req.lines = arr_size;
-	req.flags = GPIOHANDLE_REQUEST_OUTPUT;
-	strncpy(req.consumer_label,"LED_BINARY_PATTERN",19);
-
-	rv = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIO_GET_LINEHANDLE_IOCTL failed errno:%d\n",errno);
+	gpio_config_init(&cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+	if(gpio_lines_request(&lines, port_path, led_arr, arr_size, "LED_BINARY_PATTERN",
+							&cfg) != 0)
 		return;
-	}
 
 	while (pattern != num) {
 
-		for(iter = 0; iter <arr_size; iter++) {
-			data.values[iter] = pattern & (1UL << iter);
-		}
-
-		rv = ioctl(req.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
-		if(rv == -1) {
-			printf("ERROR : ioctl GPIOHANDLE_SET_LINE_VALUES_IOCTL failed errno:%d\n",errno);
-			return;
-		}
+		/* Bit n of the pattern is shown on led_arr[n] */
+		if(gpio_lines_set(&lines, (1ULL << arr_size) - 1, pattern) != 0)
+			break;
 
 		pattern++;
 		sleep(1);
 	}
-	close(req.fd);
-	close(fd);
+	gpio_lines_release(&lines);
 }
 
-#if 0
-void overnight_test() {
-
-	unsigned int num = 0;
-	struct gpiohandle_request req[TOTAL_NUM_PORTS];
-	struct gpiohandle_data set_data, get_data;
-	int fd[TOTAL_NUM_PORTS], rv;
-	unsigned int iter = 0;
-	unsigned int pattern = 0;
-
-	printf("============ RUNING OVERNIGHT TEST ============\n");
-
-	for(iter = 0; iter < TOTAL_NUM_PORTS; iter++) {
-		unsigned int gpio_iter = 0;
-
-		fd[iter] = open(port_paths[iter], O_RDWR);
-		if(fd[iter] == -1) {
-			printf("ERROR : opening port %s, errno:%d\n", port_paths[iter],
-							errno);
-			return;
-		}
-
-		//Setting all GPIOs of a ports to output mode
-		for(gpio_iter = 0; gpio_iter < MAX_GPIOS_PER_PORT; gpio_iter++) {
-			req[iter].lineoffsets[gpio_iter] = gpio_iter;
-			req[iter].default_values[gpio_iter] = 0;
-		}
-
-		req[iter].lines = MAX_GPIOS_PER_PORT;
-		req[iter].flags = GPIOHANDLE_REQUEST_OUTPUT;
-		snprintf(req[iter].consumer_label, 22, "OVERNIGHT_TEST_PORT_%c",
-							('A' + iter));
-
-		rv = ioctl(fd[iter], GPIO_GET_LINEHANDLE_IOCTL, &(req[iter]));
-		if(rv == -1) {
-			printf("ERROR : ioctl GPIO_GET_LINEHANDLE_IOCTL failed for port %s "
-					"errno:%d\n", port_paths[iter], errno);
-			return;
-		}
-	}
-
-	while(pattern != 0x100) {
-
-		printf("============ PATTERN %d ============ \n", pattern);
-		for(iter = 0; iter < TOTAL_NUM_PORTS; iter++) {
-			unsigned int gpio_iter;
-
-			for(gpio_iter = 0; gpio_iter < MAX_GPIOS_PER_PORT; gpio_iter++) {
-				set_data.values[gpio_iter] = pattern & (1UL << gpio_iter);
-				printf("gpio : %d, set data : %d\n", gpio_iter,
-								set_data.values[gpio_iter]);
-			}
-
-			rv = ioctl(req[iter].fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &set_data);
-			if(rv == -1) {
-				printf("ERROR : ioctl GPIOHANDLE_SET_LINE_VALUES_IOCTL failed for "
-							"iter %d errno:%d\n",iter, errno);
-				return;
-			}
-
-			rv = ioctl(req[iter].fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &get_data);
-			if(rv == -1) {
-				printf("ERROR : ioctl GPIOHANDLE_GET_LINE_VALUES_IOCTL failed for "
-							"iter %d errno:%d\n",iter, errno);
-				return;
-			}
-
-			for(gpio_iter = 0; gpio_iter < MAX_GPIOS_PER_PORT; gpio_iter++) {
-				if((__u8)(set_data.values[gpio_iter]) !=
-								(__u8)(get_data.values[gpio_iter])) {
-					printf("Gpio : %d, set data : %u, get data : %u\n",
-								gpio_iter, (__u8)(set_data.values[gpio_iter]),
-								(__u8)(get_data.values[gpio_iter]));
-					printf("PORT_%c : FAILED\n", ('A' + iter));
-					break;
-				}
-			}
-
-			if(gpio_iter == MAX_GPIOS_PER_PORT) {
-				printf("PORT_%c : PASSED\n", ('A' + iter));
-			}
-		}
-		pattern++;
-	}
-
-	for(iter = 0; iter < TOTAL_NUM_PORTS ;  iter++) {
-		close(req[iter].fd);
-		close(fd[iter]);
-	}
-}
-#endif
-
 void get_chip_and_gpio_number(unsigned int *chip_number,
 				unsigned int *gpio_number) {
 
@@ -347,40 +229,22 @@ void get_chip_and_gpio_number(unsigned int *chip_number,
 unsigned int
 __read_gpio_port(unsigned int chip_number, unsigned int gpio_number) {
 
-	struct gpiohandle_request req;
-	struct gpiohandle_data data;
-	int fd, rv;
+	gpio_lines lines;
+	gpio_config cfg;
+	__u64 bits;
+	int rv;
 
-	fd = open(port_paths[chip_number], O_RDWR);
-	if(fd == -1) {
-		printf("ERROR : opening port %s, errno:%d\n",port_paths[chip_number],
-						errno);
-		return fd;
-	}
-
-	req.lineoffsets[0] = gpio_number;
-	//req.default_values[0] = 0;
-
-	req.lines = 1;
-	req.flags = GPIOHANDLE_REQUEST_INPUT;
-	strncpy(req.consumer_label,"GPIO_READ_PORT",15);
-
-	rv = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIO_GET_LINEHANDLE_IOCTL failed errno:%d\n",errno);
-		return rv;
-	}
+	gpio_config_init(&cfg, GPIO_V2_LINE_FLAG_INPUT);
+	if(gpio_lines_request(&lines, port_paths[chip_number], &gpio_number, 1,
+							"GPIO_READ_PORT", &cfg) != 0)
+		return -1;
 
-	rv = ioctl(req.fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIOHANDLE_GET_LINE_VALUES_IOCTL failed errno:%d\n",errno);
+	rv = gpio_lines_get(&lines, 1, &bits);
+	gpio_lines_release(&lines);
+	if(rv != 0)
 		return rv;
-	}
 
-	close(req.fd);
-	close(fd);
-
-	return (data.values[0]);
+	return bits & 1;
 }
 
 void read_gpio_port() {
@@ -405,39 +269,17 @@ void read_gpio_port() {
 int __write_gpio_port(unsigned int chip_number, unsigned int gpio_number,
 						unsigned int val) {
 
-	struct gpiohandle_request req;
-	struct gpiohandle_data data;
-	int fd, rv;
-
-	fd = open(port_paths[chip_number], O_RDWR);
-	if(fd == -1) {
-		printf("ERROR : opening port %s, errno:%d\n",port_paths[chip_number],
-						errno);
-		return fd;
-	}
-
-	req.lineoffsets[0] = gpio_number;
-	//req.default_values[0] = 0;
-
-	req.lines = 1;
-	req.flags = GPIOHANDLE_REQUEST_OUTPUT;
-	strncpy(req.consumer_label,"GPIO_WRITE_PORT",16);
+	gpio_lines lines;
+	gpio_config cfg;
 
-	rv = ioctl(fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIO_GET_LINEHANDLE_IOCTL failed errno:%d\n",errno);
-		return rv;
-	}
-
-	data.values[0] = val;
-	rv = ioctl(req.fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIOHANDLE_GET_LINE_VALUES_IOCTL failed errno:%d\n",errno);
-		return rv;
-	}
+	/* The value is set with the request, no extra ioctl needed */
+	gpio_config_init(&cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+	gpio_config_outputs(&cfg, 1, !!val);
+	if(gpio_lines_request(&lines, port_paths[chip_number], &gpio_number, 1,
+							"GPIO_WRITE_PORT", &cfg) != 0)
+		return -1;
 
-	close(req.fd);
-	close(fd);
+	gpio_lines_release(&lines);
 
 	return 0;
 
@@ -468,6 +310,19 @@ void write_gpio_port() {
 
 }
 
+enum pad_pull {
+	PAD_PULL_NONE,
+	PAD_PULL_UP,
+	PAD_PULL_DOWN,
+	PAD_PULL_KEEP
+};
+
+const char *pad_pull_names[] = {
+	"none",
+	"up",
+	"down"
+};
+
 /*
 ** PAD register starts at 0x719000
 ** PORT A pad registers are 0x719000 and 0x719004
@@ -475,106 +330,200 @@ void write_gpio_port() {
 ** PORT C pad registers are 0x719010 and 0x719014
 ** PORT D pad registers are 0x719018 and 0x71901c
 */
-void pull_up_gpio_port () {
+static unsigned int pad_register_offset(unsigned int pin) {
 
-	unsigned int chip_number = -1;
-	unsigned int gpio_number = -1;
-	int ret = 0;
-	char cmd[100];
+	return (pin / MAX_GPIOS_PER_PORT) * MAX_GPIOS_PER_PORT +
+			((pin % MAX_GPIOS_PER_PORT) / GPIOS_PER_PAD_REGISTER) * GPIOS_PER_PAD_REGISTER;
+}
 
-	get_chip_and_gpio_number(&chip_number, &gpio_number);
-	printf("INFO : Pulling up gpio %u from chip %u\n", gpio_number, chip_number);
-
-	ret = sprintf(cmd, DEVMEM_STR,
-			GPIO_PAD_REGISTER + (chip_number*MAX_GPIOS_PER_PORT) +
-			((gpio_number/GPIOS_PER_PAD_REGISTER)*GPIOS_PER_PAD_REGISTER), 'w',
-			(port_pull_up_regs_bit_mask[gpio_number%GPIOS_PER_PAD_REGISTER] |
-					DEFAULT_PAD_REGISTER_VALUE));
-	if(ret <= 0) {
-		printf("ERROR : command is not valid\n");
-		return;
+/*
+** Set the pull of every pin to pull[pin], pins set to PAD_PULL_KEEP are left
+** alone. The pad registers are mapped once and each one is read, modified and
+** written once for all of its pins, so the other pins keep their setting.
+*/
+int configure_pads(const enum pad_pull *pull) {
+
+	unsigned int reg, pin, bit;
+	uint32_t clear, set, before, after;
+	json_record rec;
+	reg_map map;
+
+	if(reg_map_open(&map, pad_map_path, GPIO_PAD_REGISTER, GPIO_PAD_REGISTERS_SIZE) != 0)
+		return -1;
+
+	//Under --json the register changes are a record, so stdout stays parseable
+	if(json_output) {
+		json_begin(&rec, stdout, "gpio_test", "pad_config");
+		json_array_begin(&rec, "registers");
 	}
 
-	printf("INFO : command = %s\n", cmd);
+	for(reg = 0; reg < GPIO_PAD_REGISTERS_SIZE; reg += sizeof(uint32_t)) {
+		clear = 0;
+		set = 0;
+		for(pin = 0; pin < MAX_GPIOS; pin++) {
+			if(pad_register_offset(pin) != reg || pull[pin] == PAD_PULL_KEEP)
+				continue;
+
+			bit = pin % GPIOS_PER_PAD_REGISTER;
+			clear |= port_pull_up_regs_bit_mask[bit] | port_pull_down_regs_bit_mask[bit];
+			if(pull[pin] == PAD_PULL_UP)
+				set |= port_pull_up_regs_bit_mask[bit];
+			else if(pull[pin] == PAD_PULL_DOWN)
+				set |= port_pull_down_regs_bit_mask[bit];
+		}
+		if(!clear)
+			continue;
 
-	ret = system(cmd);
-	printf("INFO : ret %d\n",ret);
+		before = reg_read32(&map, reg);
+		after = reg_update32(&map, reg, clear, set);
+		if(json_output) {
+			json_object_begin(&rec, NULL);
+			json_uint(&rec, "register", GPIO_PAD_REGISTER + reg);
+			json_uint(&rec, "before", before);
+			json_uint(&rec, "after", after);
+			json_object_end(&rec);
+		} else {
+			printf("INFO : pad register 0x%x : 0x%08x -> 0x%08x\n", GPIO_PAD_REGISTER + reg,
+							before, after);
+		}
+	}
 
+	if(json_output) {
+		json_array_end(&rec);
+		json_string(&rec, "status", "pass");
+		json_end(&rec);
+	}
+	reg_map_close(&map);
+	return 0;
 }
 
-void pull_down_gpio_port () {
+static int pull_gpio_port(enum pad_pull mode) {
 
+	enum pad_pull pull[MAX_GPIOS];
 	unsigned int chip_number = -1;
 	unsigned int gpio_number = -1;
-	int ret = 0;
-	char cmd[100];
+	unsigned int pin;
 
 	get_chip_and_gpio_number(&chip_number, &gpio_number);
-	printf("INFO : Pulling down gpio %u from chip %u\n", gpio_number, chip_number);
-
-	ret = sprintf(cmd, DEVMEM_STR,
-			GPIO_PAD_REGISTER + (chip_number*MAX_GPIOS_PER_PORT) +
-			((gpio_number/GPIOS_PER_PAD_REGISTER)*GPIOS_PER_PAD_REGISTER), 'w',
-			(port_pull_down_regs_bit_mask[gpio_number%GPIOS_PER_PAD_REGISTER] |
-					DEFAULT_PAD_REGISTER_VALUE));
-	if(ret <= 0) {
-		printf("ERROR : command is not valid\n");
-		return;
-	}
+	printf("INFO : Pulling %s gpio %u from chip %u\n", pad_pull_names[mode], gpio_number,
+					chip_number);
 
-	printf("INFO : command = %s\n", cmd);
+	for(pin = 0; pin < MAX_GPIOS; pin++)
+		pull[pin] = PAD_PULL_KEEP;
+	pull[chip_number * MAX_GPIOS_PER_PORT + gpio_number] = mode;
 
-	ret = system(cmd);
-	printf("INFO : ret %d\n",ret);
+	return configure_pads(pull);
 }
 
-void __loopback_test(unsigned int source_chip_number,
-						unsigned int source_gpio_number,
-						unsigned int sink_chip_number,
-						unsigned int sink_gpio_number) {
+void pull_up_gpio_port () {
 
-	int write_val = 0;;
-	int read_val = -1;
+	pull_gpio_port(PAD_PULL_UP);
+}
 
-	printf("===== %d,%d <-------> %u,%u =====\n",
-									source_chip_number, source_gpio_number,
-									sink_chip_number, sink_gpio_number);
-	printf("INFO : Writing %u to source loopback\n", write_val);
-	__write_gpio_port(source_chip_number, source_gpio_number, write_val);
-	read_val = __read_gpio_port(sink_chip_number, sink_gpio_number);
-	if(read_val != write_val) {
-		printf("ERROR: XXXXXXXXXXXXXXXXXXX FAIL XXXXXXXXXXXXXXXXXXXXX\n");
-		printf("written val is %u, read val is %u\n", write_val, read_val);
-		exit(0);
-	}
+void pull_down_gpio_port () {
 
-	printf("INFO : Writing %u to sink loopback\n", write_val);
-	__write_gpio_port(sink_chip_number, sink_gpio_number, write_val);
-	read_val = __read_gpio_port(source_chip_number, source_gpio_number);
-	if(read_val != write_val) {
-		printf("ERROR : XXXXXXXXXXXXXXXXXXX FAIL XXXXXXXXXXXXXXXXXXXXX\n");
-		printf("written val is %u, read val is %u\n", write_val, read_val);
-		exit(0);
+	pull_gpio_port(PAD_PULL_DOWN);
+}
+
+/*
+** Parse PIN:MODE[,PIN:MODE...] into pull, PIN may be all. Returns 0 or -1.
+*/
+static int parse_pulls(char *arg, enum pad_pull *pull) {
+
+	unsigned int pin, mode, first, last;
+	char *item, *colon, *end;
+
+	for(item = strtok(arg, ","); item; item = strtok(NULL, ",")) {
+		colon = strchr(item, ':');
+		if(!colon)
+			return -1;
+		*colon = '\0';
+
+		for(mode = 0; mode < PAD_PULL_KEEP; mode++) {
+			if(!strcmp(colon + 1, pad_pull_names[mode]))
+				break;
+		}
+		if(mode == PAD_PULL_KEEP)
+			return -1;
+
+		if(!strcmp(item, "all")) {
+			first = 0;
+			last = MAX_GPIOS - 1;
+		} else {
+			first = last = strtoul(item, &end, 10);
+			if(end == item || *end || first >= MAX_GPIOS)
+				return -1;
+		}
+		for(pin = first; pin <= last; pin++)
+			pull[pin] = mode;
 	}
+	return 0;
+}
+
+#define LOOPBACK_MISMATCH	-1
+#define LOOPBACK_IO_ERROR	-2
+
+/*
+** Write val on one end of a loopback and read it back on the other end,
+** returns 0 when they match, LOOPBACK_MISMATCH when they differ and
+** LOOPBACK_IO_ERROR when a line could not be driven or read
+*/
+static int loopback_step(unsigned int write_chip_number, unsigned int write_gpio_number,
+						unsigned int read_chip_number, unsigned int read_gpio_number,
+						int write_val, const char *end) {
+
+	int read_val = -1;
 
-	write_val = write_val ^ 0x1;
-	printf("INFO : Writing %u to source loopback\n", write_val);
-	__write_gpio_port(source_chip_number, source_gpio_number, write_val);
-	read_val = __read_gpio_port(sink_chip_number, sink_gpio_number);
+	if(!json_output)
+		printf("INFO : Writing %u to %s loopback\n", write_val, end);
+	if(__write_gpio_port(write_chip_number, write_gpio_number, write_val) != 0) {
+		fprintf(stderr, "ERROR : driving %u,%u failed\n", write_chip_number, write_gpio_number);
+		return LOOPBACK_IO_ERROR;
+	}
+	read_val = __read_gpio_port(read_chip_number, read_gpio_number);
+	if(read_val < 0) {
+		fprintf(stderr, "ERROR : reading %u,%u failed\n", read_chip_number, read_gpio_number);
+		return LOOPBACK_IO_ERROR;
+	}
 	if(read_val != write_val) {
-		printf("ERROR: XXXXXXXXXXXXXXXXXXX FAIL XXXXXXXXXXXXXXXXXXXXX\n");
-		printf("written val is %u, read val is %u\n", write_val, read_val);
-		exit(0);
+		if(!json_output) {
+			printf("ERROR: XXXXXXXXXXXXXXXXXXX FAIL XXXXXXXXXXXXXXXXXXXXX\n");
+			printf("written val is %u, read val is %u\n", write_val, read_val);
+		}
+		return LOOPBACK_MISMATCH;
 	}
 
-	printf("INFO : Writing %u to sink loopback\n", write_val);
-	__write_gpio_port(sink_chip_number, sink_gpio_number, write_val);
-	read_val = __read_gpio_port(source_chip_number, source_gpio_number);
-	if(read_val != write_val) {
-		printf("ERROR : XXXXXXXXXXXXXXXXXXX FAIL XXXXXXXXXXXXXXXXXXXXX\n");
-		printf("written val is %u, read val is %u\n", write_val, read_val);
-		exit(0);
+	return 0;
+}
+
+/*
+** Drive 0 and then 1 through the loopback in both directions, returns the
+** loopback_step() error of the first step that fails
+*/
+int __loopback_test(unsigned int source_chip_number,
+						unsigned int source_gpio_number,
+						unsigned int sink_chip_number,
+						unsigned int sink_gpio_number) {
+
+	int write_val = 0, rv;
+
+	if(!json_output)
+		printf("===== %d,%d <-------> %u,%u =====\n",
+										source_chip_number, source_gpio_number,
+										sink_chip_number, sink_gpio_number);
+
+	for(write_val = 0; write_val <= 1; write_val++) {
+		rv = loopback_step(source_chip_number, source_gpio_number, sink_chip_number,
+						sink_gpio_number, write_val, "source");
+		if(rv != 0)
+			return rv;
+		rv = loopback_step(sink_chip_number, sink_gpio_number, source_chip_number,
+						source_gpio_number, write_val, "sink");
+		if(rv != 0)
+			return rv;
 	}
+
+	return 0;
 }
 
 void loopback_test() {
@@ -590,91 +539,495 @@ void loopback_test() {
 	printf("INFO : Enter LOOPBACK sink details\n");
 	get_chip_and_gpio_number(&sink_chip_number, &sink_gpio_number);
 
-	__loopback_test(source_chip_number, source_gpio_number, sink_chip_number,
-						sink_gpio_number);
+	if(__loopback_test(source_chip_number, source_gpio_number, sink_chip_number,
+						sink_gpio_number) != 0)
+		exit(0);
 }
 
+
+enum loopback_pattern {
+	LOOPBACK_WALK,
+	LOOPBACK_VALUES,
+	LOOPBACK_PRBS,
+	LOOPBACK_PATTERNS
+};
+
+const char *loopback_pattern_names[] = {
+	"walk",
+	"values",
+	"prbs"
+};
+
 /*
-** Skipping gpio 17 and 18 because of the hw fault, and because of how the test
-** is laid out skipping gpio 0  and 1
+** State of the batched loopback engine. Every port is requested once as a
+** multi-line request, a step drives the 16 source pins with one set ioctl per
+** source port and samples them with one get ioctl per sink port.
 */
-void loopback_long_run_test() {
+struct loopback_engine {
+	unsigned int pins;			/* Source pins, bit n is pin n */
+	int self;					/* Read the source lines back instead of the sinks */
+	int reverse;				/* Drive ports C and D, sample ports A and B */
+	gpio_lines out[TOTAL_NUM_PORTS];
+	gpio_lines in[TOTAL_NUM_PORTS];
+	unsigned int prev;			/* Last word driven, to count transitions */
+	unsigned long steps;
+	unsigned long transitions;
+	unsigned long failures[MAX_GPIOS];	/* Mismatches per sampled pin */
+	double seconds;
+};
 
-	unsigned int source = 2;
-	unsigned int sink = (MAX_GPIOS/2) + 2;
+static unsigned int port_mask(const struct loopback_engine *lb, unsigned int port) {
 
-	while(1) {
-		if(sink == MAX_GPIOS) {
-			source = 2;
-			sink = (MAX_GPIOS/2) + 2;
-		}
+	return (lb->pins >> ((port % LOOPBACK_PORTS) * MAX_GPIOS_PER_PORT)) & 0xff;
+}
+
+static void loopback_release(struct loopback_engine *lb) {
+
+	unsigned int port;
 
-		__loopback_test((source/8), (source%8), (sink/8), (sink%8));
-		source++;
-		sink++;
+	for(port = 0; port < TOTAL_NUM_PORTS; port++) {
+		gpio_lines_release(&lb->out[port]);
+		gpio_lines_release(&lb->in[port]);
 	}
 }
 
-#if 0
-void *event_thread(void *arg) {
+/*
+** Request the driving ports as outputs and the sampling ports as inputs for
+** the current direction. With self the output lines are read back.
+*/
+static int loopback_request(struct loopback_engine *lb) {
+
+	unsigned int iter, out, in;
+	gpio_config out_cfg, in_cfg;
+
+	loopback_release(lb);
+	gpio_config_init(&out_cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+	gpio_config_init(&in_cfg, GPIO_V2_LINE_FLAG_INPUT);
+	for(iter = 0; iter < LOOPBACK_PORTS; iter++) {
+		out = lb->reverse ? iter + LOOPBACK_PORTS : iter;
+		in = lb->reverse ? iter : iter + LOOPBACK_PORTS;
+		if(!port_mask(lb, iter))
+			continue;
 
-	struct gpioevent_request *event_req = (struct gpioevent_request *)arg;
-	char *ret;
-	struct gpioevent_data  event;
+		if(gpio_lines_request_mask(&lb->out[out], port_paths[out], port_mask(lb, iter),
+									"GPIO_LOOPBACK_OUT", &out_cfg) != 0)
+			return -1;
+		if(lb->self)
+			continue;
+		if(gpio_lines_request_mask(&lb->in[in], port_paths[in], port_mask(lb, iter),
+									"GPIO_LOOPBACK_IN", &in_cfg) != 0)
+			return -1;
+	}
+	lb->prev = 0;
+	return 0;
+}
 
-	while(1) {
-		printf("INFO : waiting for event\n");
-		int rc = read(event_req->fd, &event, sizeof(event));
+/*
+** Drive word on the source pins and compare what the sinks see, returns the
+** number of mismatching pins or -1 on an ioctl error
+*/
+static int loopback_drive(struct loopback_engine *lb, unsigned int word) {
 
-		printf("GPIO_EVENT : timestamp %llu\n", event.timestamp);
+	unsigned int iter, out, in, mask, expected, diff, gpio_iter;
+	const gpio_lines *sample;
+	int mismatches = 0;
+	__u64 got;
+
+	word &= lb->pins;
+	for(iter = 0; iter < LOOPBACK_PORTS; iter++) {
+		out = lb->reverse ? iter + LOOPBACK_PORTS : iter;
+		if(!port_mask(lb, iter))
+			continue;
+		if(gpio_lines_set(&lb->out[out], (1ULL << lb->out[out].count) - 1,
+				gpio_lines_pack(&lb->out[out], word >> (iter * MAX_GPIOS_PER_PORT))) != 0)
+			return -1;
 	}
-	close(event_req->fd);
 
-#if 0
-		if ((ret = (char*) malloc(20)) == NULL) {
-			perror("malloc() error");
-			exit(2);
+	for(iter = 0; iter < LOOPBACK_PORTS; iter++) {
+		out = lb->reverse ? iter + LOOPBACK_PORTS : iter;
+		in = lb->self ? out : (lb->reverse ? iter : iter + LOOPBACK_PORTS);
+		sample = lb->self ? &lb->out[out] : &lb->in[in];
+		mask = port_mask(lb, iter);
+		if(!mask)
+			continue;
+
+		if(gpio_lines_get(sample, (1ULL << sample->count) - 1, &got) != 0)
+			return -1;
+		got = gpio_lines_unpack(sample, got);
+		expected = (word >> (iter * MAX_GPIOS_PER_PORT)) & mask;
+		diff = (got ^ expected) & mask;
+		for(gpio_iter = 0; diff && gpio_iter < MAX_GPIOS_PER_PORT; gpio_iter++) {
+			if(diff & (1U << gpio_iter)) {
+				lb->failures[in * MAX_GPIOS_PER_PORT + gpio_iter]++;
+				mismatches++;
+			}
 		}
-		strcpy(ret, "This is a test");
-#endif
-	pthread_exit(ret);
+	}
+
+	lb->transitions += __builtin_popcount(word ^ lb->prev);
+	lb->prev = word;
+	lb->steps++;
+	return mismatches;
 }
 
+/*
+** PRBS-31 (x^31 + x^28 + 1), advanced by 16 bits per step
+*/
+static unsigned int prbs_next(unsigned int *state) {
 
-void interrupt_test() {
+	unsigned int iter, bit, word = 0;
 
-	pthread_t tid;
-	struct gpioevent_request event_req;
-	struct gpiohandle_data data;
-	int fd, rv;
-  	void *ret;
+	for(iter = 0; iter < 16; iter++) {
+		bit = ((*state >> 30) ^ (*state >> 27)) & 1;
+		*state = ((*state << 1) | bit) & 0x7fffffff;
+		word = (word << 1) | bit;
+	}
+	return word;
+}
 
-	fd = open(port_paths[0], O_RDWR);
-	if(fd == -1) {
-		printf("ERROR : opening port %s, errno:%d\n",port_paths[0],
-						errno);
-		return;
+/*
+** Run one pattern in the current direction, returns the number of failed
+** steps or -1 on an ioctl error
+*/
+static long loopback_pattern(struct loopback_engine *lb, enum loopback_pattern pattern) {
+
+	unsigned int iter, word, state = 0x7fffffff;
+	long failed = 0;
+	int rv;
+
+	switch(pattern) {
+		case LOOPBACK_WALK:
+			/* Walking one, then walking zero */
+			for(iter = 0; iter < 2 * LOOPBACK_SINK_OFFSET; iter++) {
+				word = 1U << (iter % LOOPBACK_SINK_OFFSET);
+				if(iter >= LOOPBACK_SINK_OFFSET)
+					word = ~word;
+				if(!(lb->pins & (1U << (iter % LOOPBACK_SINK_OFFSET))))
+					continue;
+				rv = loopback_drive(lb, word);
+				if(rv < 0)
+					return -1;
+				failed += rv != 0;
+			}
+			break;
+		case LOOPBACK_VALUES:
+			/* Every value on port A with its complement on port B */
+			for(iter = 0; iter < 256; iter++) {
+				rv = loopback_drive(lb, iter | ((~iter & 0xff) << MAX_GPIOS_PER_PORT));
+				if(rv < 0)
+					return -1;
+				failed += rv != 0;
+			}
+			break;
+		case LOOPBACK_PRBS:
+			for(iter = 0; iter < PRBS_STEPS; iter++) {
+				rv = loopback_drive(lb, prbs_next(&state));
+				if(rv < 0)
+					return -1;
+				failed += rv != 0;
+			}
+			break;
+		default:
+			return -1;
 	}
 
-	event_req.lineoffset = 3;
-	event_req.handleflags = GPIOHANDLE_REQUEST_INPUT;
-	event_req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
-	strncpy(event_req.consumer_label,"GPIO_INTERRUPT",13);
+	return failed;
+}
 
-	rv = ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &event_req);
-	if(rv == -1) {
-		printf("ERROR : ioctl GPIO_GET_LINEEVENT_IOCTL failed errno:%d\n",errno);
+/*
+** Run the patterns of mask (bit per enum loopback_pattern) passes times in
+** both directions, or only forward with self. Returns the number of failed
+** steps or -1 if the lines could not be driven.
+*/
+long loopback_engine_run(struct loopback_engine *lb, unsigned int patterns,
+							unsigned int passes) {
+
+	struct timespec start, end;
+	unsigned int pass, pattern;
+	long failed = 0, rv;
+
+	for(lb->reverse = 0; lb->reverse <= !lb->self; lb->reverse++) {
+		if(loopback_request(lb) != 0) {
+			loopback_release(lb);
+			return -1;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for(pass = 0; pass < passes; pass++) {
+			for(pattern = 0; pattern < LOOPBACK_PATTERNS; pattern++) {
+				if(!(patterns & (1U << pattern)))
+					continue;
+				rv = loopback_pattern(lb, pattern);
+				if(rv < 0) {
+					loopback_release(lb);
+					return -1;
+				}
+				failed += rv;
+			}
+		}
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		lb->seconds += (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	}
+	lb->reverse = 0;
+	loopback_release(lb);
+
+	return failed;
+}
+
+void loopback_engine_init(struct loopback_engine *lb, unsigned int pins, int self) {
+
+	unsigned int port;
+
+	memset(lb, 0, sizeof(*lb));
+	lb->pins = pins & ((1U << LOOPBACK_SINK_OFFSET) - 1);
+	lb->self = self;
+	for(port = 0; port < TOTAL_NUM_PORTS; port++) {
+		lb->out[port].fd = -1;
+		lb->in[port].fd = -1;
+	}
+}
+
+/*
+** Pin partner of a sampled pin, the pin that drove it
+*/
+static unsigned int loopback_partner(const struct loopback_engine *lb, unsigned int pin) {
+
+	if(lb->self)
+		return pin;
+	return pin >= LOOPBACK_SINK_OFFSET ? pin - LOOPBACK_SINK_OFFSET : pin + LOOPBACK_SINK_OFFSET;
+}
+
+void loopback_engine_report(const struct loopback_engine *lb, unsigned int patterns,
+							unsigned int passes, long failed) {
+
+	double rate = lb->seconds > 0 ? lb->transitions / lb->seconds : 0;
+	unsigned int pattern, pin;
+	json_record rec;
+
+	if(json_output) {
+		json_begin(&rec, stdout, "gpio_test", "loopback_engine");
+		json_object_begin(&rec, "params");
+		json_uint(&rec, "pins", lb->pins);
+		json_bool(&rec, "self", lb->self);
+		json_uint(&rec, "passes", passes);
+		json_array_begin(&rec, "patterns");
+		for(pattern = 0; pattern < LOOPBACK_PATTERNS; pattern++) {
+			if(patterns & (1U << pattern))
+				json_string(&rec, NULL, loopback_pattern_names[pattern]);
+		}
+		json_array_end(&rec);
+		json_object_end(&rec);
+		json_double(&rec, "duration_s", lb->seconds);
+		json_uint(&rec, "steps", lb->steps);
+		json_uint(&rec, "transitions", lb->transitions);
+		json_double(&rec, "transitions_per_s", rate);
+		json_object_begin(&rec, "pin_failures");
+		for(pin = 0; pin < MAX_GPIOS; pin++) {
+			char key[8];
+
+			if(!lb->failures[pin])
+				continue;
+			snprintf(key, sizeof(key), "%u", pin);
+			json_uint(&rec, key, lb->failures[pin]);
+		}
+		json_object_end(&rec);
+		json_int(&rec, "errors", failed < 0 ? 1 : failed);
+		json_string(&rec, "status", failed ? "fail" : "pass");
+		json_end(&rec);
 		return;
 	}
 
-	if (pthread_create(&tid, NULL, event_thread, &event_req) != 0) {
-		printf("ERROR : pthread_create() failed");
-		exit(1);
+	if(failed < 0) {
+		printf("ERROR : loopback could not drive the lines\n");
+		return;
+	}
+	printf("INFO : %lu steps, %lu transitions in %.3fs, %.0f transitions/s, %.0f steps/s\n",
+				lb->steps, lb->transitions, lb->seconds, rate,
+				lb->seconds > 0 ? lb->steps / lb->seconds : 0);
+	for(pin = 0; pin < MAX_GPIOS; pin++) {
+		if(lb->failures[pin])
+			printf("ERROR : pin %u (driven by %u) failed %lu times\n", pin,
+						loopback_partner(lb, pin), lb->failures[pin]);
 	}
+	printf("%s : %ld of %lu steps failed\n", failed ? "FAILED" : "PASSED", failed, lb->steps);
+}
+
+/*
+** Skipping gpio 17 and 18 because of the hw fault, and because of how the test
+** is laid out skipping gpio 0  and 1. Runs every pattern on all pairs at once
+** until a pass fails.
+*/
+void loopback_long_run_test() {
 
-	//close(fd);
+	struct loopback_engine lb;
+	unsigned long pass = 0;
+	long failed;
+
+	while(1) {
+		loopback_engine_init(&lb, DEFAULT_LOOPBACK_PINS, 0);
+		failed = loopback_engine_run(&lb, (1U << LOOPBACK_PATTERNS) - 1, 1);
+		printf("===== pass %lu =====\n", ++pass);
+		loopback_engine_report(&lb, (1U << LOOPBACK_PATTERNS) - 1, 1, failed);
+		if(failed != 0)
+			exit(0);
+	}
+}
+
+/*
+** Non-interactive loopback of one pin pair for scripts, pins are numbered
+** chip * 8 + gpio. Returns the number of failed iterations, mismatches and
+** I/O errors alike.
+*/
+unsigned int loopback_pair(unsigned int source, unsigned int sink,
+						unsigned int iterations) {
+
+	struct timespec start, end;
+	unsigned int iter, errors = 0, io_errors = 0;
+	double duration;
+	json_record rec;
+	int rv;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(iter = 0; iter < iterations; iter++) {
+		rv = __loopback_test((source/8), (source%8), (sink/8), (sink%8));
+		if(rv == LOOPBACK_IO_ERROR)
+			io_errors++;
+		else if(rv != 0)
+			errors++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	duration = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+	if(json_output) {
+		json_begin(&rec, stdout, "gpio_test", "loopback");
+		json_object_begin(&rec, "params");
+		json_uint(&rec, "source", source);
+		json_uint(&rec, "sink", sink);
+		json_uint(&rec, "iterations", iterations);
+		json_object_end(&rec);
+		json_double(&rec, "duration_s", duration);
+		/* Every iteration drives 0 and 1 in both directions */
+		json_uint(&rec, "transitions", iterations * 4UL);
+		json_uint(&rec, "mismatches", errors);
+		json_uint(&rec, "io_errors", io_errors);
+		json_uint(&rec, "errors", errors + io_errors);
+		json_string(&rec, "status", errors || io_errors ? "fail" : "pass");
+		json_end(&rec);
+	} else {
+		printf("INFO : loopback %u <-> %u, %u of %u iterations failed in %.3fs, %u on I/O errors\n",
+						source, sink, errors + io_errors, iterations, duration, io_errors);
+	}
+
+	return errors + io_errors;
+}
+
+const char *event_clock_names[] = {
+	"monotonic",
+	"realtime",
+	"hte"
+};
+
+__u64 event_clock_flags[] = {
+	0,
+	GPIO_V2_LINE_FLAG_EVENT_CLOCK_REALTIME,
+	GPIO_LINE_FLAG_EVENT_CLOCK_HTE
+};
+
+#define EVENT_BATCH		16
+
+/*
+** Print the edge events of one gpio with their kernel timestamp and sequence
+** numbers, count events or forever with 0. Under --json every event is a
+** record and a summary record follows. Returns the number of events lost, or
+** -1 if the events could not be read.
+*/
+int watch_gpio_events(unsigned int chip_number, unsigned int gpio_number,
+						unsigned int debounce_us, unsigned int clock,
+						unsigned int count) {
+
+	struct gpio_v2_line_event events[EVENT_BATCH];
+	gpio_lines lines;
+	gpio_config cfg;
+	json_record rec;
+	unsigned int seen = 0, last_seqno = 0, lost = 0;
+	int rv, iter, failed = 0;
+
+	gpio_config_init(&cfg, GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+						GPIO_V2_LINE_FLAG_EDGE_FALLING | event_clock_flags[clock]);
+	if(debounce_us)
+		gpio_config_debounce(&cfg, 1, debounce_us);
+	if(gpio_lines_request(&lines, port_paths[chip_number], &gpio_number, 1,
+							"GPIO_INTERRUPT", &cfg) != 0)
+		return -1;
+
+	fprintf(json_output ? stderr : stdout, "INFO : waiting for events on gpio %u of chip %u\n",
+					gpio_number, chip_number);
+	while(count == 0 || seen < count) {
+		rv = gpio_lines_events(&lines, events, EVENT_BATCH);
+		if(rv < 0 && errno == EINTR)
+			continue;
+		/* A dead event fd must not end the watch as a pass */
+		if(rv <= 0) {
+			fprintf(stderr, "ERROR : reading events of gpio %u of chip %u failed\n",
+							gpio_number, chip_number);
+			failed = 1;
+			break;
+		}
+
+		for(iter = 0; iter < rv; iter++) {
+			/* Sequence numbers start at 1, gaps are events the kernel dropped */
+			if(events[iter].seqno != last_seqno + 1) {
+				if(!json_output)
+					printf("WARN : %u events lost\n", events[iter].seqno - last_seqno - 1);
+				lost += events[iter].seqno - last_seqno - 1;
+			}
+			last_seqno = events[iter].seqno;
+			if(json_output) {
+				json_begin(&rec, stdout, "gpio_test", "event");
+				json_string(&rec, "edge",
+						events[iter].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? "rising" : "falling");
+				json_uint(&rec, "timestamp_ns", events[iter].timestamp_ns);
+				json_string(&rec, "clock", event_clock_names[clock]);
+				json_uint(&rec, "seqno", events[iter].seqno);
+				json_end(&rec);
+			} else {
+				printf("GPIO_EVENT : %s, timestamp %llu (%s), seqno %u\n",
+						events[iter].id == GPIO_V2_LINE_EVENT_RISING_EDGE ? "rising" : "falling",
+						events[iter].timestamp_ns, event_clock_names[clock],
+						events[iter].seqno);
+			}
+		}
+		seen += rv;
+	}
+	gpio_lines_release(&lines);
+
+	if(json_output) {
+		json_begin(&rec, stdout, "gpio_test", "events");
+		json_object_begin(&rec, "params");
+		json_uint(&rec, "chip", chip_number);
+		json_uint(&rec, "pin", gpio_number);
+		json_uint(&rec, "debounce_us", debounce_us);
+		json_string(&rec, "clock", event_clock_names[clock]);
+		json_uint(&rec, "count", count);
+		json_object_end(&rec);
+		json_uint(&rec, "events", seen);
+		json_uint(&rec, "lost", lost);
+		json_uint(&rec, "errors", lost + failed);
+		json_string(&rec, "status", lost || failed ? "fail" : "pass");
+		json_end(&rec);
+	}
+
+	return failed ? -1 : (int)lost;
+}
+
+void interrupt_test() {
+
+	unsigned int chip_number = -1;
+	unsigned int gpio_number = -1;
+
+	get_chip_and_gpio_number(&chip_number, &gpio_number);
+	watch_gpio_events(chip_number, gpio_number, 0, 0, 10);
 }
-#endif
 
 void print_menu() {
 
@@ -691,15 +1044,307 @@ void print_menu() {
 	printf("\t 8. Pull up GPIO PORT\n");
 	printf("\t 9. Pull down GPIO PORT\n");
 	printf("\t 10. Toggle all GPIOs\n");
-	//printf("\t 11. Interrupt Test\n");
+	printf("\t 11. Interrupt Test\n");
 	printf("\t 0. Quit\n");
 }
 
-int main() {
+/*
+** Parse a pin pair SRC:SINK, pins are numbered chip * 8 + gpio
+*/
+static int parse_pin_pair(const char *arg, unsigned int *first, unsigned int *second) {
+
+	char *end;
+
+	*first = strtoul(arg, &end, 10);
+	if(end == arg || *end != ':')
+		return -1;
+	*second = strtoul(end + 1, &end, 10);
+	if(*end || *first >= MAX_GPIOS || *second >= MAX_GPIOS)
+		return -1;
+	return 0;
+}
+
+/*
+** Interrupt latency and edge rate of the loopback from pin out to pin in
+*/
+int irq_benchmark(irq_bench_config *cfg, unsigned int out, unsigned int in) {
+
+	static irq_bench_result res;
+	int rv = 0;
+
+	cfg->out_chip = port_paths[out / MAX_GPIOS_PER_PORT];
+	cfg->out_offset = out % MAX_GPIOS_PER_PORT;
+	cfg->in_chip = port_paths[in / MAX_GPIOS_PER_PORT];
+	cfg->in_offset = in % MAX_GPIOS_PER_PORT;
+
+	memset(&res, 0, sizeof(res));
+	if(cfg->samples && irq_bench_latency(cfg, &res) != 0)
+		rv = -1;
+	if(rv == 0 && cfg->burst && irq_bench_rate(cfg, &res) != 0)
+		rv = -1;
+
+	if(json_output)
+		irq_bench_json(cfg, &res, stdout);
+	else
+		irq_bench_report(cfg, &res, stdout);
+
+	if(rv != 0 || (cfg->samples && !irq_bench_latency_passed(&res)) ||
+	   (cfg->burst && !irq_bench_rate_passed(&res)))
+		return -1;
+	return 0;
+}
+
+/*
+** Toggle the pins of cfg as fast as possible or at cfg->frequency
+*/
+int toggle_benchmark(toggle_bench_config *cfg) {
+
+	static toggle_bench_result res;
+	unsigned int port;
+	int rv;
+
+	for(port = 0; port < TOTAL_NUM_PORTS; port++)
+		cfg->chips[port] = port_paths[port];
+
+	rv = toggle_bench_run(cfg, &res);
+	if(json_output)
+		toggle_bench_json(cfg, &res, stdout);
+	else
+		toggle_bench_report(cfg, &res, stdout);
+
+	return rv;
+}
+
+void usage(const char *name) {
+
+	fprintf(stderr,
+		"Usage: %s [OPTIONS]\n"
+		"Without options an interactive menu is shown.\n"
+		"\n"
+		"  -h, --help                Display this help and exit\n"
+		"  -l, --loopback=SRC:SINK   Run the loopback test on one pin pair and exit, pins\n"
+		"                            are numbered chip * 8 + gpio, e.g. 2:18\n"
+		"  -n, --iterations=N        Loopback iterations, pattern passes or events,\n"
+		"                            default: 1\n"
+		"  -p, --pattern=LIST        Run the batched loopback on all pins and exit, LIST is\n"
+		"                            any of walk,values,prbs or all\n"
+		"  -m, --pins=MASK           Source pins of the batched loopback, pin n of ports A\n"
+		"                            and B loops back to pin n + 16, default: 0x%x\n"
+		"  -s, --self                Read the source lines back instead of the sinks, for\n"
+		"                            boards without loopback wiring and gpio-sim. The\n"
+		"                            sink lines and the reverse direction are not tested.\n"
+		"  -c, --chips=P0,P1,P2,P3   Character devices of ports A to D, default:\n"
+		"                            /dev/gpiochip0 to /dev/gpiochip3\n"
+		"  -e, --events=PIN          Print the edge events of a pin and exit, with --json\n"
+		"                            a record per event and a summary record\n"
+		"  -d, --debounce=US         Debounce period of --events and --irq, default: 0\n"
+		"  -t, --clock=NAME          Event timestamps from monotonic, realtime or hte\n"
+		"                            (hardware timestamp engine), default: monotonic\n"
+		"  -i, --irq=OUT:IN          Interrupt benchmark, drive pin OUT and take the edge\n"
+		"                            events of the looped back pin IN, then exit\n"
+		"  -S, --samples=N           Latency samples of --irq, 0 skips, default: 1000\n"
+		"  -b, --burst=N             Edges per rate step of --irq, 0 skips, default: 4096\n"
+		"  -f, --event-buffer=N      Kernel event buffer of --irq, default: 16\n"
+		"  -u, --pull=PIN:MODE,...   Set the pad pull of pins to up, down or none in one\n"
+		"                            pass and exit, PIN may be all, e.g. all:none,2:up\n"
+		"  -M, --pad-map=PATH        File or UIO device standing in for the pad registers,\n"
+		"                            default: /dev/mem at 0x%x\n"
+		"  -T, --toggle=MASK         Toggle benchmark on the pins of MASK, bit n is pin n,\n"
+		"                            then exit\n"
+		"  -F, --frequency=HZ        Toggles per second of --toggle, default: as fast as\n"
+		"                            possible\n"
+		"  -N, --toggles=N           Toggles of --toggle, default: 100000\n"
+		"  -r, --rt[=PRIO]           Run --toggle with SCHED_FIFO PRIO and locked memory,\n"
+		"                            default PRIO: 80\n"
+		"  -j, --json                Print results as one JSON record per test\n",
+		name, DEFAULT_LOOPBACK_PINS, GPIO_PAD_REGISTER);
+}
+
+int main(int argc, char *argv[]) {
 
 	unsigned int led_arr[] = {0, 4, 5};
 	unsigned int quit = 0;
 	int option = 0;
+	unsigned int source = 0, sink = 0, iterations = 1;
+	unsigned int patterns = 0, pins = DEFAULT_LOOPBACK_PINS, port;
+	unsigned int event_pin = 0, debounce_us = 0, clock = 0;
+	int loopback = 0, self = 0, events = 0, irq = 0, pulls = 0;
+	enum pad_pull pull[MAX_GPIOS];
+	toggle_bench_config toggle_cfg = { .toggles = 100000 };
+	irq_bench_config irq_cfg = { .samples = 1000, .burst = 4096 };
+	struct loopback_engine lb;
+	long failed;
+	char *end, *name;
+	struct option long_options[] = {
+		{ "help",       no_argument,       NULL, 'h' },
+		{ "loopback",   required_argument, NULL, 'l' },
+		{ "iterations", required_argument, NULL, 'n' },
+		{ "pattern",    required_argument, NULL, 'p' },
+		{ "pins",       required_argument, NULL, 'm' },
+		{ "self",       no_argument,       NULL, 's' },
+		{ "chips",      required_argument, NULL, 'c' },
+		{ "events",     required_argument, NULL, 'e' },
+		{ "debounce",   required_argument, NULL, 'd' },
+		{ "clock",      required_argument, NULL, 't' },
+		{ "irq",        required_argument, NULL, 'i' },
+		{ "samples",    required_argument, NULL, 'S' },
+		{ "burst",      required_argument, NULL, 'b' },
+		{ "event-buffer", required_argument, NULL, 'f' },
+		{ "pull",       required_argument, NULL, 'u' },
+		{ "pad-map",    required_argument, NULL, 'M' },
+		{ "toggle",     required_argument, NULL, 'T' },
+		{ "frequency",  required_argument, NULL, 'F' },
+		{ "toggles",    required_argument, NULL, 'N' },
+		{ "rt",         optional_argument, NULL, 'r' },
+		{ "json",       no_argument,       NULL, 'j' },
+		{ 0,            0,                 0,     0  }
+	};
+
+	for(port = 0; port < MAX_GPIOS; port++)
+		pull[port] = PAD_PULL_KEEP;
+
+	while((option = getopt_long(argc, argv, "hl:n:p:m:sc:e:d:t:i:S:b:f:u:M:T:F:N:r::j", long_options, NULL)) != -1) {
+		switch(option) {
+			case 'l':
+			case 'i':
+				if(parse_pin_pair(optarg, &source, &sink) != 0) {
+					fprintf(stderr, "ERROR : invalid loopback pair %s\n", optarg);
+					return -1;
+				}
+				if(option == 'l')
+					loopback = 1;
+				else
+					irq = 1;
+				break;
+			case 'S':
+				irq_cfg.samples = strtoul(optarg, NULL, 10);
+				break;
+			case 'b':
+				irq_cfg.burst = strtoul(optarg, NULL, 10);
+				break;
+			case 'f':
+				irq_cfg.event_buffer = strtoul(optarg, NULL, 10);
+				break;
+			case 'n':
+				iterations = strtoul(optarg, NULL, 10);
+				break;
+			case 'p':
+				for(name = strtok(optarg, ","); name; name = strtok(NULL, ",")) {
+					for(port = 0; port < LOOPBACK_PATTERNS; port++) {
+						if(!strcmp(name, loopback_pattern_names[port]))
+							break;
+					}
+					if(!strcmp(name, "all")) {
+						patterns = (1U << LOOPBACK_PATTERNS) - 1;
+					} else if(port < LOOPBACK_PATTERNS) {
+						patterns |= 1U << port;
+					} else {
+						fprintf(stderr, "ERROR : unknown pattern %s\n", name);
+						return -1;
+					}
+				}
+				break;
+			case 'm':
+				pins = strtoul(optarg, &end, 0);
+				if(*end || !pins || pins >= (1U << LOOPBACK_SINK_OFFSET)) {
+					fprintf(stderr, "ERROR : invalid pin mask %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 's':
+				self = 1;
+				break;
+			case 'c':
+				port = 0;
+				for(name = strtok(optarg, ","); name && port < TOTAL_NUM_PORTS;
+								name = strtok(NULL, ","))
+					port_paths[port++] = name;
+				if(port != TOTAL_NUM_PORTS || name) {
+					fprintf(stderr, "ERROR : expected %zu chips\n", TOTAL_NUM_PORTS);
+					return -1;
+				}
+				break;
+			case 'e':
+				event_pin = strtoul(optarg, &end, 10);
+				if(end == optarg || *end || event_pin >= MAX_GPIOS) {
+					fprintf(stderr, "ERROR : invalid pin %s\n", optarg);
+					return -1;
+				}
+				events = 1;
+				break;
+			case 'd':
+				debounce_us = strtoul(optarg, NULL, 10);
+				break;
+			case 't':
+				for(clock = 0; clock < sizeof(event_clock_names)/sizeof(event_clock_names[0]);
+								clock++) {
+					if(!strcmp(optarg, event_clock_names[clock]))
+						break;
+				}
+				if(clock == sizeof(event_clock_names)/sizeof(event_clock_names[0])) {
+					fprintf(stderr, "ERROR : unknown clock %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 'u':
+				if(parse_pulls(optarg, pull) != 0) {
+					fprintf(stderr, "ERROR : invalid pull setting\n");
+					return -1;
+				}
+				pulls = 1;
+				break;
+			case 'M':
+				pad_map_path = optarg;
+				break;
+			case 'T':
+				toggle_cfg.pins = strtoul(optarg, &end, 0);
+				if(*end || !toggle_cfg.pins) {
+					fprintf(stderr, "ERROR : invalid pin mask %s\n", optarg);
+					return -1;
+				}
+				break;
+			case 'F':
+				toggle_cfg.frequency = strtod(optarg, NULL);
+				break;
+			case 'N':
+				toggle_cfg.toggles = strtoul(optarg, NULL, 10);
+				break;
+			case 'r':
+				toggle_cfg.rt_priority = optarg ? atoi(optarg) : 80;
+				break;
+			case 'j':
+				json_output = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return -1;
+		}
+	}
+
+	if(loopback)
+		return loopback_pair(source, sink, iterations) ? 1 : 0;
+
+	if(toggle_cfg.pins)
+		return toggle_benchmark(&toggle_cfg) ? 1 : 0;
+
+	if(pulls)
+		return configure_pads(pull) ? 1 : 0;
+
+	if(irq) {
+		irq_cfg.debounce_us = debounce_us;
+		return irq_benchmark(&irq_cfg, source, sink) ? 1 : 0;
+	}
+
+	if(events)
+		return watch_gpio_events(event_pin / MAX_GPIOS_PER_PORT,
+						event_pin % MAX_GPIOS_PER_PORT, debounce_us, clock, iterations) ? 1 : 0;
+
+	if(patterns) {
+		loopback_engine_init(&lb, pins, self);
+		failed = loopback_engine_run(&lb, patterns, iterations);
+		loopback_engine_report(&lb, patterns, iterations, failed);
+		return failed ? 1 : 0;
+	}
 
 	do {
 
@@ -752,12 +1397,10 @@ int main() {
 						printf("Toggling all GPIOs\n");
 						toggle_all_gpios(10);
 						break;
-#if 0
 					case 11:
 						printf("Interrupt Test\n");
 						interrupt_test();
 						break;
-#endif
 					case 0:
 						printf("Good bye\n");
 						quit = 1;
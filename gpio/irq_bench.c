@@ -0,0 +1,391 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "clock.h"
+#include "gpio_line.h"
+#include "hist_json.h"
+#include "irq_bench.h"
+
+#define EVENT_BATCH		64
+#define IRQ_TIMEOUT_MS		1000
+#define IRQ_DRAIN_NS		50000000UL
+
+/* Paced rates of the rate test in edges/s, the unpaced burst follows */
+static const double irq_rates[] = {
+	1e3, 2e3, 5e3, 1e4, 2e4, 5e4, 1e5, 2e5, 5e5, 1e6
+};
+
+typedef struct {
+	gpio_lines out;
+	gpio_lines in;
+	int epfd;
+	int level;
+	unsigned int last_seqno;
+} irq_ctx;
+
+typedef struct {
+	irq_ctx *c;
+	volatile int stop;
+	unsigned long int received;
+	unsigned long int overflows;
+	unsigned long int last_ns;	/* When the last batch was read */
+} irq_reader;
+
+static void irq_close(irq_ctx *c)
+{
+	if (c->epfd >= 0)
+		close(c->epfd);
+	c->epfd = -1;
+	gpio_lines_release(&c->out);
+	gpio_lines_release(&c->in);
+}
+
+static int irq_open(irq_ctx *c, const irq_bench_config *cfg)
+{
+	struct epoll_event ev = { .events = EPOLLIN };
+	gpio_config out_cfg, in_cfg;
+
+	memset(c, 0, sizeof(*c));
+	c->epfd = -1;
+	c->out.fd = -1;
+	c->in.fd = -1;
+
+	gpio_config_init(&out_cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+	gpio_config_outputs(&out_cfg, 1, 0);
+	if (gpio_lines_request(&c->out, cfg->out_chip, &cfg->out_offset, 1, "GPIO_IRQ_STIMULUS",
+			       &out_cfg) != 0)
+		goto err;
+
+	//Kernel timestamps are CLOCK_MONOTONIC, same as now_ns()
+	gpio_config_init(&in_cfg, GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING |
+			 GPIO_V2_LINE_FLAG_EDGE_FALLING);
+	if (cfg->debounce_us)
+		gpio_config_debounce(&in_cfg, 1, cfg->debounce_us);
+	if (gpio_lines_request_events(&c->in, cfg->in_chip, &cfg->in_offset, 1, "GPIO_IRQ_EVENTS",
+				      &in_cfg, cfg->event_buffer) != 0)
+		goto err;
+
+	if (fcntl(c->in.fd, F_SETFL, fcntl(c->in.fd, F_GETFL) | O_NONBLOCK) == -1)
+		goto err;
+	c->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (c->epfd < 0)
+		goto err;
+	ev.data.fd = c->in.fd;
+	if (epoll_ctl(c->epfd, EPOLL_CTL_ADD, c->in.fd, &ev) == -1)
+		goto err;
+	return 0;
+err:
+	fprintf(stderr, "ERROR : setting up the interrupt benchmark\n");
+	irq_close(c);
+	return -1;
+}
+
+/* Events the kernel dropped before this one */
+static unsigned int seqno_gap(irq_ctx *c, const struct gpio_v2_line_event *ev)
+{
+	unsigned int gap = ev->seqno - c->last_seqno - 1;
+
+	c->last_seqno = ev->seqno;
+	return gap;
+}
+
+static int toggle(irq_ctx *c)
+{
+	c->level ^= 1;
+	return gpio_lines_set(&c->out, 1, c->level);
+}
+
+/* Read off events left over from earlier toggles, returns how many */
+static unsigned long int drop_stale(irq_ctx *c, irq_bench_result *res)
+{
+	struct gpio_v2_line_event events[EVENT_BATCH];
+	unsigned long int stale = 0;
+	int n, k;
+
+	while ((n = gpio_lines_events(&c->in, events, EVENT_BATCH)) > 0) {
+		for (k = 0; k < n; k++)
+			res->overflows += seqno_gap(c, &events[k]);
+		stale += n;
+	}
+	return stale;
+}
+
+int irq_bench_latency(const irq_bench_config *cfg, irq_bench_result *res)
+{
+	struct gpio_v2_line_event events[EVENT_BATCH];
+	struct epoll_event ep;
+	unsigned long int start, woken, i;
+	unsigned int edge;
+	int n, k, got, rv = 0;
+	irq_ctx c;
+
+	if (irq_open(&c, cfg) != 0)
+		return -1;
+	hist_init(&res->stimulus);
+	hist_init(&res->wakeup);
+
+	for (i = 0; i < cfg->samples; i++) {
+		//A late event of the previous toggle must not be taken for this one
+		res->extra += drop_stale(&c, res);
+		edge = c.level ? GPIO_V2_LINE_EVENT_FALLING_EDGE : GPIO_V2_LINE_EVENT_RISING_EDGE;
+		start = now_ns();
+		if (toggle(&c) != 0) {
+			rv = -1;
+			break;
+		}
+
+		for (got = 0; !got;) {
+			n = epoll_wait(c.epfd, &ep, 1, IRQ_TIMEOUT_MS);
+			if (n <= 0) {
+				res->timeouts++;
+				break;
+			}
+			n = gpio_lines_events(&c.in, events, EVENT_BATCH);
+			woken = now_ns();
+			for (k = 0; k < n; k++) {
+				res->overflows += seqno_gap(&c, &events[k]);
+				if (got || events[k].id != edge || events[k].timestamp_ns < start) {
+					res->extra++;
+					continue;
+				}
+				hist_record(&res->stimulus, events[k].timestamp_ns - start);
+				hist_record(&res->wakeup, woken > events[k].timestamp_ns ?
+					    woken - events[k].timestamp_ns : 0);
+				res->samples++;
+				got = 1;
+			}
+		}
+	}
+
+	irq_close(&c);
+	return rv;
+}
+
+static void *reader_thread(void *arg)
+{
+	struct gpio_v2_line_event events[EVENT_BATCH];
+	irq_reader *r = (irq_reader *)arg;
+	struct epoll_event ep;
+	unsigned long int overflows;
+	int n, k;
+
+	while (!r->stop) {
+		if (epoll_wait(r->c->epfd, &ep, 1, 10) <= 0)
+			continue;
+		//Take everything queued, one read can return a whole batch
+		while ((n = gpio_lines_events(&r->c->in, events, EVENT_BATCH)) > 0) {
+			overflows = 0;
+			for (k = 0; k < n; k++)
+				overflows += seqno_gap(r->c, &events[k]);
+			__atomic_add_fetch(&r->overflows, overflows, __ATOMIC_RELAXED);
+			__atomic_add_fetch(&r->received, n, __ATOMIC_RELEASE);
+			__atomic_store_n(&r->last_ns, now_ns(), __ATOMIC_RELAXED);
+		}
+	}
+	return NULL;
+}
+
+/* Wait until no event arrived for IRQ_DRAIN_NS, at most IRQ_TIMEOUT_MS */
+static void drain(irq_reader *r)
+{
+	unsigned long int start = now_ns(), last;
+
+	do {
+		usleep(5000);
+		last = __atomic_load_n(&r->last_ns, __ATOMIC_RELAXED);
+	} while (now_ns() - (last > start ? last : start) < IRQ_DRAIN_NS &&
+		 now_ns() - start < IRQ_TIMEOUT_MS * 1000000UL);
+}
+
+/* Drive burst edges at rate edges/s, or as fast as possible with 0 */
+static int rate_step(irq_ctx *c, irq_reader *r, unsigned int burst, double rate,
+		     irq_rate_step *step)
+{
+	unsigned long int received, overflows, start, end, period = 0;
+	struct timespec next;
+	unsigned int i;
+
+	received = __atomic_load_n(&r->received, __ATOMIC_ACQUIRE);
+	overflows = __atomic_load_n(&r->overflows, __ATOMIC_RELAXED);
+	if (rate > 0)
+		period = 1e9 / rate;
+
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	start = now_ns();
+	for (i = 0; i < burst; i++) {
+		if (period) {
+			timespec_add_ns(&next, period);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+		if (toggle(c) != 0)
+			return -1;
+	}
+	end = now_ns();
+	drain(r);
+
+	step->rate = rate;
+	step->achieved = end > start ? burst / ((end - start) / 1e9) : 0;
+	step->sent = burst;
+	step->received = __atomic_load_n(&r->received, __ATOMIC_ACQUIRE) - received;
+	step->overflows = __atomic_load_n(&r->overflows, __ATOMIC_RELAXED) - overflows;
+	return 0;
+}
+
+int irq_bench_rate(const irq_bench_config *cfg, irq_bench_result *res)
+{
+	irq_rate_step *step;
+	irq_reader reader;
+	double rate;
+	pthread_t thread;
+	unsigned int i;
+	irq_ctx c;
+	int rv = 0;
+
+	if (irq_open(&c, cfg) != 0)
+		return -1;
+	memset(&reader, 0, sizeof(reader));
+	reader.c = &c;
+	if (pthread_create(&thread, NULL, reader_thread, &reader) != 0) {
+		fprintf(stderr, "ERROR : pthread_create() failed\n");
+		irq_close(&c);
+		return -1;
+	}
+
+	res->nsteps = 0;
+	res->max_rate = 0;
+	for (i = 0; i <= sizeof(irq_rates) / sizeof(irq_rates[0]); i++) {
+		step = &res->steps[res->nsteps++];
+		rate = i < sizeof(irq_rates) / sizeof(irq_rates[0]) ? irq_rates[i] : 0;
+		rv = rate_step(&c, &reader, cfg->burst, rate, step);
+		if (rv != 0)
+			break;
+		if (step->received >= step->sent && step->overflows == 0 &&
+		    step->achieved > res->max_rate)
+			res->max_rate = step->achieved;
+		//The output cannot be driven any faster, go to the unpaced burst
+		if (rate > 0 && step->achieved < 0.9 * rate)
+			i = sizeof(irq_rates) / sizeof(irq_rates[0]) - 1;
+	}
+
+	reader.stop = 1;
+	pthread_join(thread, NULL);
+	irq_close(&c);
+	return rv;
+}
+
+void irq_bench_report(const irq_bench_config *cfg, const irq_bench_result *res, FILE *out)
+{
+	const irq_rate_step *step;
+	unsigned int i;
+
+	fprintf(out, "irq: %s:%u -> %s:%u\n", cfg->out_chip, cfg->out_offset, cfg->in_chip,
+		cfg->in_offset);
+	if (res->samples) {
+		fprintf(out, "  stimulus latency us: p50 %.2f p99 %.2f p999 %.2f max %.2f\n",
+			hist_percentile(&res->stimulus, 0.50) / 1e3,
+			hist_percentile(&res->stimulus, 0.99) / 1e3,
+			hist_percentile(&res->stimulus, 0.999) / 1e3, res->stimulus.max / 1e3);
+		fprintf(out, "  wakeup latency us:   p50 %.2f p99 %.2f p999 %.2f max %.2f\n",
+			hist_percentile(&res->wakeup, 0.50) / 1e3,
+			hist_percentile(&res->wakeup, 0.99) / 1e3,
+			hist_percentile(&res->wakeup, 0.999) / 1e3, res->wakeup.max / 1e3);
+		fprintf(out, "  %lu samples, %lu timeouts, %lu extra events, %lu overflows\n",
+			res->samples, res->timeouts, res->extra, res->overflows);
+	}
+
+	if (!res->nsteps)
+		return;
+	fprintf(out, "%12s %12s %8s %8s %8s %9s\n", "Target/s", "Achieved/s", "Sent", "Received",
+		"Lost", "Overflow");
+	for (i = 0; i < res->nsteps; i++) {
+		step = &res->steps[i];
+		if (step->rate > 0)
+			fprintf(out, "%12.0f", step->rate);
+		else
+			fprintf(out, "%12s", "unpaced");
+		fprintf(out, " %12.0f %8lu %8lu %8lu %9lu\n", step->achieved, step->sent,
+			step->received,
+			step->sent > step->received ? step->sent - step->received : 0,
+			step->overflows);
+	}
+	fprintf(out, "max sustainable edge rate: %.0f/s\n", res->max_rate);
+}
+
+int irq_bench_latency_passed(const irq_bench_result *res)
+{
+	return res->samples && !res->timeouts && !res->overflows;
+}
+
+int irq_bench_rate_passed(const irq_bench_result *res)
+{
+	const irq_rate_step *first = &res->steps[0];
+
+	//Higher rates are expected to lose edges, the lowest one must not
+	return res->nsteps && first->received >= first->sent && !first->overflows &&
+		res->max_rate > 0;
+}
+
+static void json_params(json_record *r, const irq_bench_config *cfg)
+{
+	json_object_begin(r, "params");
+	json_string(r, "out_chip", cfg->out_chip);
+	json_uint(r, "out_offset", cfg->out_offset);
+	json_string(r, "in_chip", cfg->in_chip);
+	json_uint(r, "in_offset", cfg->in_offset);
+	json_uint(r, "samples", cfg->samples);
+	json_uint(r, "burst", cfg->burst);
+	json_uint(r, "event_buffer", cfg->event_buffer);
+	json_uint(r, "debounce_us", cfg->debounce_us);
+	json_object_end(r);
+}
+
+void irq_bench_json(const irq_bench_config *cfg, const irq_bench_result *res, FILE *out)
+{
+	const irq_rate_step *step;
+	json_record r;
+	unsigned int i;
+
+	if (cfg->samples) {
+		json_begin(&r, out, "gpio_test", "irq_latency");
+		json_params(&r, cfg);
+		json_latency(&r, "latency_ns", &res->stimulus);
+		json_latency(&r, "wakeup_ns", &res->wakeup);
+		json_uint(&r, "samples", res->samples);
+		json_uint(&r, "timeouts", res->timeouts);
+		json_uint(&r, "extra", res->extra);
+		json_uint(&r, "overflows", res->overflows);
+		json_uint(&r, "errors", res->timeouts + res->overflows);
+		json_string(&r, "status", irq_bench_latency_passed(res) ? "pass" : "fail");
+		json_end(&r);
+	}
+
+	if (!res->nsteps)
+		return;
+	json_begin(&r, out, "gpio_test", "irq_rate");
+	json_params(&r, cfg);
+	json_array_begin(&r, "steps");
+	for (i = 0; i < res->nsteps; i++) {
+		step = &res->steps[i];
+		json_object_begin(&r, NULL);
+		json_double(&r, "rate", step->rate);
+		json_double(&r, "achieved", step->achieved);
+		json_uint(&r, "sent", step->sent);
+		json_uint(&r, "received", step->received);
+		json_uint(&r, "overflows", step->overflows);
+		json_object_end(&r);
+	}
+	json_array_end(&r);
+	json_double(&r, "max_rate", res->max_rate);
+	json_string(&r, "status", irq_bench_rate_passed(res) ? "pass" : "fail");
+	json_end(&r);
+}
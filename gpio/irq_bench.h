@@ -0,0 +1,75 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * GPIO interrupt benchmark. One line is driven as an output and looped back
+ * into an input line that reports both edges, an epoll based reader takes
+ * the edge events off the input in batches.
+ *
+ * The latency test toggles the output once per sample and waits for the
+ * event of that edge. Events left over from earlier toggles are read off
+ * before each toggle and counted as extra, like events of the wrong edge,
+ * so a late event never becomes the next sample. Stimulus latency runs
+ * from just before the set ioctl to the kernel timestamp of the edge,
+ * wakeup latency from that timestamp to the reader having the event in
+ * hand.
+ *
+ * The rate test drives bursts of edges at increasing paced rates and then
+ * as fast as possible. Edges the reader did not get are lost; the gaps in
+ * the event sequence numbers are the part the kernel dropped because its
+ * event buffer overflowed.
+ */
+
+#ifndef IRQ_BENCH_H
+#define IRQ_BENCH_H
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+#define IRQ_MAX_STEPS	16
+
+typedef struct {
+	const char *out_chip;
+	unsigned int out_offset;
+	const char *in_chip;
+	unsigned int in_offset;
+	unsigned int samples;		/* Latency samples */
+	unsigned int burst;		/* Edges per rate step */
+	unsigned int event_buffer;	/* Kernel event buffer, 0 for the default */
+	unsigned int debounce_us;
+} irq_bench_config;
+
+typedef struct {
+	double rate;			/* Target edges/s, 0 for unpaced */
+	double achieved;		/* Edges/s actually driven */
+	unsigned long int sent;
+	unsigned long int received;
+	unsigned long int overflows;	/* Sequence number gaps */
+} irq_rate_step;
+
+typedef struct {
+	histogram stimulus;
+	histogram wakeup;
+	unsigned long int samples;
+	unsigned long int timeouts;	/* Toggles without an event */
+	unsigned long int extra;	/* Events beyond one per toggle */
+	unsigned long int overflows;
+	irq_rate_step steps[IRQ_MAX_STEPS];
+	unsigned int nsteps;
+	double max_rate;		/* Highest achieved rate without loss */
+} irq_bench_result;
+
+int irq_bench_latency(const irq_bench_config *cfg, irq_bench_result *res);
+int irq_bench_rate(const irq_bench_config *cfg, irq_bench_result *res);
+
+/* The status of the JSON records, for the exit code of the caller */
+int irq_bench_latency_passed(const irq_bench_result *res);
+int irq_bench_rate_passed(const irq_bench_result *res);
+
+void irq_bench_report(const irq_bench_config *cfg, const irq_bench_result *res, FILE *out);
+void irq_bench_json(const irq_bench_config *cfg, const irq_bench_result *res, FILE *out);
+
+#endif /* IRQ_BENCH_H */
@@ -0,0 +1,202 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "clock.h"
+#include "gpio_line.h"
+#include "hist_json.h"
+#include "toggle_bench.h"
+
+#define PINS_PER_PORT	8
+
+static unsigned int jitter_bucket(unsigned long int ns)
+{
+	unsigned int bucket;
+
+	if (ns < 1000)
+		return 0;
+	bucket = 64 - __builtin_clzl(ns / 1000);
+	return bucket < TOGGLE_JITTER_BUCKETS ? bucket : TOGGLE_JITTER_BUCKETS - 1;
+}
+
+static void record(toggle_bench_result *res, unsigned long int ns)
+{
+	hist_record(&res->jitter, ns);
+	res->buckets[jitter_bucket(ns)]++;
+}
+
+static void rt_enter(const toggle_bench_config *cfg, toggle_bench_result *res)
+{
+	struct sched_param param = { .sched_priority = cfg->rt_priority };
+
+	if (!cfg->rt_priority)
+		return;
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		printf("WARN : mlockall failed errno:%d, running without realtime\n", errno);
+		return;
+	}
+	if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+		printf("WARN : SCHED_FIFO %d failed errno:%d, running without realtime\n",
+		       cfg->rt_priority, errno);
+		munlockall();
+		return;
+	}
+	res->rt = 1;
+}
+
+static void rt_leave(toggle_bench_result *res)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (!res->rt)
+		return;
+	sched_setscheduler(0, SCHED_OTHER, &param);
+	munlockall();
+}
+
+int toggle_bench_run(const toggle_bench_config *cfg, toggle_bench_result *res)
+{
+	gpio_lines lines[TOGGLE_MAX_PORTS];
+	unsigned long int i, t, prev = 0, start, deadline, period = 0;
+	gpio_config out_cfg;
+	struct timespec next;
+	unsigned int port, mask;
+	__u64 all[TOGGLE_MAX_PORTS];
+	int level = 0, rv = 0;
+
+	memset(res, 0, sizeof(*res));
+	hist_init(&res->jitter);
+	gpio_config_init(&out_cfg, GPIO_V2_LINE_FLAG_OUTPUT);
+
+	//Every entry must be closable at out, whichever port a request fails on
+	for (port = 0; port < TOGGLE_MAX_PORTS; port++) {
+		lines[port].fd = -1;
+		lines[port].count = 0;
+	}
+	for (port = 0; port < TOGGLE_MAX_PORTS; port++) {
+		mask = (cfg->pins >> (port * PINS_PER_PORT)) & 0xff;
+		if (!mask)
+			continue;
+		if (gpio_lines_request_mask(&lines[port], cfg->chips[port], mask, "GPIO_TOGGLE_BENCH",
+					    &out_cfg) != 0) {
+			rv = -1;
+			goto out;
+		}
+		all[port] = (1ULL << lines[port].count) - 1;
+	}
+
+	if (cfg->frequency > 0)
+		period = 1e9 / cfg->frequency;
+
+	rt_enter(cfg, res);
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	start = now_ns();
+	for (i = 0; i < cfg->toggles; i++) {
+		if (period) {
+			timespec_add_ns(&next, period);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+
+		level ^= 1;
+		for (port = 0; port < TOGGLE_MAX_PORTS; port++) {
+			if (lines[port].fd >= 0 &&
+			    gpio_lines_set(&lines[port], all[port], level ? all[port] : 0) != 0) {
+				rv = -1;
+				break;
+			}
+		}
+		if (rv != 0)
+			break;
+		t = now_ns();
+
+		//Paced toggles are measured against their deadline, unpaced ones
+		//against the previous toggle
+		if (period) {
+			deadline = timespec_ns(&next);
+			record(res, t > deadline ? t - deadline : 0);
+			if (t > deadline + period)
+				res->missed++;
+		} else if (i > 0) {
+			record(res, t - prev);
+		}
+		prev = t;
+	}
+	res->toggles = i;
+	res->seconds = (now_ns() - start) / 1e9;
+	res->rate = res->seconds > 0 ? res->toggles / res->seconds : 0;
+	rt_leave(res);
+
+out:
+	for (port = 0; port < TOGGLE_MAX_PORTS; port++)
+		gpio_lines_release(&lines[port]);
+	return rv;
+}
+
+void toggle_bench_report(const toggle_bench_config *cfg, const toggle_bench_result *res,
+			 FILE *out)
+{
+	unsigned long int peak = 0;
+	unsigned int i, last = 0, width;
+
+	fprintf(out, "toggle: pins 0x%08x, %lu toggles in %.3fs, %.0f toggles/s (%.0f Hz square wave)",
+		cfg->pins, res->toggles, res->seconds, res->rate, res->rate / 2);
+	if (cfg->frequency > 0)
+		fprintf(out, ", target %.0f toggles/s, %lu missed", cfg->frequency, res->missed);
+	fprintf(out, "%s\n", res->rt ? ", SCHED_FIFO" : "");
+	if (!res->jitter.total)
+		return;
+
+	fprintf(out, "%s us: p50 %.2f p99 %.2f p999 %.2f max %.2f\n",
+		cfg->frequency > 0 ? "lateness" : "interval",
+		hist_percentile(&res->jitter, 0.50) / 1e3, hist_percentile(&res->jitter, 0.99) / 1e3,
+		hist_percentile(&res->jitter, 0.999) / 1e3, res->jitter.max / 1e3);
+
+	for (i = 0; i < TOGGLE_JITTER_BUCKETS; i++) {
+		if (res->buckets[i])
+			last = i;
+		if (res->buckets[i] > peak)
+			peak = res->buckets[i];
+	}
+	for (i = 0; i <= last; i++) {
+		width = peak ? (res->buckets[i] * 50 + peak - 1) / peak : 0;
+		fprintf(out, "  <%7luus %10lu %.*s\n", 1UL << i, res->buckets[i], width,
+			"##################################################");
+	}
+}
+
+void toggle_bench_json(const toggle_bench_config *cfg, const toggle_bench_result *res,
+		       FILE *out)
+{
+	json_record r;
+	unsigned int i;
+
+	json_begin(&r, out, "gpio_test", "toggle");
+	json_object_begin(&r, "params");
+	json_uint(&r, "pins", cfg->pins);
+	json_uint(&r, "toggles", cfg->toggles);
+	json_double(&r, "frequency", cfg->frequency);
+	json_int(&r, "rt_priority", cfg->rt_priority);
+	json_object_end(&r);
+	json_double(&r, "duration_s", res->seconds);
+	json_uint(&r, "toggles", res->toggles);
+	json_double(&r, "toggles_per_s", res->rate);
+	json_bool(&r, "rt", res->rt);
+	json_latency(&r, "latency_ns", &res->jitter);
+	//Bucket i counts jitter below 2^i us
+	json_array_begin(&r, "jitter_histogram");
+	for (i = 0; i < TOGGLE_JITTER_BUCKETS; i++)
+		json_uint(&r, NULL, res->buckets[i]);
+	json_array_end(&r);
+	json_uint(&r, "missed", res->missed);
+	json_uint(&r, "errors", cfg->toggles - res->toggles);
+	json_string(&r, "status", res->toggles == cfg->toggles ? "pass" : "fail");
+	json_end(&r);
+}
@@ -0,0 +1,52 @@
+//SPDX-License-Identifier: (GPL-2.0+ OR MIT)
+/*
+ * Copyright (c) 2026 Sima ai
+ */
+
+/*
+ * GPIO toggle benchmark. A set of pins, spread over any of the ports, is
+ * requested once and inverted with one set ioctl per port per toggle.
+ *
+ * Unpaced, the pins are toggled as fast as the controller and driver path
+ * allow and the jitter is the spread of the intervals between toggles.
+ * Paced, every toggle waits for its absolute deadline with clock_nanosleep()
+ * and the jitter is how late it was. Running with SCHED_FIFO and locked
+ * memory separates scheduler noise from the limits of the controller.
+ */
+
+#ifndef TOGGLE_BENCH_H
+#define TOGGLE_BENCH_H
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+#define TOGGLE_MAX_PORTS	4
+#define TOGGLE_JITTER_BUCKETS	24	/* Powers of two from 1us */
+
+typedef struct {
+	const char *chips[TOGGLE_MAX_PORTS];
+	unsigned int pins;		/* Bit n is pin n, 8 pins per port */
+	unsigned long int toggles;
+	double frequency;		/* Target toggles/s, 0 for as fast as possible */
+	int rt_priority;		/* SCHED_FIFO priority, 0 to stay SCHED_OTHER */
+} toggle_bench_config;
+
+typedef struct {
+	unsigned long int toggles;
+	double seconds;
+	double rate;			/* Achieved toggles/s */
+	histogram jitter;		/* Interval or lateness in ns */
+	unsigned long int buckets[TOGGLE_JITTER_BUCKETS];
+	unsigned long int missed;	/* Paced toggles later than one period */
+	int rt;				/* SCHED_FIFO and mlockall took effect */
+} toggle_bench_result;
+
+int toggle_bench_run(const toggle_bench_config *cfg, toggle_bench_result *res);
+
+void toggle_bench_report(const toggle_bench_config *cfg, const toggle_bench_result *res,
+			 FILE *out);
+void toggle_bench_json(const toggle_bench_config *cfg, const toggle_bench_result *res,
+		       FILE *out);
+
+#endif /* TOGGLE_BENCH_H */
@@ -1,95 +1,268 @@
-import subprocess
+import argparse
+import json
+import os
 import re
+import signal
+import subprocess
+import sys
+import threading
+import time
 
-def run_command(command, test_number, test_type, check_bytes=False):
-    try:
-        result = subprocess.run(command, shell=True, text=True, capture_output=True)
-        output = result.stdout + result.stderr
+PT_DIR = "/usr/bin/simaai_pt"
+
+def json_records(output):
+    records = []
+    for line in output.splitlines():
+        line = line.strip()
+        if not line.startswith("{"):
+            continue
+        try:
+            records.append(json.loads(line))
+        except ValueError:
+            pass
+    return records
+
+class Test:
+    """
+    One test command. resources names the hardware it uses; tests sharing a
+    resource never run at the same time. A test that measures bandwidth is
+    exclusive: it only starts on an idle board and nothing else starts
+    until it is done, so the number is not skewed by other traffic.
+    """
+    def __init__(self, group, label, command, resources, check, timeout, exclusive=False):
+        self.group = group
+        self.label = label
+        self.command = command
+        self.resources = set(resources)
+        self.check = check
+        self.timeout = timeout
+        self.exclusive = exclusive
+        self.passed = False
+        self.message = f"{label}: Not run"
+        self.duration = 0.0
+        self.cancelled = False
+
+def ddr_check(label, check_bytes=False):
+    def check(returncode, stdout, stderr):
+        records = json_records(stdout)
+        passed = (returncode == 0 and len(records) > 0 and
+                  all(record.get("status") == "pass" for record in records))
 
         if check_bytes:
-            match = re.search(r'Total bytes\s*:\s*(\d+)', output)
-            if match:
-                bytes_written = match.group(1)
-                print(f"{test_type} Test {test_number} Passed - Total bytes: {bytes_written}")
-            else:
-                print(f"{test_type} Test {test_number}: Failed")
-        else:
-            if "Pattern Loaded" in output:
-                print(f"{test_type} Test {test_number}: Passed")
-            else:
-                print(f"{test_type} Test {test_number}: Failed")
-        
-    except subprocess.CalledProcessError as e:
-        print(f"{test_type} Test {test_number}: Failed")
-        print("Error output:\n", e.stderr)
-
-def run_script(choice, test): 
-    cmd = f'echo -e "{choice}\n{test}" | /usr/bin/simaai_pt/emmc_sd_test.sh'
-    result = subprocess.run(cmd, shell=True, capture_output=True, text=True)
-
-    if result.returncode == 0:
-        output = result.stdout
+            if passed and "bytes" in records[-1]:
+                record = records[-1]
+                return True, (f"{label} Passed - Total bytes: {record['bytes']}, "
+                              f"Bandwidth: {record['bandwidth_gbps']:.2f} GB/s")
+            return False, f"{label}: Failed"
+        return passed, f"{label}: {'Passed' if passed else 'Failed'}"
+    return check
+
+def emmc_sd_check(label, test):
+    def check(returncode, stdout, stderr):
+        if returncode != 0:
+            return False, f"{label}: Failed"
         if test == "2":
-            throughput_match = re.search(r"Throughput: \s*([\d.]+)\s*MB/s", output)
+            throughput_match = re.search(r"Throughput: \s*([\d.]+)\s*MB/s", stdout)
             if throughput_match:
                 throughput = throughput_match.group(1)
-                print(f"Device {choice} Test {test}: Number of bytes written in 60 seconds: {throughput} MB/s")
-            else:
-                print(f"Device {choice} Test {test}: Failed")
-        else:
-            print(f"Device {choice} Test {test}: Passed")
-    else:
-        print(f"Device {choice} Test {test}: Failed")
-
-def run_sdma_test():
-    command = "/usr/bin/simaai_pt/dma_test.sh"
-    result = subprocess.run(command, shell=True, capture_output=True, text=True)
-    
-    if "summary" in result.stdout and "0 failures" in result.stdout:
-        print("SDMA Test: Passed")
-    else:
-        print("SDMA Test: Failed")
+                return True, f"{label}: Number of bytes written in 60 seconds: {throughput} MB/s"
+            return False, f"{label}: Failed"
+        return True, f"{label}: Passed"
+    return check
+
+def sdma_check(returncode, stdout, stderr):
+    records = json_records(stdout)
+    if returncode != 0 or not records or any(record.get("status") != "pass" for record in records):
+        return False, "SDMA Test: Failed"
+    best = max(records, key=lambda record: record.get("bandwidth_gbps", 0))
+    return True, (f"SDMA Test: Passed - up to {best.get('bandwidth_gbps', 0) * 1000:.0f} MB/s on "
+                  f"{best.get('params', {}).get('channel', 'unknown channel')}")
+
+def build_tests():
+    tests = []
 
-def main():
-    
     ocm_commands = [
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -p 9 -b -s 0x800000",  # Test 1
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -p 10 -b -s 0x800000", # Test 2
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -r -b -s 0x800000",    # Test 3
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -p 3 -b -s 0x800000",  # Test 4
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -p 11 -b -s 0x800000", # Test 5
-        "/usr/bin/simaai_pt/ddr_test -d 0x10 -f -t 60"              # Test 6 (Check Total Bytes)
+        f"{PT_DIR}/ddr_test -d 0x10 -p 9 -b -s 0x800000",  # Test 1
+        f"{PT_DIR}/ddr_test -d 0x10 -p 10 -b -s 0x800000", # Test 2
+        f"{PT_DIR}/ddr_test -d 0x10 -r -b -s 0x800000",    # Test 3
+        f"{PT_DIR}/ddr_test -d 0x10 -p 3 -b -s 0x800000",  # Test 4
+        f"{PT_DIR}/ddr_test -d 0x10 -p 11 -b -s 0x800000", # Test 5
+        f"{PT_DIR}/ddr_test -d 0x10 -f -t 60"              # Test 6 (Check Total Bytes)
     ]
 
     ddr_commands = [
-        "/usr/bin/simaai_pt/ddr_test -d 0x8 -p 9 -b",                # DDR Test 1
-        "/usr/bin/simaai_pt/ddr_test -d 0x8 -p 10 -b",               # DDR Test 2
-        "/usr/bin/simaai_pt/ddr_test -d 0x8 -r -b",                  # DDR Test 3
-        "/usr/bin/simaai_pt/ddr_test -d 0x8 -p 11 -b",               # DDR Test 4
-        "/usr/bin/simaai_pt/ddr_test -d 0x8 -f -t 60"                # DDR Test 5 (Check Total Bytes)
+        f"{PT_DIR}/ddr_test -d 0x8 -p 9 -b",                # DDR Test 1
+        f"{PT_DIR}/ddr_test -d 0x8 -p 10 -b",               # DDR Test 2
+        f"{PT_DIR}/ddr_test -d 0x8 -r -b",                  # DDR Test 3
+        f"{PT_DIR}/ddr_test -d 0x8 -p 11 -b",               # DDR Test 4
+        f"{PT_DIR}/ddr_test -d 0x8 -f -t 60"                # DDR Test 5 (Check Total Bytes)
     ]
 
-    print("Tests for OCM:")
     for i, command in enumerate(ocm_commands, start=1):
-        run_command(command, i, "OCM", check_bytes=True if i == 6 else False)
-    
-    print("Tests for DDR:")
+        bandwidth = i == 6
+        tests.append(Test("OCM", f"OCM Test {i}", command + " --json", ["ocm"],
+                          ddr_check(f"OCM Test {i}", check_bytes=bandwidth),
+                          timeout=120 if bandwidth else 300, exclusive=bandwidth))
+
     for i, command in enumerate(ddr_commands, start=1):
-        run_command(command, i, "DDR", check_bytes=True if i == 5 else False)
+        bandwidth = i == 5
+        tests.append(Test("DDR", f"DDR Test {i}", command + " --json", ["ddrc3"],
+                          ddr_check(f"DDR Test {i}", check_bytes=bandwidth),
+                          timeout=120 if bandwidth else 300, exclusive=bandwidth))
+
+    for group, choice, device in (("eMMC", "0", "emmc"), ("SD Card", "1", "sd")):
+        for test in ("1", "2", "3"):
+            label = f"Device {choice} Test {test}"
+            tests.append(Test(group, label,
+                              f'echo -e "{choice}\\n{test}" | {PT_DIR}/emmc_sd_test.sh',
+                              [device], emmc_sd_check(label, test),
+                              timeout=900, exclusive=test == "2"))
+
+    # Throughput sweep of 12 runs, each stopped after 30s if a channel hangs
+    tests.append(Test("SDMA", "SDMA Test", f"python3 {PT_DIR}/dma_bench.py --wait 30 --json", ["sdma"],
+                      sdma_check, timeout=12 * 40, exclusive=True))
+
+    return tests
+
+class Scheduler:
+    """
+    Start tests in the listed order as soon as their resources are free, at
+    most jobs at a time. An exclusive test whose own resources are free only
+    waits for the running tests to drain; it holds back every test listed
+    after it meanwhile, so it is not starved by shorter ones.
+    """
+    def __init__(self, tests, jobs):
+        self.tests = tests
+        self.jobs = max(1, jobs)
+        self.pending = list(tests)
+        self.running = {}
+        self.busy = set()
+        self.cond = threading.Condition()
 
-    eMMC_tests = ["1", "2", "3"]
-    SD_card_tests = ["1", "2", "3"]
+    def can_start(self, test):
+        if len(self.running) >= self.jobs:
+            return False
+        if any(other.exclusive for other in self.running):
+            return False
+        if test.exclusive and self.running:
+            return False
+        return not (test.resources & self.busy)
+
+    def execute(self, test, proc):
+        start = time.monotonic()
+        try:
+            stdout, stderr = proc.communicate(timeout=test.timeout)
+            test.passed, test.message = test.check(proc.returncode, stdout, stderr)
+        except subprocess.TimeoutExpired:
+            test.passed = False
+            test.message = f"{test.label}: Failed (timed out after {test.timeout}s)"
+            kill(proc)
+            proc.communicate()
+        except Exception as error:
+            # A check tripping over unexpected output fails its test, not the whole run
+            kill(proc)
+            test.passed = False
+            test.message = f"{test.label}: Failed ({type(error).__name__}: {error})"
+        finally:
+            # Always release the resources, or run() waits for this test forever
+            test.duration = time.monotonic() - start
+            if test.cancelled:
+                test.passed = False
+                test.message = f"{test.label}: Cancelled"
+
+            with self.cond:
+                del self.running[test]
+                self.busy -= test.resources
+                print(f"[{test.duration:7.1f}s] {test.message}", file=sys.stderr, flush=True)
+                self.cond.notify_all()
+
+    def start(self, test):
+        proc = subprocess.Popen(test.command, shell=True, text=True, errors="replace",
+                                stdout=subprocess.PIPE, stderr=subprocess.PIPE,
+                                start_new_session=True)
+        self.running[test] = proc
+        self.busy |= test.resources
+        threading.Thread(target=self.execute, args=(test, proc), daemon=True).start()
+
+    def run(self):
+        with self.cond:
+            while self.pending or self.running:
+                for test in list(self.pending):
+                    if self.can_start(test):
+                        self.pending.remove(test)
+                        self.start(test)
+                    elif test.exclusive and not (test.resources & self.busy):
+                        break
+                self.cond.wait()
+
+    def cancel(self):
+        with self.cond:
+            for test in self.pending:
+                test.message = f"{test.label}: Cancelled"
+            self.pending = []
+            for test, proc in self.running.items():
+                test.cancelled = True
+                kill(proc)
+            while self.running:
+                self.cond.wait()
+
+class Terminated(Exception):
+    pass
+
+def terminate(signum, frame):
+    # Tests run in sessions of their own and outlive the runner, cancel them like ^C does
+    raise Terminated()
+
+def kill(proc):
+    # Commands run through a shell in their own session, stop the whole group
+    try:
+        os.killpg(proc.pid, signal.SIGTERM)
+        proc.wait(timeout=5)
+    except subprocess.TimeoutExpired:
+        os.killpg(proc.pid, signal.SIGKILL)
+    except ProcessLookupError:
+        pass
+
+def main():
+    parser = argparse.ArgumentParser(description="SiMa.ai platform tests")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1,
+                        help="tests running at the same time, default: number of CPUs")
+    parser.add_argument("-s", "--serial", action="store_true",
+                        help="run one test at a time in the listed order")
+    parser.add_argument("-g", "--group", action="append",
+                        help="only run this group (OCM, DDR, eMMC, SD Card, SDMA), may be repeated")
+    parser.add_argument("-l", "--list", action="store_true",
+                        help="list tests with their resources and timeouts and exit")
+    args = parser.parse_args()
+
+    tests = build_tests()
+    if args.group:
+        tests = [test for test in tests if test.group in args.group]
+
+    if args.list:
+        for test in tests:
+            print(f"{test.label:20} {','.join(sorted(test.resources)):20} {test.timeout:5}s"
+                  f"{'  exclusive' if test.exclusive else ''}  {test.command}")
+        return 0
+
+    scheduler = Scheduler(tests, 1 if args.serial else args.jobs)
+    signal.signal(signal.SIGTERM, terminate)
+    try:
+        scheduler.run()
+    except (KeyboardInterrupt, Terminated):
+        signal.signal(signal.SIGINT, signal.SIG_IGN)
+        signal.signal(signal.SIGTERM, signal.SIG_IGN)
+        print("Cancelling running tests", file=sys.stderr)
+        scheduler.cancel()
 
-    print("Tests for eMMC:")
-    for test in eMMC_tests:
-        run_script("0", test)
+    group = None
+    for test in tests:
+        if test.group != group:
+            group = test.group
+            print(f"Tests for {group}:")
+        print(test.message)
 
-    print("Tests for SD Card:")
-    for test in SD_card_tests:
-        run_script("1", test)
-    
-    print("Test for SDMA:")
-    run_sdma_test()
+    return 0 if all(test.passed for test in tests) else 1
 
 if __name__ == "__main__":
-    main()
+    sys.exit(main())
@@ -0,0 +1,372 @@
+"""
+SDMA throughput benchmark on top of the kernel dmatest module. Every point of
+the sweep reloads dmatest, configures it through /sys/module/dmatest, runs it
+to completion and parses the per-thread summary lines it logs, so results are
+taken from this run only instead of from the whole of dmesg.
+"""
+import argparse
+import json
+import os
+import random
+import re
+import subprocess
+import sys
+import time
+
+DMATEST = "/sys/module/dmatest"
+KMSG = "/dev/kmsg"
+DEFAULT_CHANNELS = "dma0chan0,dma1chan0"
+
+# dmatest: dma0chan0-copy0: summary 200 tests, 0 failures 3512.24 iops 56195 KB/s (0)
+SUMMARY_RE = re.compile(r"dmatest: (?P<thread>(?P<channel>\S+)-(?:copy|memset|xor|pq)\d+): "
+                        r"summary (?P<tests>\d+) tests?, (?P<failures>\d+) failures? "
+                        r"(?P<iops>[\d.]+) iops (?P<kbs>\d+) KB/s \((?P<ret>-?\d+)\)")
+# dmatest: dma0chan0-copy0: result #3: 'test timed out' with src_off=0x0 dst_off=0x0 len=0x4000 (0)
+RESULT_RE = re.compile(r"dmatest: (?P<channel>\S+)-(?:copy|memset|xor|pq)\d+: "
+                       r"result #\d+: '(?P<message>[^']*)'")
+# dmatest: Added 4 threads using dma0chan0
+ADDED_RE = re.compile(r"dmatest: Added (?P<threads>\d+) threads? using (?P<channel>\S+)")
+
+def parse_size(text):
+    match = re.fullmatch(r"(\d+)([KMG]?)B?", text.strip().upper())
+    if not match:
+        raise argparse.ArgumentTypeError(f"invalid size {text}")
+    return int(match.group(1)) << {"": 0, "K": 10, "M": 20, "G": 30}[match.group(2)]
+
+def size_list(text):
+    return [parse_size(item) for item in text.split(",")]
+
+def int_list(text):
+    return [int(item) for item in text.split(",")]
+
+def format_size(size):
+    for shift, suffix in ((30, "G"), (20, "M"), (10, "K")):
+        if size >= 1 << shift and size % (1 << shift) == 0:
+            return f"{size >> shift}{suffix}"
+    return str(size)
+
+class Point:
+    """
+    One run of dmatest. channels lists the channels to add, an empty list
+    lets dmatest take any memcpy capable channel, up to max_channels.
+    """
+    def __init__(self, channels, max_channels, size, threads, args):
+        self.channels = channels
+        self.params = {
+            "test_buf_size": size,
+            "threads_per_chan": threads,
+            "max_channels": max_channels,
+            "iterations": args.iterations,
+            "timeout": args.timeout,
+            "noverify": int(args.noverify),
+            "norandom": int(not args.random),
+            "alignment": args.alignment,
+        }
+
+class ChannelResult:
+    def __init__(self, channel):
+        self.channel = channel
+        self.expected = 0
+        self.threads = 0
+        self.tests = 0
+        self.failures = 0
+        self.errors = []
+        self.iops = 0.0
+        self.kbs = 0
+        self.thread_iops = []
+
+    @property
+    def mbps(self):
+        return self.kbs * 1024 / 1e6
+
+    @property
+    def latency_us(self):
+        # Threads wait for each transfer, so one over their own rate is the
+        # mean time of a transfer, including the CPU verify unless noverify
+        rates = [iops for iops in self.thread_iops if iops > 0]
+        return sum(1e6 / iops for iops in rates) / len(rates) if rates else 0.0
+
+    @property
+    def missing(self):
+        return max(0, self.expected - self.threads)
+
+    @property
+    def passed(self):
+        return self.threads > 0 and not (self.failures or self.errors or self.missing)
+
+def parse_log(lines, results=None):
+    """Fold dmatest log lines into a ChannelResult per channel."""
+    results = {} if results is None else results
+    for line in lines:
+        match = ADDED_RE.search(line)
+        if match:
+            result = results.setdefault(match["channel"], ChannelResult(match["channel"]))
+            result.expected += int(match["threads"])
+            continue
+        match = SUMMARY_RE.search(line)
+        if match:
+            result = results.setdefault(match["channel"], ChannelResult(match["channel"]))
+            result.threads += 1
+            result.tests += int(match["tests"])
+            result.failures += int(match["failures"])
+            result.iops += float(match["iops"])
+            result.kbs += int(match["kbs"])
+            result.thread_iops.append(float(match["iops"]))
+            if int(match["ret"]) != 0:
+                result.errors.append(f"{match['thread']} returned {match['ret']}")
+            continue
+        match = RESULT_RE.search(line)
+        if match and match["message"] != "test passed":
+            result = results.setdefault(match["channel"], ChannelResult(match["channel"]))
+            result.errors.append(match["message"])
+    return results
+
+class DmatestSource:
+    """Runs dmatest and returns the kernel log records of the run."""
+    name = "dmatest"
+
+    def __init__(self, sysfs=DMATEST, wait=None):
+        self.sysfs = sysfs
+        self.max_wait = wait
+
+    def param_path(self, name):
+        return os.path.join(self.sysfs, "parameters", name)
+
+    def write(self, name, value):
+        path = self.param_path(name)
+        if not os.path.exists(path):
+            # Older kernels lack some parameters, e.g. alignment or max_channels
+            print(f"WARN : dmatest has no {name} parameter, ignored", file=sys.stderr)
+            return
+        with open(path, "w") as f:
+            f.write(f"{value}\n")
+
+    def read(self, name):
+        try:
+            with open(self.param_path(name)) as f:
+                return f.read().strip()
+        except OSError:
+            return None
+
+    def reload(self):
+        # A fresh module has an empty channel list and no threads left over
+        subprocess.run(["modprobe", "-r", "dmatest"], stderr=subprocess.DEVNULL)
+        if subprocess.run(["modprobe", "dmatest"]).returncode != 0 and \
+                not os.path.isdir(self.sysfs):
+            raise RuntimeError("cannot load the dmatest module")
+
+    def wait(self, timeout):
+        deadline = time.monotonic() + timeout
+        if self.read("run") is None:
+            return
+        while self.read("run") in ("Y", "1"):
+            if time.monotonic() > deadline:
+                self.write("run", 0)
+                raise RuntimeError(f"dmatest did not finish within {timeout:.0f}s")
+            time.sleep(0.05)
+
+    def run(self, point):
+        self.reload()
+        for name, value in point.params.items():
+            self.write(name, value)
+        self.write("dmatest", 0)
+        for channel in point.channels or [""]:
+            self.write("channel", channel)
+
+        kmsg = os.open(KMSG, os.O_RDONLY | os.O_NONBLOCK)
+        try:
+            os.lseek(kmsg, 0, os.SEEK_END)
+            self.write("run", 1)
+            # A hung transfer times out per iteration, leave room for all of them
+            # unless the caller bounds the run
+            timeout = point.params["iterations"] * point.params["timeout"] / 1000 + 10
+            self.wait(min(timeout, self.max_wait) if self.max_wait else timeout)
+            lines = []
+            while True:
+                try:
+                    record = os.read(kmsg, 8192).decode(errors="replace")
+                except BlockingIOError:
+                    break
+                except OSError:
+                    # EPIPE when records were overwritten before they were read
+                    continue
+                lines.append(record.split(";", 1)[-1].rstrip("\n"))
+        finally:
+            os.close(kmsg)
+        return lines
+
+class SimulatedSource:
+    """
+    Produces the log lines dmatest would for a simple model of a channel,
+    for running the parser and report on a host without DMA channels.
+    """
+    name = "simulated"
+    CHANNEL_MBPS = 800.0        # Shared by the threads of a channel
+    SETUP_US = 6.0              # Per transfer descriptor setup and completion
+    VERIFY_MBPS = 2000.0        # CPU compare of source and destination
+
+    def __init__(self, seed=1):
+        self.random = random.Random(seed)
+
+    def run(self, point):
+        params = point.params
+        channels = point.channels or [f"dma{i}chan0" for i in range(params["max_channels"] or 2)]
+        threads = params["threads_per_chan"]
+        size = params["test_buf_size"]
+        if not params["norandom"]:
+            size = (size + 1) // 2
+        lines = []
+        for channel in channels:
+            lines.append(f"dmatest: Added {threads} threads using {channel}")
+        for channel in channels:
+            for thread in range(threads):
+                us = self.SETUP_US + size / (self.CHANNEL_MBPS / threads)
+                if not params["noverify"]:
+                    us += size / self.VERIFY_MBPS
+                us *= self.random.uniform(0.97, 1.03)
+                iops = 1e6 / us
+                kbs = int(iops * size / 1024)
+                lines.append(f"dmatest: {channel}-copy{thread}: summary {params['iterations']} tests, "
+                             f"0 failures {iops:.2f} iops {kbs} KB/s (0)")
+        return lines
+
+def dmatest_available():
+    if os.path.isdir(DMATEST):
+        return True
+    try:
+        return subprocess.run(["modprobe", "-n", "dmatest"], stderr=subprocess.DEVNULL).returncode == 0
+    except OSError:
+        return False
+
+def sweep(args):
+    named = [channel for channel in args.channels if channel != "any"]
+    sets = []
+    if named:
+        sets += [(named, 0)] if args.concurrent else [([channel], 0) for channel in named]
+    if "any" in args.channels:
+        sets += [([], count) for count in args.max_channels]
+    for size in args.sizes:
+        for threads in args.threads:
+            for channels, max_channels in sets:
+                yield Point(channels, max_channels, size, threads, args)
+
+def print_header():
+    print(f"{'Channel':12} {'Size':>6} {'Threads':>7} {'Tests':>7} {'Failures':>8} "
+          f"{'MB/s':>10} {'IOPS':>10} {'avg us':>9}")
+
+def print_result(point, result):
+    params = point.params
+    status = "" if result.passed else "  FAILED"
+    print(f"{result.channel:12} {format_size(params['test_buf_size']):>6} "
+          f"{params['threads_per_chan']:>7} {result.tests:>7} {result.failures:>8} "
+          f"{result.mbps:>10.1f} {result.iops:>10.0f} {result.latency_us:>9.1f}{status}")
+    if result.missing:
+        print(f"  {result.missing} of {result.expected} threads did not report", file=sys.stderr)
+    for error in result.errors[:5]:
+        print(f"  {error}", file=sys.stderr)
+
+def json_result(point, result, source):
+    params = dict(point.params, channel=result.channel) if point else {"channel": result.channel}
+    errors = result.failures + len(result.errors) + result.missing
+    record = {
+        "tool": "dma_bench",
+        "test": "memcpy",
+        "params": dict(params, source=source),
+        "bandwidth_gbps": result.kbs * 1024 / 1e9,
+        "iops": result.iops,
+        # dmatest only reports a mean, latency_ns is kept for percentiles
+        "mean_latency_ns": result.latency_us * 1e3,
+        "threads": result.threads,
+        "tests": result.tests,
+        "failures": result.failures,
+        "errors": errors if result.threads else max(errors, 1),
+        "status": "pass" if result.passed else "fail",
+    }
+    print(json.dumps(record), flush=True)
+
+def report(point, results, args, source):
+    if not results:
+        # Nothing ran, e.g. an unknown channel name
+        for channel in point.channels or ["any"]:
+            results[channel] = ChannelResult(channel)
+    for result in results.values():
+        if args.json:
+            json_result(point, result, source)
+        else:
+            print_result(point, result)
+    return all(result.passed for result in results.values())
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="SDMA throughput sweep through the dmatest module. Sizes take a K, M or G "
+                    "suffix, lists are comma separated.")
+    parser.add_argument("-c", "--channels", type=lambda text: text.split(","),
+                        default=DEFAULT_CHANNELS.split(","),
+                        help="channels tested one at a time, 'any' lets dmatest pick memcpy "
+                             f"capable channels, default: {DEFAULT_CHANNELS}")
+    parser.add_argument("-C", "--concurrent", action="store_true",
+                        help="run the named channels at the same time")
+    parser.add_argument("-m", "--max-channels", type=int_list, default=[1],
+                        help="channels dmatest picks for 'any', default: 1")
+    parser.add_argument("-s", "--sizes", type=size_list, default=size_list("4K,64K,1M"),
+                        help="test_buf_size values, default: 4K,64K,1M")
+    parser.add_argument("-t", "--threads", type=int_list, default=[1, 4],
+                        help="threads_per_chan values, default: 1,4")
+    parser.add_argument("-i", "--iterations", type=int, default=200,
+                        help="transfers per thread, default: 200")
+    parser.add_argument("-T", "--timeout", type=int, default=2000,
+                        help="timeout of a transfer in ms, default: 2000")
+    parser.add_argument("-W", "--wait", type=float,
+                        help="seconds a run may take before it is stopped and failed, default: "
+                             "room for every transfer to time out")
+    parser.add_argument("-a", "--alignment", type=int, default=4,
+                        help="log2 of the buffer alignment, default: 4")
+    parser.add_argument("-n", "--noverify", action="store_true",
+                        help="do not compare the buffers, measures the DMA alone")
+    parser.add_argument("-r", "--random", action="store_true",
+                        help="random transfer lengths up to the size, as dmatest does by "
+                             "default; the sweep uses the full size otherwise")
+    parser.add_argument("--simulate", action="store_true",
+                        help="use simulated dmatest results instead of the kernel module")
+    parser.add_argument("--log", metavar="FILE",
+                        help="only parse the dmatest lines of a saved kernel log, - for stdin")
+    parser.add_argument("-j", "--json", action="store_true",
+                        help="print one JSON object per channel and run")
+    args = parser.parse_args()
+
+    if args.log:
+        with (sys.stdin if args.log == "-" else open(args.log)) as f:
+            results = parse_log(f)
+        if not args.json:
+            print(f"{'Channel':12} {'Threads':>7} {'Tests':>7} {'Failures':>8} "
+                  f"{'MB/s':>10} {'IOPS':>10} {'avg us':>9}")
+        passed = True
+        for result in results.values():
+            passed &= result.passed
+            if args.json:
+                json_result(None, result, "log")
+            else:
+                print(f"{result.channel:12} {result.threads:>7} {result.tests:>7} "
+                      f"{result.failures:>8} {result.mbps:>10.1f} {result.iops:>10.0f} "
+                      f"{result.latency_us:>9.1f}{'' if result.passed else '  FAILED'}")
+        return 0 if results and passed else 1
+
+    source = SimulatedSource() if args.simulate else DmatestSource(wait=args.wait)
+    if not args.simulate and not dmatest_available():
+        print("ERROR : dmatest is not available, use --simulate on a host", file=sys.stderr)
+        return 1
+
+    if not args.json:
+        print_header()
+    passed = True
+    for point in sweep(args):
+        try:
+            lines = source.run(point)
+        except (OSError, RuntimeError) as error:
+            print(f"ERROR : {error}", file=sys.stderr)
+            lines = []
+        passed &= report(point, parse_log(lines), args, source.name)
+    return 0 if passed else 1
+
+if __name__ == "__main__":
+    sys.exit(main())